@@ -72,6 +72,7 @@ function_type Functions[] = {
 {"StringLength",        STRINGLENGTH,    AEXPRESSION,   ANONE},
 {"StringConsistsOf",    STRINGCONSISTSOF,AEXPRESSION,   AEXPRESSION,  ANONE},
 {"CreateTimer",         CREATETIMER,     AEXPRESSION,   AEXPRESSION,  AEXPRESSION, ANONE},
+{"CreatePeriodicTimer", CREATEPERIODICTIMER, AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE},
 {"DeleteTimer",         DELETETIMER,     AEXPRESSION,   ANONE},
 {"IsTimer",             ISTIMER,         AEXPRESSION,   ANONE},
 {"IsList",              ISLIST,          AEXPRESSION,   ANONE},
@@ -104,6 +105,24 @@ function_type Functions[] = {
 {"GetRandomPointBSP",   GETRANDOMPOINTBSP, AEXPRESSION, AEXPRESSION,  AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE },
 {"GetStepTowardsBSP",   GETSTEPTOWARDSBSP, AEXPRESSION, AEXPRESSION,  AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION,
                                            AEXPRESSION, AEXPRESSION,  AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE },
+{"GetStepsTowardsBSP",  GETSTEPSTOWARDSBSP, AEXPRESSION, AEXPRESSION, ANONE },
+{"GetPathBSP",          GETPATHBSP,      AEXPRESSION,   AEXPRESSION,  AEXPRESSION, AEXPRESSION, AEXPRESSION,
+                                         AEXPRESSION,   AEXPRESSION,  AEXPRESSION, AEXPRESSION, ANONE },
+{"InterestAdd",         INTERESTADD,     AEXPRESSION,   AEXPRESSION,  AEXPRESSION, AEXPRESSION,
+                                         AEXPRESSION,   AEXPRESSION,  AEXPRESSION, ANONE },
+{"InterestMove",        INTERESTMOVE,    AEXPRESSION,   AEXPRESSION,  AEXPRESSION, AEXPRESSION,
+                                         AEXPRESSION,   AEXPRESSION,  ANONE },
+{"InterestRemove",      INTERESTREMOVE,  AEXPRESSION,   AEXPRESSION,  ANONE },
+{"InterestQuery",       INTERESTQUERY,   AEXPRESSION,   AEXPRESSION,  AEXPRESSION, AEXPRESSION,
+                                         AEXPRESSION,   AEXPRESSION,  ANONE },
+{"InterestSendPacket",  INTERESTSENDPACKET, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION,
+                                         AEXPRESSION,   AEXPRESSION,  AEXPRESSION, ANONE },
+{"GetObjectsInRadius",  GETOBJECTSINRADIUS, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION,
+                    AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE },
+{"GetNearestObjects",   GETNEARESTOBJECTS, AEXPRESSION, AEXPRESSION,  AEXPRESSION, AEXPRESSION,
+                    AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE },
+{"GetObjectsInView",    GETOBJECTSINVIEW, AEXPRESSION,  AEXPRESSION,  AEXPRESSION, AEXPRESSION,
+                    AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, AEXPRESSION, ANONE },
 {"SetResource",         SETRESOURCE,     AEXPRESSION,   AEXPRESSION,  ANONE},
 {"Post",                POSTMESSAGE,     AEXPRESSION,   AEXPRESSION,  ASETTINGS, ANONE},
 {"Abs",                 ABS,             AEXPRESSION,   ANONE},
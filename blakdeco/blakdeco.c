@@ -607,6 +607,7 @@ char * name_function(int fnum)
    case DELETETIMER : return "DeleteTimer";
    case GETTIMEREMAINING : return "GetTimeRemaining";
    case ISTIMER : return "IsTimer";
+   case CREATEPERIODICTIMER : return "CreatePeriodicTimer";
 
    case MOVESECTORBSP : return "MoveSectorBSP";
    case CHANGETEXTUREBSP : return "ChangeTextureBSP";
@@ -622,6 +623,16 @@ char * name_function(int fnum)
    case BLOCKERCLEARBSP: return "BlockerClearBSP";
    case GETRANDOMPOINTBSP: return "GetRandomPointBSP";
    case GETSTEPTOWARDSBSP: return "GetStepTowardsBSP";
+   case GETSTEPSTOWARDSBSP: return "GetStepsTowardsBSP";
+   case GETPATHBSP: return "GetPathBSP";
+   case INTERESTADD: return "InterestAdd";
+   case INTERESTMOVE: return "InterestMove";
+   case INTERESTREMOVE: return "InterestRemove";
+   case INTERESTQUERY: return "InterestQuery";
+   case INTERESTSENDPACKET: return "InterestSendPacket";
+   case GETOBJECTSINRADIUS: return "GetObjectsInRadius";
+   case GETNEARESTOBJECTS: return "GetNearestObjects";
+   case GETOBJECTSINVIEW: return "GetObjectsInView";
 
    case MINIGAMENUMBERTOSTRING : return "MiniGameNumberToString";
    case MINIGAMESTRINGTONUMBER : return "MiniGameStringToNumber";
@@ -9,26 +9,131 @@
  * account.c
  *
  
- This module keeps a linked list of accounts in memory.  These are loaded in
+ This module keeps the accounts in memory.  These are loaded in
  from a file (loadacco.c) when Blakserv starts (or initialized by builtin.c).
- The linked list is stored in account number, just so everytime it is
- loaded in and saved the file is in the same order.
+ The accounts are kept in a map sorted by account number, just so everytime
+ it is loaded in and saved the file is in the same order, and so a range of
+ account numbers can be listed.
+
+ Looking an account up by number or by name (ignoring case) goes through
+ hash tables chained through the account nodes, so logins don't have to
+ look at every account.  The tables double when there are more accounts
+ than buckets.  Guest accounts are also kept in their own list, in account
+ number order, to hand out at login.
  
  */
 
 #include "blakserv.h"
 
-account_node *accounts;
+#include <map>
+
+#define ACCOUNT_HASH_SIZE 1024 /* starting size, always a power of 2 */
+
+typedef std::map<int,account_node *> account_map;
+static account_map accounts;
+
+static account_node **accounts_by_id;
+static account_node **accounts_by_name;
+static int account_hash_size;
+
+static std::vector<account_node *> guest_accounts;
+
 int next_account_id;
 
 account_node console_account_node,*console_account;
 
 /* local function prototypes */
-void InsertAccount(account_node *a);
+Bool InsertAccount(account_node *a);
+
+static account_node ** AllocateAccountHash(int size)
+{
+   account_node **hash;
+   int i;
+
+   hash = (account_node **)AllocateMemory(MALLOC_ID_ACCOUNT,size*sizeof(account_node *));
+   for (i=0;i<size;i++)
+      hash[i] = NULL;
+   return hash;
+}
+
+static void HashAccountID(account_node *a)
+{
+   int index;
+
+   index = a->account_id & (account_hash_size - 1);
+   a->next_by_id = accounts_by_id[index];
+   accounts_by_id[index] = a;
+}
+
+static void HashAccountName(account_node *a)
+{
+   int index;
+
+   index = a->name_hash & (account_hash_size - 1);
+   a->next_by_name = accounts_by_name[index];
+   accounts_by_name[index] = a;
+}
+
+static void UnhashAccountID(account_node *a)
+{
+   account_node **link;
+
+   link = &accounts_by_id[a->account_id & (account_hash_size - 1)];
+   while (*link != NULL && *link != a)
+      link = &(*link)->next_by_id;
+   if (*link != NULL)
+      *link = a->next_by_id;
+}
+
+static void UnhashAccountName(account_node *a)
+{
+   account_node **link;
+
+   link = &accounts_by_name[a->name_hash & (account_hash_size - 1)];
+   while (*link != NULL && *link != a)
+      link = &(*link)->next_by_name;
+   if (*link != NULL)
+      *link = a->next_by_name;
+}
+
+/* rebuild both hash tables from the map with new_size buckets */
+static void RehashAccounts(int new_size)
+{
+   account_map::iterator it;
+
+   FreeMemory(MALLOC_ID_ACCOUNT,accounts_by_id,account_hash_size*sizeof(account_node *));
+   FreeMemory(MALLOC_ID_ACCOUNT,accounts_by_name,account_hash_size*sizeof(account_node *));
+
+   account_hash_size = new_size;
+   accounts_by_id = AllocateAccountHash(account_hash_size);
+   accounts_by_name = AllocateAccountHash(account_hash_size);
+
+   for (it = accounts.begin(); it != accounts.end(); ++it)
+   {
+      HashAccountID(it->second);
+      HashAccountName(it->second);
+   }
+}
+
+static bool AccountIDLess(account_node *a,account_node *b)
+{
+   return a->account_id < b->account_id;
+}
+
+static void FreeAccountNode(account_node *a)
+{
+   FreeMemory(MALLOC_ID_ACCOUNT,a->name,strlen(a->name)+1);
+   FreeMemory(MALLOC_ID_ACCOUNT,a->password,strlen(a->password)+1);
+   FreeMemory(MALLOC_ID_ACCOUNT,a,sizeof(account_node));
+}
 
 void InitAccount(void)
 {
-   accounts = NULL;
+   accounts.clear();
+   guest_accounts.clear();
+   account_hash_size = ACCOUNT_HASH_SIZE;
+   accounts_by_id = AllocateAccountHash(account_hash_size);
+   accounts_by_name = AllocateAccountHash(account_hash_size);
    next_account_id = 1;
 
    console_account = &console_account_node;
@@ -45,18 +150,19 @@ void InitAccount(void)
 
 void ResetAccount(void)
 {
-   account_node *a,*temp;
+   account_map::iterator it;
+   int i;
 
-   a = accounts;
-   while (a != NULL)
+   for (it = accounts.begin(); it != accounts.end(); ++it)
+      FreeAccountNode(it->second);
+   accounts.clear();
+   guest_accounts.clear();
+
+   for (i=0;i<account_hash_size;i++)
    {
-      temp = a->next;
-      FreeMemory(MALLOC_ID_ACCOUNT,a->name,strlen(a->name)+1);
-      FreeMemory(MALLOC_ID_ACCOUNT,a->password,strlen(a->password)+1);
-      FreeMemory(MALLOC_ID_ACCOUNT,a,sizeof(account_node));
-      a = temp;
+      accounts_by_id[i] = NULL;
+      accounts_by_name[i] = NULL;
    }
-   accounts = NULL;
    next_account_id = 1;
 }
 
@@ -92,23 +198,31 @@ int GetUsedGuestAccounts(void)
    return used_guest_accounts;
 }
 
-void InsertAccount(account_node *a)
+/* InsertAccount
+   Adds a to the map and the hash tables.  Returns False if there's already
+   an account with its number, in which case the caller still owns a. */
+Bool InsertAccount(account_node *a)
 {
-   account_node *temp;
+   a->name_hash = GetBufferHash(a->name,strlen(a->name));
 
-   if (accounts == NULL || accounts->account_id > a->account_id)
+   if (!accounts.insert(std::make_pair(a->account_id,a)).second)
    {
-      a->next = accounts;
-      accounts = a;
+      eprintf("InsertAccount found account %i already exists\n",a->account_id);
+      return False;
    }
+
+   if ((int)accounts.size() > account_hash_size)
+      RehashAccounts(2*account_hash_size);
    else
    {
-      temp = accounts;
-      while (temp->next != NULL && temp->next->account_id < a->account_id)
-	 temp = temp->next;
-      a->next = temp->next;
-      temp->next = a;
+      HashAccountID(a);
+      HashAccountName(a);
    }
+
+   if (a->type == ACCOUNT_GUEST)
+      guest_accounts.insert(std::lower_bound(guest_accounts.begin(),guest_accounts.end(),
+                                             a,AccountIDLess),a);
+   return True;
 }
 
 Bool CreateAccount(char *name,char *password,int type,int *account_id)
@@ -135,7 +249,11 @@ Bool CreateAccount(char *name,char *password,int type,int *account_id)
    a->suspend_time = 0;
    a->credits = 100*ConfigInt(CREDIT_INIT);
 
-   InsertAccount(a);
+   if (!InsertAccount(a))
+   {
+      FreeAccountNode(a);
+      return False;
+   }
 
 	*account_id = a->account_id;
 	return True;
@@ -171,7 +289,11 @@ int CreateAccountSecurePassword(char *name,char *password,int type)
    a->suspend_time = 0;
    a->credits = 100*ConfigInt(CREDIT_INIT);
 
-   InsertAccount(a);
+   if (!InsertAccount(a))
+   {
+      FreeAccountNode(a);
+      return -1;
+   }
 
    return a->account_id;
 }
@@ -216,7 +338,11 @@ int RecreateAccountSecurePassword(int account_id,char *name,char *password,int t
    a->suspend_time = 0;
    a->credits = 100*ConfigInt(CREDIT_INIT);
 
-   InsertAccount(a);
+   if (!InsertAccount(a))
+   {
+      FreeAccountNode(a);
+      return -1;
+   }
 
    return a->account_id;
 }
@@ -242,52 +368,46 @@ void LoadAccount(int account_id,char *name,char *password,int type,int last_logi
    a->suspend_time = suspend_time;
    a->credits = credits;
 
-   InsertAccount(a);
+   if (!InsertAccount(a))
+      FreeAccountNode(a);
 }
 
 /* DeleteAccount
    Make sure if you call this you remove all users w/ this account too. */
 Bool DeleteAccount(int account_id)
 {
-   account_node *a,*temp;
+   account_map::iterator it;
+   account_node *a;
+   std::vector<account_node *>::iterator guest;
 
-   a = accounts;
+   it = accounts.find(account_id);
+   if (it == accounts.end())
+      return False;
 
-   /* delete from front of list */
-   if (a->account_id == account_id)
-   {
-      accounts = a->next;
-      
-      FreeMemory(MALLOC_ID_ACCOUNT,a->name,strlen(a->name)+1);
-      FreeMemory(MALLOC_ID_ACCOUNT,a->password,strlen(a->password)+1);
-      FreeMemory(MALLOC_ID_ACCOUNT,a,sizeof(account_node));
-      return True;
-   }
-   
-   while (a != NULL)
-   {
-      temp = a->next;
-      if (temp != NULL && temp->account_id == account_id)
-      {
-	 /* remove from list, then free memory */
-	 a->next = temp->next;
+   /* remove from map, hash tables and guest list, then free memory */
+   a = it->second;
+   accounts.erase(it);
+   UnhashAccountID(a);
+   UnhashAccountName(a);
 
-	 FreeMemory(MALLOC_ID_ACCOUNT,temp->name,strlen(temp->name)+1);
-	 FreeMemory(MALLOC_ID_ACCOUNT,temp->password,strlen(temp->password)+1);
-	 FreeMemory(MALLOC_ID_ACCOUNT,temp,sizeof(account_node));
-	 return True;
-      }
-      a = a->next;
-   }
+   guest = std::find(guest_accounts.begin(),guest_accounts.end(),a);
+   if (guest != guest_accounts.end())
+      guest_accounts.erase(guest);
 
-   return False;
+   FreeAccountNode(a);
+   return True;
 }
 
 void SetAccountName(account_node *a,char *name)
 {
+   UnhashAccountName(a);
+
    FreeMemory(MALLOC_ID_ACCOUNT,a->name,strlen(a->name)+1);
    a->name = (char *)AllocateMemory(MALLOC_ID_ACCOUNT,strlen(name)+1);
    strcpy(a->name,name);
+
+   a->name_hash = GetBufferHash(a->name,strlen(a->name));
+   HashAccountName(a);
 }
 
 void SetAccountPassword(account_node *a,char *password)
@@ -382,14 +502,12 @@ Bool SuspendAccountRelative(account_node *a, int hours)
 int GetActiveAccountCount()
 {
 	int retval = 0;
-   account_node *a;
+   account_map::iterator it;
 
-   a = accounts;
-   while (a != NULL)
+   for (it = accounts.begin(); it != accounts.end(); ++it)
    {
-		if (a->suspend_time <= 0)
+		if (it->second->suspend_time <= 0)
 			retval++;
-		a = a->next;
    }
 
 	return retval;
@@ -399,73 +517,72 @@ account_node * GetAccountByID(int account_id)
 {
    account_node *a;
 
-   a = accounts;
+   a = accounts_by_id[account_id & (account_hash_size - 1)];
    while (a != NULL)
    {
       if (a->account_id == account_id)
 	 return a;
-      a = a->next;
+      a = a->next_by_id;
    }
    return NULL;
 }
 
 account_node * GetAccountByName(char *name)
 {
-   account_node *a;
+   account_node *a,*found;
+   unsigned int hash;
 
-   a = accounts;
+   hash = GetBufferHash(name,strlen(name));
+
+   /* if more than one account has the name, the lowest numbered one wins */
+   found = NULL;
+   a = accounts_by_name[hash & (account_hash_size - 1)];
    while (a != NULL)
    {
-      if (!stricmp(a->name,name))
-	 return a;
-      a = a->next;
+      if (a->name_hash == hash && !stricmp(a->name,name))
+      {
+	 if (found == NULL || a->account_id < found->account_id)
+	    found = a;
+      }
+      a = a->next_by_name;
    }
-   return NULL;
+   return found;
 }
 
 account_node * AccountLoginByName(char *name)
 {
    account_node *a;
+   int i;
 
    if (0 == stricmp(name,ConfigStr(GUEST_ACCOUNT)))
    {
       if (GetUsedGuestAccounts() >= ConfigInt(GUEST_MAX))
 	 return NULL;
 
-      a = accounts;
-      while (a != NULL)
+      for (i=0;i<(int)guest_accounts.size();i++)
       {
-	 if (a->type == ACCOUNT_GUEST)
+	 a = guest_accounts[i];
+	 if (GetSessionByAccount(a) == NULL)
 	 {
-	    if (GetSessionByAccount(a) == NULL)
-	    {
-	       /* no one using this particular guest account, so we will */
+	    /* no one using this particular guest account, so we will */
 
-	       /* give guests credits every time they login */
-	       /* a->credits = 100*ConfigInt(GUEST_CREDITS); */
+	    /* give guests credits every time they login */
+	    /* a->credits = 100*ConfigInt(GUEST_CREDITS); */
 	       
-	       return a;
-	    }
+	    return a;
 	 }
-	 a = a->next;
       }
    }
    else
    {
-      a = accounts;
-      while (a != NULL)
-      {
-	 if (!stricmp(a->name,name))
-	 {
-	    /* give administrators credits every time they login */
-	    /*
-	    if (a->type == ACCOUNT_ADMIN)
-	       a->credits = 100*ConfigInt(CREDIT_ADMIN);
-	       */
-	    return a;
-	 }
-	 a = a->next;
-      }
+      a = GetAccountByName(name);
+
+      /* give administrators credits every time they login */
+      /*
+      if (a != NULL && a->type == ACCOUNT_ADMIN)
+	 a->credits = 100*ConfigInt(CREDIT_ADMIN);
+	 */
+      return a;
    }
    return NULL;
 }
@@ -483,15 +600,23 @@ void DoneLoadAccounts(void)
    InitProfiling();
 }
 
+/* the callback may delete the account it's given, but no other */
 void ForEachAccount(void (*callback_func)(account_node *a))
 {
+   ForEachAccountInRange(INT_MIN,INT_MAX,callback_func);
+}
+
+void ForEachAccountInRange(int first_id,int last_id,void (*callback_func)(account_node *a))
+{
+   account_map::iterator it;
    account_node *a;
 
-   a = accounts;
-   while (a != NULL)
+   it = accounts.lower_bound(first_id);
+   while (it != accounts.end() && it->first <= last_id)
    {
+      a = it->second;
+      ++it;
       callback_func(a);
-      a = a->next;
    }
 }
 
@@ -553,20 +678,28 @@ void DeleteAccountIfUnused(account_node *a)
 // AdminDeleteUnusedAccounts after deleting unused accounts.
 void CompactAccounts()
 {
+   std::vector<account_node *> renumber;
+   account_map::iterator it;
    account_node *a;
+   int i;
    int new_number = 1;
 
-   a = accounts;
+   for (it = accounts.begin(); it != accounts.end(); ++it)
+      renumber.push_back(it->second);
+   accounts.clear();
 
-   while (a != NULL)
+   /* the order doesn't change, so the guest list stays sorted */
+   for (i=0;i<(int)renumber.size();i++)
    {
+      a = renumber[i];
       if (a->account_id != new_number)
       {
          ChangeUserAccountID(a->account_id, new_number);
          a->account_id = new_number;
       }
+      accounts.insert(accounts.end(),std::make_pair(new_number,a));
       ++new_number;
-      a = a->next;
    }
+   RehashAccounts(account_hash_size);
    SetNextAccountID(new_number);
 }
@@ -24,7 +24,9 @@ typedef struct account_node_struct
    int credits;			/* remember, stored as 1/100 of a credit */
    int last_login_time;
    int suspend_time;
-   struct account_node_struct *next;
+   unsigned int name_hash;	/* GetBufferHash of name, which ignores case */
+   struct account_node_struct *next_by_id;	/* hash chains in account.c */
+   struct account_node_struct *next_by_name;
 } account_node;
 
 void InitAccount(void);
@@ -48,6 +50,7 @@ account_node * AccountLoginByName(char *name);
 void AccountLogoff(account_node *a);
 void DoneLoadAccounts(void);
 void ForEachAccount(void (*callback_func)(account_node *a));
+void ForEachAccountInRange(int first_id,int last_id,void (*callback_func)(account_node *a));
 void DeleteAccountAndAssociatedUsersByID(int account_id);
 void DeleteAccountIfUnused(account_node *a);
 void CompactAccounts(void);
@@ -121,6 +121,8 @@ void AdminShowUserHeader(void);
 void AdminShowOneUser(user_node *u);
 void AdminShowAccounts(int session_id,admin_parm_type parms[],
                        int num_blak_parm,parm_node blak_parm[]);
+void AdminShowAccountRange(int session_id,admin_parm_type parms[],
+                           int num_blak_parm,parm_node blak_parm[]);
 void AdminShowAccount(int session_id,admin_parm_type parms[],
                       int num_blak_parm,parm_node blak_parm[]);
 void AdminShowAccountHeader(void);
@@ -182,6 +184,8 @@ void AdminShowMatches(int session_id,admin_parm_type parms[],
                       int num_blak_parm,parm_node blak_parm[]);
 void AdminShowProtocol(int session_id,admin_parm_type parms[],
                        int num_blak_parm,parm_node blak_parm[]);
+void AdminShowPosts(int session_id,admin_parm_type parms[],
+                    int num_blak_parm,parm_node blak_parm[]);
 
 
 void AdminSetClass(int session_id,admin_parm_type parms[],
@@ -265,6 +269,17 @@ void AdminTraceOnMessage(int session_id,admin_parm_type parms[],
 void AdminTraceOffMessage(int session_id,admin_parm_type parms[],
                           int num_blak_parm,parm_node blak_parm[]);
 
+void AdminProfileStart(int session_id,admin_parm_type parms[],
+                       int num_blak_parm,parm_node blak_parm[]);
+void AdminProfileStop(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[]);
+void AdminProfileClear(int session_id,admin_parm_type parms[],
+                       int num_blak_parm,parm_node blak_parm[]);
+void AdminProfileSave(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[]);
+void AdminProfileShow(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[]);
+
 void AdminAddCredits(int session_id,admin_parm_type parms[],
                      int num_blak_parm,parm_node blak_parm[]);
 
@@ -321,6 +336,7 @@ void AdminMark(int session_id,admin_parm_type parms[],
 admin_table_type admin_show_table[] =
 {
 	{ AdminShowAccount,       {R,N}, F, A|M, NULL, 0, "account",       "Show one account by account id or name" },
+	{ AdminShowAccountRange,  {I,I,N}, F, A|M, NULL, 0, "accountrange", "Show accounts with ids from first to last" },
 	{ AdminShowAccounts,      {N},   F, A|M, NULL, 0, "accounts",      "Show all accounts" },
 	{ AdminShowObjects,       {I,N}, F, A|M, NULL, 0, "belong",        "Show objects belonging to id" },
 	{ AdminShowBlockers,      {I,N}, F, A|M, NULL, 0, "blockers",      "Show all blockers in a room (TAG_ROOM_DATA parameter)" },
@@ -341,6 +357,7 @@ admin_table_type admin_show_table[] =
 	{ AdminShowNameIDs,       {N},   F, A|M, NULL, 0, "nameids",       "Show all name ids (message/parms)" },
 	{ AdminShowObject,        {I,N}, F, A|M, NULL, 0, "object",        "Show one object by id" },
 	{ AdminShowPackages,      {N},   F,A, NULL, 0, "packages",         "Show all packages loaded" },
+	{ AdminShowPosts,         {N},   F, A|M, NULL, 0, "posts",         "Show posted message queue statistics" },
 	{ AdminShowProtocol,      {N},   F, A|M, NULL, 0, "protocol",      "Show protocol message counts" },
 	{ AdminShowReferences,    {S,S,N}, F, A|M, NULL, 0, "references",  "Show what objects or lists reference a particular data value" },
 	{ AdminShowResource,      {S,N}, F, A|M, NULL, 0, "resource",      "Show a resource by resource name" },
@@ -463,6 +480,16 @@ admin_table_type admin_trace_table[] =
 };
 #define LEN_ADMIN_TRACE_TABLE (sizeof(admin_trace_table)/sizeof(admin_table_type))
 
+admin_table_type admin_profile_table[] =
+{
+	{ AdminProfileClear, {N},   F, A|M, NULL, 0, "clear", "Throw away Blakod profile samples" },
+	{ AdminProfileSave,  {S,N}, F, A|M, NULL, 0, "save",  "Write Blakod profile as folded stacks to a file in the log directory" },
+	{ AdminProfileShow,  {N},   F, A|M, NULL, 0, "show",  "Show Blakod handler lines with the most samples" },
+	{ AdminProfileStart, {I,N}, F, A|M, NULL, 0, "start", "Start Blakod profiling, sampling every int instructions (0 for default)" },
+	{ AdminProfileStop,  {N},   F, A|M, NULL, 0, "stop",  "Stop Blakod profiling" },
+};
+#define LEN_ADMIN_PROFILE_TABLE (sizeof(admin_profile_table)/sizeof(admin_table_type))
+
 admin_table_type admin_add_table[] =
 {
 	{ AdminAddCredits,   {I,I,N}, F, A|M, NULL, 0, "credits", 
@@ -549,6 +576,7 @@ admin_table_type admin_main_table[] =
 	{ AdminMail,          {N},   F, A|M, NULL, 0, "mail",      "Read administrator mail" },
 	{ AdminMark,          {N},   F, A|M, NULL, 0, "mark",      "Mark all channel logs with a dashed line" },
 	{ AdminPage,          {N},   F, A|M, NULL, 0, "page",      "Page the console" },
+	{ NULL, {N}, F, A|M, admin_profile_table, LEN_ADMIN_PROFILE_TABLE, "profile", "Profile subcommand" },
 	{ AdminRead,          {S,N}, F, A|M, NULL, 0, "read",      "Read admin commands from a file, echoes everything" },
 	{ NULL, {N}, F, A|M, admin_recreate_table,LEN_ADMIN_RECREATE_TABLE, "recreate", "Recreate subcommand" },
 	{ NULL, {N}, F, A|M, admin_reload_table, LEN_ADMIN_RELOAD_TABLE, "reload", "Reload subcommand" },
@@ -1334,6 +1362,7 @@ void AdminShowStatus(int session_id,admin_parm_type parms[],
                      int num_blak_parm,parm_node blak_parm[])
 {
 	kod_statistics *kstat;
+	timer_stat_type *tstat;
 	object_node *o = NULL;
 	class_node *c = NULL;
 	char *m = NULL;
@@ -1385,12 +1414,27 @@ void AdminShowStatus(int session_id,admin_parm_type parms[],
 		GetUsedSessions(),GetUsedGuestAccounts());
 	
 	aprintf("----\n");
-	aprintf("Used %i list nodes\n",GetListNodesUsed());
+	aprintf("Used %i list nodes (%i free), %i list vectors\n",GetListNodesUsed(),
+		GetListNodesFree(),GetListVectorsUsed());
 	aprintf("Used %i tables\n",GetTablesUsed());
 	aprintf("Used %i object nodes\n",GetObjectsUsed());
-	aprintf("Used %i string nodes\n",GetStringsUsed());
+	aprintf("Used %i string nodes, %i string bodies (%i interned)\n",GetStringsUsed(),
+		GetStringBodiesUsed(),GetStringBodiesInterned());
 	aprintf("Watching %i active timers\n",GetNumActiveTimers());
+	aprintf("%i posted messages waiting, most ever %i\n",
+		GetPostQueueDepth(),GetPostStats()->depth_highest);
+	tstat = GetTimerStats();
+	if (tstat->wakeups > 0)
+	{
+		aprintf("Fired %.0f timers in %i passes (avg %.1f, max %i), %i passes cut short\n",
+			tstat->fired,tstat->wakeups,tstat->fired/tstat->wakeups,
+			tstat->max_drained,tstat->cut_short);
+		aprintf("Timer lateness avg %.1f ms, max %i ms\n",
+			tstat->total_late_ms/tstat->fired,tstat->max_late_ms);
+	}
 	aprintf("%i message hash table collisions\n", GetNumMessageHashCollisions());
+	aprintf("%i message handlers pre-decoded, %i running as raw bkod\n",
+		GetNumTranslatedHandlers(),GetNumUntranslatedHandlers());
 	
 	if (IsGameLocked())
 		aprintf("The game is LOCKED (%s)\n",GetGameLockedReason());
@@ -1624,9 +1668,9 @@ void AdminShowObject(int session_id,admin_parm_type parms[],
 		if (i == 0)
 			prop_name = "self";
 		else
-			prop_name = GetPropertyNameByID(c,o->p[i].id);
+			prop_name = GetPropertyNameByID(c,i);
 		if (prop_name == NULL)
-			sprintf(buf,": #%-19i",o->p[i].id);
+			sprintf(buf,": #%-19i",i);
 		else
 			sprintf(buf,": %-20s",prop_name);
 		aprintf("%s = %s %s\n",buf,GetTagName(o->p[i].val),
@@ -1826,6 +1870,18 @@ void AdminShowAccounts(int session_id,admin_parm_type parms[],
 	ForEachAccount(AdminShowOneAccount);
 }
 
+void AdminShowAccountRange(int session_id,admin_parm_type parms[],
+                           int num_blak_parm,parm_node blak_parm[])
+{
+	int first_id,last_id;
+
+	first_id = (int)parms[0];
+	last_id = (int)parms[1];
+
+	AdminShowAccountHeader();
+	ForEachAccountInRange(first_id,last_id,AdminShowOneAccount);
+}
+
 void AdminShowAccount(int session_id,admin_parm_type parms[],
                       int num_blak_parm,parm_node blak_parm[])                      
 {
@@ -1998,8 +2054,8 @@ void AdminShowDynamicResources(int session_id,admin_parm_type parms[],
 void AdminShowTimers(int session_id,admin_parm_type parms[],
                      int num_blak_parm,parm_node blak_parm[])
 {
-	aprintf("%-7s%-14s%-8s%-20s\n","Timer","Remaining ms","Object",
-		"Message");
+	aprintf("%-7s%-14s%-10s%-8s%-20s\n","Timer","Remaining ms","Period",
+		"Object","Message");
 	ForEachTimer(AdminShowOneTimer);
 }
 
@@ -2018,8 +2074,8 @@ void AdminShowTimer(int session_id,admin_parm_type parms[],
 		return;
 	}
 	
-	aprintf("%-7s%-14s%-8s%-20s\n","Timer","Remaining ms","Object",
-		"Message");
+	aprintf("%-7s%-14s%-10s%-8s%-20s\n","Timer","Remaining ms","Period",
+		"Object","Message");
 	AdminShowOneTimer(t);
 }
 
@@ -2037,8 +2093,8 @@ void AdminShowOneTimer(timer_node *t)
 	
 	expire_time = (int)(t->time - GetMilliCount());
 	
-	aprintf("%5i  %-14u%-8i%-20s\n",t->timer_id,expire_time,
-		t->object_id,GetNameByID(t->message_id));
+	aprintf("%5i  %-14u%-10i%-8i%-20s\n",t->timer_id,expire_time,
+		t->period,t->object_id,GetNameByID(t->message_id));
 }
 
 void AdminShowTime(int session_id,admin_parm_type parms[],
@@ -2138,6 +2194,7 @@ void AdminShowEachSysTimer(systimer_node *st)
 	case SYST_INTERFACE_UPDATE : s = "Update interface"; break;
 	case SYST_RESET_TRANSMITTED : s = "Reset TX count"; break;
 	case SYST_RESET_POOL : s = "Reset buffer pool"; break;
+	case SYST_RECLAIM_LISTS : s = "Reclaim list nodes"; break;
 	default : s = "Unknown"; break;
 	}
 	aprintf("%i %-18s %-15s ",st->systimer_type,s,RelativeTimeStr(st->period));
@@ -2219,6 +2276,7 @@ void AdminShowCalls(int session_id,admin_parm_type parms[],
 		case DELETETIMER : strcpy(c_name, "DeleteTimer"); break;
 		case GETTIMEREMAINING : strcpy(c_name, "GetTimeRemaining"); break;
 		case ISTIMER : strcpy(c_name, "IsTimer"); break;
+		case CREATEPERIODICTIMER : strcpy(c_name, "CreatePeriodicTimer"); break;
 		case MOVESECTORBSP: strcpy(c_name, "MoveSectorBSP"); break;
 		case CHANGETEXTUREBSP: strcpy(c_name, "ChangeTextureBSP"); break;
 		case CREATEROOMDATA : strcpy(c_name, "CreateRoomData"); break;
@@ -2230,10 +2288,20 @@ void AdminShowCalls(int session_id,admin_parm_type parms[],
 		case GETLOCATIONINFOBSP: strcpy(c_name, "GetLocationInfoBSP"); break;
 		case GETRANDOMPOINTBSP: strcpy(c_name, "GetRandomPointBSP"); break;
 		case GETSTEPTOWARDSBSP: strcpy(c_name, "GetStepTowardsBSP"); break;
+		case GETSTEPSTOWARDSBSP: strcpy(c_name, "GetStepsTowardsBSP"); break;
+		case GETPATHBSP: strcpy(c_name, "GetPathBSP"); break;
 		case BLOCKERADDBSP: strcpy(c_name, "BlockerAddBSP"); break;
 		case BLOCKERMOVEBSP: strcpy(c_name, "BlockerMoveBSP"); break;
 		case BLOCKERREMOVEBSP: strcpy(c_name, "BlockerRemoveBSP"); break;
 		case BLOCKERCLEARBSP: strcpy(c_name, "BlockerClearBSP"); break;
+		case INTERESTADD: strcpy(c_name, "InterestAdd"); break;
+		case INTERESTMOVE: strcpy(c_name, "InterestMove"); break;
+		case INTERESTREMOVE: strcpy(c_name, "InterestRemove"); break;
+		case INTERESTQUERY: strcpy(c_name, "InterestQuery"); break;
+		case INTERESTSENDPACKET: strcpy(c_name, "InterestSendPacket"); break;
+		case GETOBJECTSINRADIUS: strcpy(c_name, "GetObjectsInRadius"); break;
+		case GETNEARESTOBJECTS: strcpy(c_name, "GetNearestObjects"); break;
+		case GETOBJECTSINVIEW: strcpy(c_name, "GetObjectsInView"); break;
 		case MINIGAMENUMBERTOSTRING : strcpy(c_name, "MinigameNumberToString"); break;
 		case MINIGAMESTRINGTONUMBER : strcpy(c_name, "MinigameStringToNumber"); break;
 		case APPENDLISTELEM : strcpy(c_name, "AppendListElem"); break;
@@ -2424,7 +2492,7 @@ void AdminShowInstances(int session_id,admin_parm_type parms[],
 {
 	int i, m;
 	class_node *c;
-	extern object_node* objects;
+	extern chunk_array<object_node> objects;
 	extern int num_objects;
 	
 	char *class_str;
@@ -2472,7 +2540,7 @@ void AdminShowMatches(int session_id,admin_parm_type parms[],
 	int tag_int;
 	int data_int;
 	int property_id;
-	extern object_node* objects;
+	extern chunk_array<object_node> objects;
 	extern int num_objects;
 	enum { none=0,isequal=1,isgreater=2,isless=4,sametag=8,difftag=16 };
 	int matchtype;
@@ -2706,21 +2774,16 @@ void AdminShowTable(int session_id,admin_parm_type parms[],
       aprintf("Table %i is empty.\n", table_id);
       return;
    }
-	aprintf("Table %i (size %i)\n",table_id,tn->size);
+	aprintf("Table %i (size %i, %i entries)\n",table_id,tn->size,tn->num_entries);
 	aprintf("----------------------------------------------------------------------\n");
 	for (i=0;i<tn->size;i++)
 	{
-		hn = tn->table[i];
-		if (hn != NULL)
+		hn = &tn->table[i];
+		if (hn->hash != 0)
 		{
-			aprintf("hash %5i : ",i);
-			while (hn != NULL)
-			{
-				aprintf("(key %s %s ",GetTagName(hn->key_val),GetDataName(hn->key_val));
-				aprintf("val %s %s) ",GetTagName(hn->data_val),GetDataName(hn->data_val));
-				hn = hn->next;
-			}
-			aprintf("\n");
+			aprintf("slot %5i : ",i);
+			aprintf("(key %s %s ",GetTagName(hn->key_val),GetDataName(hn->key_val));
+			aprintf("val %s %s)\n",GetTagName(hn->data_val),GetDataName(hn->data_val));
 		}
 	}
 	   
@@ -2838,7 +2901,7 @@ void AdminShowReferencesEachObject(object_node *o)
 			admin_show_references_current_prop = "self";
 		else
 			admin_show_references_current_prop =
-			GetPropertyNameByID(admin_show_references_current_class,o->p[i].id);
+			GetPropertyNameByID(admin_show_references_current_class,i);
 		
 		if (o->p[i].val.int_val == admin_show_references_value.int_val)
 		{
@@ -2920,8 +2983,8 @@ void AdminShowReferencesEachTable(int table_id, int parent_id)
    }
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.int_val == admin_show_references_value.int_val)
             aprintf(": OBJECT %i CLASS %s %s = TABLE containing %s %s\n",
@@ -2934,7 +2997,6 @@ void AdminShowReferencesEachTable(int table_id, int parent_id)
             AdminShowReferencesEachList(hn->data_val.v.data, table_id);
          else if (hn->data_val.v.tag == TAG_TABLE)
             AdminShowReferencesEachTable(hn->data_val.v.data, table_id);
-         hn = hn->next;
       }
    }
 }
@@ -2942,6 +3004,39 @@ void AdminShowReferencesEachTable(int table_id, int parent_id)
 /* in parsecli.c */
 extern client_table_node *user_table,*system_table,*usercommand_table;
 
+void AdminShowPosts(int session_id,admin_parm_type parms[],
+                    int num_blak_parm,parm_node blak_parm[])
+{
+	post_stat_type *pstat;
+	class_node *c;
+	std::vector<std::pair<int,int> > classes; /* post count, class id */
+	int i;
+	
+	pstat = GetPostStats();
+	
+	aprintf("%.0f messages posted, %i waiting, most waiting was %i\n",
+		pstat->num_posted,GetPostQueueDepth(),pstat->depth_highest);
+	aprintf("%i queue segments of %i bytes allocated, most was %i\n",
+		pstat->segments_used,POST_SEGMENT_SIZE,pstat->segments_highest);
+	if (pstat->num_drains > 0)
+		aprintf("Running posts took %.1f us on average, %i us at most\n",
+			pstat->drain_time/pstat->num_drains,pstat->drain_time_highest);
+	
+	for (i=0;i<(int)pstat->by_class.size();i++)
+		if (pstat->by_class[i] > 0)
+			classes.push_back(std::make_pair(pstat->by_class[i],i));
+	std::sort(classes.rbegin(),classes.rend());
+	
+	if (classes.size() > 0)
+		aprintf("%-8s %s\n","Posts","Posting class");
+	for (i=0;i<(int)classes.size() && i<20;i++)
+	{
+		c = GetClassByID(classes[i].second);
+		aprintf("%-8i %s\n",classes[i].first,
+			c ? c->class_name : "(unknown)");
+	}
+}
+
 void AdminShowProtocol(int session_id,admin_parm_type parms[],
                        int num_blak_parm,parm_node blak_parm[])
 {
@@ -4286,11 +4381,6 @@ void AdminSendObject(int session_id,admin_parm_type parms[],
    aprintf("Message %s completed in %.3f microseconds.\n", message_name,
       GetMicroCountDouble() - startTime);
 
-	/* Note that o may be invalid from here if we needed to resize our object array
-    * mid-message.  Messages that could create a ton of objects could do that, such
-	* as Meridian's RecreateAll() message.
-	*/
-	
 	tag = GetTagName(blak_val);
 	data = GetDataName(blak_val);
 	aprintf(":< return from OBJECT %i MESSAGE %s (%i)\n", object_id,message_name,m->message_id);
@@ -4489,6 +4579,83 @@ void AdminTraceOffMessage(int session_id,admin_parm_type parms[],
 	m->trace_session_id = INVALID_ID;
 }
 
+void AdminProfileStart(int session_id,admin_parm_type parms[],
+                       int num_blak_parm,parm_node blak_parm[])
+{
+	int interval;
+	interval = (int)parms[0];
+	
+	StartKodProfile(interval);
+	aprintf("Blakod profiling on, sampling every %i instructions.\n",
+		GetKodProfileInterval());
+}
+
+void AdminProfileStop(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[])
+{
+	StopKodProfile();
+	aprintf("Blakod profiling off, %i samples kept.\n",GetKodProfileSamples());
+}
+
+void AdminProfileClear(int session_id,admin_parm_type parms[],
+                       int num_blak_parm,parm_node blak_parm[])
+{
+	ClearKodProfile();
+	aprintf("Blakod profile cleared.\n");
+}
+
+void AdminProfileSave(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[])
+{
+	char *filename;
+	char path[MAX_PATH+FILENAME_MAX];
+	
+	filename = (char *)parms[0];
+	
+	/* only plain file names, always in the log directory */
+	if (strchr(filename,'/') != NULL || strchr(filename,'\\') != NULL ||
+		strchr(filename,':') != NULL)
+	{
+		aprintf("File name %s may not contain a path.\n",filename);
+		return;
+	}
+	
+	sprintf(path,"%s%s",ConfigStr(PATH_CHANNEL),filename);
+	if (WriteKodProfile(path))
+		aprintf("Wrote %i samples to %s.\n",GetKodProfileSamples(),path);
+	else
+		aprintf("Unable to write %s.\n",path);
+}
+
+static int admin_profile_total;
+
+static void AdminProfileShowLeaf(profile_frame *f,int samples)
+{
+	class_node *c;
+	char *name;
+	
+	c = GetClassByID(f->class_id);
+	name = GetNameByID(f->message_id);
+	aprintf("%-8i %5.1f%% %s::%s line %i\n",samples,
+		100.0*samples/admin_profile_total,c ? c->class_name : "(unknown)",
+		name ? name : "(unknown)",f->line);
+}
+
+void AdminProfileShow(int session_id,admin_parm_type parms[],
+                      int num_blak_parm,parm_node blak_parm[])
+{
+	aprintf("Blakod profiling is %s, sampling every %i instructions.\n",
+		IsKodProfiling() ? "on" : "off",GetKodProfileInterval());
+	
+	admin_profile_total = GetKodProfileSamples();
+	aprintf("%i samples taken.\n",admin_profile_total);
+	if (admin_profile_total == 0)
+		return;
+	
+	aprintf("%-8s %6s %s\n","Samples","","Innermost handler");
+	ForEachKodProfileLeaf(20,AdminProfileShowLeaf);
+}
+
 void AdminAddCredits(int session_id,admin_parm_type parms[],
                      int num_blak_parm,parm_node blak_parm[])                     
 {
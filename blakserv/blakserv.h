@@ -185,6 +185,7 @@ typedef unsigned long long UINT64;
 #endif  // BLAK_PLATFORM_LINUX
 
 #include <algorithm>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -251,6 +252,7 @@ char * GetLastErrorStr();
 #include "list.h"
 #include "loadkod.h"
 #include "sendmsg.h"
+#include "kodprof.h"
 #include "ccode.h"
 #include "timer.h"
 #include "account.h"
@@ -296,6 +298,7 @@ char * GetLastErrorStr();
 #include "rscfile.h"
 #include "systimer.h"
 #include "memory.h"
+#include "chunkarr.h"
 
 #include "interface.h"
 #include "intrlock.h"
@@ -16,16 +16,32 @@
 #define INIT_STRING_NODES 50000
 #define LEN_TEMP_STRING LEN_MAX_CLIENT_MSG
 
+/* the characters of a string, shared by string nodes and never changed */
+typedef struct string_body_struct
+{
+   int refs;
+   int len;
+   unsigned int hash;       /* of the exact characters, for interning */
+   unsigned int fuzzy_hash; /* what GetTableHash() gives this string */
+   int fuzzy_len;           /* length without leading/trailing whitespace */
+   Bool interned;
+   struct string_body_struct *next; /* in the intern table */
+   char data[1];            /* len characters and a null */
+} string_body;
+
 typedef struct
 {
    char *data;
    int len_data;
    int garbage_ref;
+   string_body *body; /* NULL for the temp string */
 } string_node;
 
 void InitString(void);
 void ResetString(void);
 int GetStringsUsed(void);
+int GetStringBodiesUsed(void);
+int GetStringBodiesInterned(void);
 string_node * GetStringByID(int string_id);
 Bool IsStringByID(int string_id);
 int CreateString(const char *new_str);
@@ -38,6 +54,8 @@ void SetNumStrings(int new_num_strings);
 int GetNumStrings(void);
 
 void SetString(string_node *snod,char *buf,int len);
+unsigned int GetStringNodeHash(string_node *snod);
+Bool StringNodesEqual(string_node *s1,string_node *s2);
 
 void SetTempString(char *buf,int len);
 void ClearTempString(void);
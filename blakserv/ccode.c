@@ -18,6 +18,8 @@
 
 #include "blakserv.h"
 
+#include <vector>
+
 #define iswhite(c) ((c)==' ' || (c)=='\t' || (c)=='\n' || (c)=='\r')
 
 // global buffers for zero-terminated string manipulation
@@ -569,6 +571,10 @@ int C_SendMessage(int object_id,local_var_type *local_vars,
             int num_name_parms,parm_node name_parm_array[])
 {
    val_type object_val,message_val;
+   send_cache_type *cache;
+
+   /* grab the call site's cache before anything else can make a call */
+   cache = GetCallSendCache();
 
    /* Get the object (or class or int) to which we are sending the message */
    /* Not to be confused with object_id, which is the 'self' object sending the message */
@@ -600,15 +606,16 @@ int C_SendMessage(int object_id,local_var_type *local_vars,
    }
 
    if (object_val.v.tag == TAG_OBJECT)
-      return SendBlakodMessage(object_val.v.data, message_val.v.data, num_name_parms, name_parm_array);
+      return SendBlakodMessageCached(object_val.v.data, message_val.v.data,
+                  num_name_parms, name_parm_array, cache);
 
    if (object_val.v.tag == TAG_INT)
    {
       /* Can send to built-in objects using constants. */
       object_val.v.data = GetBuiltInObjectID(object_val.v.data);
       if (object_val.v.data > INVALID_OBJECT)
-         return SendBlakodMessage(object_val.v.data, message_val.v.data,
-                     num_name_parms, name_parm_array);
+         return SendBlakodMessageCached(object_val.v.data, message_val.v.data,
+                     num_name_parms, name_parm_array, cache);
    }
 
    if (object_val.v.tag == TAG_CLASS)
@@ -1093,19 +1100,8 @@ int C_IsClass(int object_id,local_var_type *local_vars,
 		return NIL;
 	}
 	
-	do
-	{
-		if (c->class_id == class_val.v.data)
-		{
-			ret_val.v.tag = TAG_INT;
-			ret_val.v.data = True;
-			return ret_val.int_val;
-		}
-		c = c->super_ptr;
-	} while (c != NULL);
-	
 	ret_val.v.tag = TAG_INT;
-	ret_val.v.data = False;
+	ret_val.v.data = IsClassDescendant(c,GetClassByID(class_val.v.data));
 	return ret_val.int_val;
 }
 
@@ -1338,7 +1334,17 @@ int C_StringEqual(int object_id,local_var_type *local_vars,
       return ret_val.int_val;
    }
 
-   // Neither strings are resources.
+   // Neither strings are resources.  Blakod strings can be compared by
+   // their bodies.
+   if ((s1_val.v.tag == TAG_STRING || s1_val.v.tag == TAG_TEMP_STRING) &&
+       (s2_val.v.tag == TAG_STRING || s2_val.v.tag == TAG_TEMP_STRING))
+   {
+      ret_val.v.data = StringNodesEqual(
+         s1_val.v.tag == TAG_STRING ? GetStringByID(s1_val.v.data) : GetTempString(),
+         s2_val.v.tag == TAG_STRING ? GetStringByID(s2_val.v.data) : GetTempString());
+      return ret_val.int_val;
+   }
+
    len1 = strlen(s1);
    len2 = strlen(s2);
    ret_val.v.data = FuzzyBufferEqual(s1, len1, s2, len2);
@@ -1406,7 +1412,7 @@ int C_StringSubstitute(int object_id,local_var_type *local_vars,
 {
 	val_type s0_val, s1_val, s2_val, r_val;
 	string_node *snod0, *snod1;
-	char buf0[LEN_MAX_CLIENT_MSG+1], buf1[LEN_MAX_CLIENT_MSG+1];
+	char buf0[LEN_MAX_CLIENT_MSG+1], buf1[LEN_MAX_CLIENT_MSG+1], buf2[LEN_MAX_CLIENT_MSG+1];
 	char *s0, *copyspot;
    const char *s1, *s2, *subspot;
 	int len1, len2, new_len;
@@ -1532,23 +1538,9 @@ int C_StringSubstitute(int object_id,local_var_type *local_vars,
 	
 	if( subspot != NULL )	// only substitute if string1 is found in string0
 	{
-		char* source;
-		int source_len;
-		
-		source_len = snod0->len_data;
-		source = (char *)AllocateMemory(MALLOC_ID_STRING, source_len+1);
-		memcpy(source, snod0->data, source_len);
-		source[source_len] = '\0';
-		
-		if (snod0 != GetTempString())
-		{
-			// free the old string0 and allocate a new (possibly longer) string0
-			FreeMemory(MALLOC_ID_STRING,snod0->data,snod0->len_data);
-			snod0->data = (char *) AllocateMemory( MALLOC_ID_STRING, new_len+1);
-		}
-		
+		// build the result separately, string bodies are never changed
 		// copy the piece before string1
-		copyspot = snod0->data;
+		copyspot = buf2;
 		memcpy( copyspot, s0, subspot - s0 );
 		
 		// copy string2
@@ -1558,10 +1550,8 @@ int C_StringSubstitute(int object_id,local_var_type *local_vars,
 		// copy the piece after string1
 		copyspot += len2;
 		memcpy( copyspot, subspot + len1, new_len - (subspot - s0) - len2 );
-		snod0->len_data = new_len;
-		snod0->data[snod0->len_data] = '\0';
 		
-		FreeMemory(MALLOC_ID_STRING,source,source_len+1);
+		SetString(snod0,buf2,new_len);
 		
 		r_val.v.data = 1;
 	}
@@ -2248,6 +2238,63 @@ int C_CreateTimer(int object_id,local_var_type *local_vars,
 	return ret_val.int_val;
 }
 
+/* like CreateTimer, but the timer fires every period milliseconds and
+   keeps its id until it is deleted */
+int C_CreatePeriodicTimer(int object_id,local_var_type *local_vars,
+				  int num_normal_parms,parm_node normal_parm_array[],
+				  int num_name_parms,parm_node name_parm_array[])
+{
+	val_type object_val,message_val,period_val,ret_val;
+	object_node *o;
+	
+	o = GetObjectByID(object_id);
+	if (o == NULL)
+	{
+		eprintf("C_CreatePeriodicTimer can't find object %i\n",object_id);
+		return NIL;
+	}
+	
+	object_val = RetrieveValue(object_id,local_vars,normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	if (object_val.v.tag != TAG_OBJECT)
+	{
+		bprintf("C_CreatePeriodicTimer can't create a timer for non-object %i,%i\n",
+			object_val.v.tag,object_val.v.data);
+		return NIL;
+	}
+	
+	message_val = RetrieveValue(object_id,local_vars,normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	if (message_val.v.tag != TAG_MESSAGE)
+	{
+		bprintf("C_CreatePeriodicTimer can't create timer w/ non-message id %i,%i\n",
+			message_val.v.tag,message_val.v.data);
+		return NIL;
+	}
+	
+	period_val = RetrieveValue(object_id,local_vars,normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	if (period_val.v.tag != TAG_INT || period_val.v.data <= 0)
+	{
+		bprintf("C_CreatePeriodicTimer can't create timer w/ non-positive period %i,%i\n",
+			period_val.v.tag,period_val.v.data);
+		return NIL;
+	}
+	
+	if (GetMessageByID(o->class_id,message_val.v.data,NULL) == NULL)
+	{
+		bprintf("C_CreatePeriodicTimer can't create timer w/ message %i not for class %i\n",
+			message_val.v.data,o->class_id);
+		return NIL;
+	}
+	
+	ret_val.v.tag = TAG_TIMER;
+	ret_val.v.data = CreatePeriodicTimer(o->object_id,message_val.v.data,
+		period_val.v.data,period_val.v.data);
+	
+	return ret_val.int_val;
+}
+
 int C_DeleteTimer(int object_id,local_var_type *local_vars,
 				  int num_normal_parms,parm_node normal_parm_array[],
 				  int num_name_parms,parm_node name_parm_array[])
@@ -2572,10 +2619,10 @@ int C_GetLocationInfoBSP(int object_id, local_var_type *local_vars,
 		local_vars->locals[ceilingheight.v.data].v.tag = TAG_INT;
 		local_vars->locals[ceilingheight.v.data].v.data = FLOATTOKODINT(FINENESSROOTOKOD(heightC));
 
-		if (leaf && leaf->Sector)
+		if (leaf && leaf->SectorNum)
 		{
 			local_vars->locals[serverid.v.data].v.tag = TAG_INT;
-			local_vars->locals[serverid.v.data].v.data = leaf->Sector->ServerID;
+			local_vars->locals[serverid.v.data].v.data = ROOMSECTOR(&r->data, leaf->SectorNum)->ServerID;
 		}
 
 		// mark succeeded
@@ -3594,6 +3641,906 @@ int C_GetStepTowardsBSP(int object_id, local_var_type *local_vars,
 	return ret_val.int_val;
 }
 
+// Steps of the GetStepsTowardsBSP call being done, kept to reuse the memory.
+static std::vector<BSPStep> steps_towards;
+
+/*
+ * RetrieveStepEntry: reads a GetStepsTowardsBSP entry, [object, row, col,
+ *    finerow, finecol, row_dest, col_dest, finerow_dest, finecol_dest,
+ *    state_flags], into step. Returns false if it's malformed.
+ */
+static bool RetrieveStepEntry(val_type entry_val, BSPStep *step)
+{
+	val_type vals[10];
+	list_node *l;
+	int i;
+
+	if (entry_val.v.tag != TAG_LIST)
+		return false;
+
+	l = GetListNodeByID(entry_val.v.data);
+	for (i = 0; i < 10; i++)
+	{
+		if (l == NULL)
+			return false;
+
+		vals[i] = l->first;
+		if (i > 0 && vals[i].v.tag != TAG_INT)
+			return false;
+
+		l = (l->rest.v.tag == TAG_LIST) ? GetListNodeByID(l->rest.v.data) : NULL;
+	}
+
+	if (vals[0].v.tag != TAG_OBJECT)
+		return false;
+
+	step->ObjectID = vals[0].v.data;
+	step->S.X = GRIDCOORDTOROO(vals[2].v.data, vals[4].v.data);
+	step->S.Y = GRIDCOORDTOROO(vals[1].v.data, vals[3].v.data);
+	step->E.X = GRIDCOORDTOROO(vals[6].v.data, vals[8].v.data);
+	step->E.Y = GRIDCOORDTOROO(vals[5].v.data, vals[7].v.data);
+	step->Flags = (unsigned int)vals[9].v.data;
+	step->Moved = false;
+
+	return true;
+}
+
+/*
+ * C_GetStepsTowardsBSP: GetStepTowardsBSP for many objects of one room in
+ *    one call. Takes the room and a list of [object, row, col, finerow,
+ *    finecol, row_dest, col_dest, finerow_dest, finecol_dest, state_flags],
+ *    and returns a list of [object, row, col, finerow, finecol, state_flags]
+ *    for the objects that could step, in the same order. Their blockers are
+ *    moved already.
+ */
+int C_GetStepsTowardsBSP(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, steps_val, entry_val, coord_val;
+	list_node *l;
+	room_node *r;
+	BSPStep step;
+
+	// in case it fails
+	ret_val.int_val = NIL;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	steps_val = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_GetStepsTowardsBSP can't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (steps_val.v.tag == TAG_NIL)
+		return ret_val.int_val;
+
+	if (steps_val.v.tag != TAG_LIST)
+	{
+		bprintf("C_GetStepsTowardsBSP can't use non list %i,%i\n",
+			steps_val.v.tag, steps_val.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_GetStepsTowardsBSP can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	steps_towards.clear();
+	l = GetListNodeByID(steps_val.v.data);
+	while (l != NULL)
+	{
+		if (RetrieveStepEntry(l->first, &step))
+			steps_towards.push_back(step);
+		else
+			bprintf("C_GetStepsTowardsBSP can't use bad entry %i,%i\n",
+				l->first.v.tag, l->first.v.data);
+
+		l = (l->rest.v.tag == TAG_LIST) ? GetListNodeByID(l->rest.v.data) : NULL;
+	}
+
+	if (steps_towards.empty())
+		return ret_val.int_val;
+
+	BSPGetStepsTowards(&r->data, &steps_towards[0], (int)steps_towards.size());
+
+	// built from the end, so it's in the order of the steps
+	for (int i = (int)steps_towards.size() - 1; i >= 0; i--)
+	{
+		BSPStep *s = &steps_towards[i];
+		if (!s->Moved)
+			continue;
+
+		entry_val.int_val = NIL;
+		coord_val.v.tag = TAG_INT;
+
+		coord_val.v.data = s->Flags;
+		entry_val.v.data = Cons(coord_val, entry_val);
+		entry_val.v.tag = TAG_LIST;
+
+		coord_val.v.data = ROOCOORDTOGRIDFINE(s->P.X);
+		entry_val.v.data = Cons(coord_val, entry_val);
+
+		coord_val.v.data = ROOCOORDTOGRIDFINE(s->P.Y);
+		entry_val.v.data = Cons(coord_val, entry_val);
+
+		coord_val.v.data = ROOCOORDTOGRIDBIG(s->P.X);
+		entry_val.v.data = Cons(coord_val, entry_val);
+
+		coord_val.v.data = ROOCOORDTOGRIDBIG(s->P.Y);
+		entry_val.v.data = Cons(coord_val, entry_val);
+
+		coord_val.v.tag = TAG_OBJECT;
+		coord_val.v.data = s->ObjectID;
+		entry_val.v.data = Cons(coord_val, entry_val);
+
+		ret_val.v.data = Cons(entry_val, ret_val);
+		ret_val.v.tag = TAG_LIST;
+	}
+	steps_towards.clear();
+
+	return ret_val.int_val;
+}
+
+int C_GetPathBSP(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val;
+	val_type row_source, col_source, finerow_source, finecol_source;
+	val_type row_dest, col_dest, finerow_dest, finecol_dest;
+	val_type waypoint_val, coord_val;
+	room_node *r;
+
+	// in case it fails
+	ret_val.int_val = NIL;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	row_source = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	col_source = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	finerow_source = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	finecol_source = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	row_dest = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+	col_dest = RetrieveValue(object_id, local_vars, normal_parm_array[6].type,
+		normal_parm_array[6].value);
+	finerow_dest = RetrieveValue(object_id, local_vars, normal_parm_array[7].type,
+		normal_parm_array[7].value);
+	finecol_dest = RetrieveValue(object_id, local_vars, normal_parm_array[8].type,
+		normal_parm_array[8].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_GetPathBSP can't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row_source.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP row source can't use non int %i,%i\n",
+			row_source.v.tag, row_source.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col_source.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP col source can't use non int %i,%i\n",
+			col_source.v.tag, col_source.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow_source.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP finerow source can't use non int %i,%i\n",
+			finerow_source.v.tag, finerow_source.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol_source.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP finecol source can't use non int %i,%i\n",
+			finecol_source.v.tag, finecol_source.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row_dest.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP row dest can't use non int %i,%i\n",
+			row_dest.v.tag, row_dest.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col_dest.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP col dest can't use non int %i,%i\n",
+			col_dest.v.tag, col_dest.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow_dest.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP finerow dest can't use non int %i,%i\n",
+			finerow_dest.v.tag, finerow_dest.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol_dest.v.tag != TAG_INT)
+	{
+		bprintf("C_GetPathBSP finecol dest can't use non int %i,%i\n",
+			finecol_dest.v.tag, finecol_dest.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_GetPathBSP can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	V2 s;
+	s.X = GRIDCOORDTOROO(col_source.v.data, finecol_source.v.data);
+	s.Y = GRIDCOORDTOROO(row_source.v.data, finerow_source.v.data);
+
+	V2 e;
+	e.X = GRIDCOORDTOROO(col_dest.v.data, finecol_dest.v.data);
+	e.Y = GRIDCOORDTOROO(row_dest.v.data, finerow_dest.v.data);
+
+	V2 path[NAVMAXPATH];
+	int count;
+	if (!BSPGetPath(&r->data, &s, &e, path, NAVMAXPATH, &count))
+		return ret_val.int_val;
+
+	// list of [row, col, finerow, finecol] for each waypoint, built from the end
+	coord_val.v.tag = TAG_INT;
+	for (int i = count - 1; i >= 0; i--)
+	{
+		waypoint_val.int_val = NIL;
+
+		coord_val.v.data = ROOCOORDTOGRIDFINE(path[i].X);
+		waypoint_val.v.data = Cons(coord_val, waypoint_val);
+		waypoint_val.v.tag = TAG_LIST;
+
+		coord_val.v.data = ROOCOORDTOGRIDFINE(path[i].Y);
+		waypoint_val.v.data = Cons(coord_val, waypoint_val);
+
+		coord_val.v.data = ROOCOORDTOGRIDBIG(path[i].X);
+		waypoint_val.v.data = Cons(coord_val, waypoint_val);
+
+		coord_val.v.data = ROOCOORDTOGRIDBIG(path[i].Y);
+		waypoint_val.v.data = Cons(coord_val, waypoint_val);
+
+		ret_val.v.data = Cons(waypoint_val, ret_val);
+		ret_val.v.tag = TAG_LIST;
+	}
+
+	return ret_val.int_val;
+}
+
+int C_InterestAdd(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, obj_val, session_val;
+	val_type row, col, finerow, finecol;
+	room_node *r;
+
+	ret_val.v.tag = TAG_INT;
+	ret_val.v.data = false;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	obj_val = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	session_val = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	row = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	col = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	finerow = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+	finecol = RetrieveValue(object_id, local_vars, normal_parm_array[6].type,
+		normal_parm_array[6].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_InterestAdd room_valcan't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (obj_val.v.tag != TAG_OBJECT)
+	{
+		bprintf("C_InterestAdd obj_valcan't use non obj %i,%i\n",
+			obj_val.v.tag, obj_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (session_val.v.tag != TAG_SESSION && session_val.int_val != NIL)
+	{
+		bprintf("C_InterestAdd session can't use non session %i,%i\n",
+			session_val.v.tag, session_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestAdd row can't use non int %i,%i\n",
+			row.v.tag, row.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestAdd col can't use non int %i,%i\n",
+			col.v.tag, col.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestAdd finerow can't use non int %i,%i\n",
+			finerow.v.tag, finerow.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestAdd finecol can't use non int %i,%i\n",
+			finecol.v.tag, finecol.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_InterestAdd can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	V2 p;
+	p.X = GRIDCOORDTOROO(col.v.data, finecol.v.data);
+	p.Y = GRIDCOORDTOROO(row.v.data, finerow.v.data);
+
+	ret_val.v.data = InterestAdd(r, obj_val.v.data,
+		session_val.v.tag == TAG_SESSION ? session_val.v.data : -1, &p);
+
+	return ret_val.int_val;
+}
+
+int C_InterestMove(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, obj_val;
+	val_type row, col, finerow, finecol;
+	room_node *r;
+
+	ret_val.v.tag = TAG_INT;
+	ret_val.v.data = false;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	obj_val = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	row = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	col = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	finerow = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	finecol = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_InterestMove room_valcan't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (obj_val.v.tag != TAG_OBJECT)
+	{
+		bprintf("C_InterestMove obj_valcan't use non obj %i,%i\n",
+			obj_val.v.tag, obj_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestMove row can't use non int %i,%i\n",
+			row.v.tag, row.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestMove col can't use non int %i,%i\n",
+			col.v.tag, col.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestMove finerow can't use non int %i,%i\n",
+			finerow.v.tag, finerow.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestMove finecol can't use non int %i,%i\n",
+			finecol.v.tag, finecol.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_InterestMove can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	V2 p;
+	p.X = GRIDCOORDTOROO(col.v.data, finecol.v.data);
+	p.Y = GRIDCOORDTOROO(row.v.data, finerow.v.data);
+
+	ret_val.v.data = InterestMove(r, obj_val.v.data, &p);
+
+	return ret_val.int_val;
+}
+
+int C_InterestRemove(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, obj_val;
+	room_node *r;
+
+	ret_val.v.tag = TAG_INT;
+	ret_val.v.data = false;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	obj_val = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_InterestRemove room_valcan't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (obj_val.v.tag != TAG_OBJECT)
+	{
+		bprintf("C_InterestRemove obj_valcan't use non obj %i,%i\n",
+			obj_val.v.tag, obj_val.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_InterestRemove can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	ret_val.v.data = InterestRemove(r, obj_val.v.data);
+
+	return ret_val.int_val;
+}
+
+// list of the objects InterestQuery found so far
+static val_type interest_query_list;
+
+static void AddInterestQueryObject(interest_node *i)
+{
+	val_type obj_val;
+
+	obj_val.v.tag = TAG_OBJECT;
+	obj_val.v.data = i->object_id;
+	interest_query_list.v.data = Cons(obj_val, interest_query_list);
+	interest_query_list.v.tag = TAG_LIST;
+}
+
+int C_InterestQuery(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, radius;
+	val_type row, col, finerow, finecol;
+	room_node *r;
+
+	// in case it fails
+	ret_val.int_val = NIL;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	row = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	col = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	finerow = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	finecol = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	radius = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_InterestQuery room_valcan't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestQuery row can't use non int %i,%i\n",
+			row.v.tag, row.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestQuery col can't use non int %i,%i\n",
+			col.v.tag, col.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestQuery finerow can't use non int %i,%i\n",
+			finerow.v.tag, finerow.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestQuery finecol can't use non int %i,%i\n",
+			finecol.v.tag, finecol.v.data);
+		return ret_val.int_val;
+	}
+
+	if (radius.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestQuery radius can't use non int %i,%i\n",
+			radius.v.tag, radius.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_InterestQuery can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	V2 p;
+	p.X = GRIDCOORDTOROO(col.v.data, finecol.v.data);
+	p.Y = GRIDCOORDTOROO(row.v.data, finerow.v.data);
+
+	interest_query_list.int_val = NIL;
+	ForEachInterested(r, &p, FINENESSKODTOROO((float)radius.v.data), AddInterestQueryObject);
+	ret_val = interest_query_list;
+
+	return ret_val.int_val;
+}
+
+int C_InterestSendPacket(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type ret_val, room_val, except_val, radius;
+	val_type row, col, finerow, finecol;
+	room_node *r;
+
+	ret_val.v.tag = TAG_INT;
+	ret_val.v.data = 0;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	except_val = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	row = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	col = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	finerow = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	finecol = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+	radius = RetrieveValue(object_id, local_vars, normal_parm_array[6].type,
+		normal_parm_array[6].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("C_InterestSendPacket room_valcan't use non room %i,%i\n",
+			room_val.v.tag, room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (except_val.v.tag != TAG_OBJECT && except_val.int_val != NIL)
+	{
+		bprintf("C_InterestSendPacket except can't use non obj %i,%i\n",
+			except_val.v.tag, except_val.v.data);
+		return ret_val.int_val;
+	}
+
+	if (row.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestSendPacket row can't use non int %i,%i\n",
+			row.v.tag, row.v.data);
+		return ret_val.int_val;
+	}
+
+	if (col.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestSendPacket col can't use non int %i,%i\n",
+			col.v.tag, col.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finerow.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestSendPacket finerow can't use non int %i,%i\n",
+			finerow.v.tag, finerow.v.data);
+		return ret_val.int_val;
+	}
+
+	if (finecol.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestSendPacket finecol can't use non int %i,%i\n",
+			finecol.v.tag, finecol.v.data);
+		return ret_val.int_val;
+	}
+
+	if (radius.v.tag != TAG_INT)
+	{
+		bprintf("C_InterestSendPacket radius can't use non int %i,%i\n",
+			radius.v.tag, radius.v.data);
+		return ret_val.int_val;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("C_InterestSendPacket can't find room %i\n", room_val.v.data);
+		return ret_val.int_val;
+	}
+
+	V2 p;
+	p.X = GRIDCOORDTOROO(col.v.data, finecol.v.data);
+	p.Y = GRIDCOORDTOROO(row.v.data, finerow.v.data);
+
+	ret_val.v.data = InterestSendCopyPacket(r,
+		except_val.v.tag == TAG_OBJECT ? except_val.v.data : INVALID_OBJECT, &p,
+		FINENESSKODTOROO((float)radius.v.data));
+
+	return ret_val.int_val;
+}
+
+// objects ForEachInterestFound found for GetObjectsInRadius and friends
+static std::vector<int> interest_found_ids;
+
+static void AddInterestFoundObject(interest_node *i)
+{
+	interest_found_ids.push_back(i->object_id);
+}
+
+// Makes a list of the objects found, in the order they were found.
+static int MakeInterestFoundList()
+{
+	val_type list_val, obj_val;
+
+	list_val.int_val = NIL;
+	obj_val.v.tag = TAG_OBJECT;
+	for (int k = (int)interest_found_ids.size() - 1; k >= 0; k--)
+	{
+		obj_val.v.data = interest_found_ids[k];
+		list_val.v.data = Cons(obj_val, list_val);
+		list_val.v.tag = TAG_LIST;
+	}
+	interest_found_ids.clear();
+
+	return list_val.int_val;
+}
+
+/*
+ * RetrieveInterestFilter: reads the parameters GetObjectsInRadius,
+ *    GetNearestObjects and GetObjectsInView start with, (room, row, col,
+ *    finerow, finecol, radius, class, except, los), into filter. Returns
+ *    the room, or NULL if a parameter is bad.
+ */
+static room_node * RetrieveInterestFilter(const char *c_name, int object_id,
+	local_var_type *local_vars, parm_node normal_parm_array[], interest_filter *filter)
+{
+	val_type room_val, row, col, finerow, finecol, radius, class_val, except_val, los_val;
+	room_node *r;
+
+	room_val = RetrieveValue(object_id, local_vars, normal_parm_array[0].type,
+		normal_parm_array[0].value);
+	row = RetrieveValue(object_id, local_vars, normal_parm_array[1].type,
+		normal_parm_array[1].value);
+	col = RetrieveValue(object_id, local_vars, normal_parm_array[2].type,
+		normal_parm_array[2].value);
+	finerow = RetrieveValue(object_id, local_vars, normal_parm_array[3].type,
+		normal_parm_array[3].value);
+	finecol = RetrieveValue(object_id, local_vars, normal_parm_array[4].type,
+		normal_parm_array[4].value);
+	radius = RetrieveValue(object_id, local_vars, normal_parm_array[5].type,
+		normal_parm_array[5].value);
+	class_val = RetrieveValue(object_id, local_vars, normal_parm_array[6].type,
+		normal_parm_array[6].value);
+	except_val = RetrieveValue(object_id, local_vars, normal_parm_array[7].type,
+		normal_parm_array[7].value);
+	los_val = RetrieveValue(object_id, local_vars, normal_parm_array[8].type,
+		normal_parm_array[8].value);
+
+	if (room_val.v.tag != TAG_ROOM_DATA)
+	{
+		bprintf("%s can't use non room %i,%i\n", c_name,
+			room_val.v.tag, room_val.v.data);
+		return NULL;
+	}
+
+	if (row.v.tag != TAG_INT || col.v.tag != TAG_INT ||
+		finerow.v.tag != TAG_INT || finecol.v.tag != TAG_INT)
+	{
+		bprintf("%s can't use non int coordinates %i,%i %i,%i %i,%i %i,%i\n", c_name,
+			row.v.tag, row.v.data, col.v.tag, col.v.data,
+			finerow.v.tag, finerow.v.data, finecol.v.tag, finecol.v.data);
+		return NULL;
+	}
+
+	if (radius.v.tag != TAG_INT)
+	{
+		bprintf("%s radius can't use non int %i,%i\n", c_name,
+			radius.v.tag, radius.v.data);
+		return NULL;
+	}
+
+	if (class_val.v.tag != TAG_CLASS && class_val.int_val != NIL)
+	{
+		bprintf("%s class can't use non class %i,%i\n", c_name,
+			class_val.v.tag, class_val.v.data);
+		return NULL;
+	}
+
+	if (except_val.v.tag != TAG_OBJECT && except_val.int_val != NIL)
+	{
+		bprintf("%s except can't use non obj %i,%i\n", c_name,
+			except_val.v.tag, except_val.v.data);
+		return NULL;
+	}
+
+	if (los_val.v.tag != TAG_INT)
+	{
+		bprintf("%s los can't use non int %i,%i\n", c_name,
+			los_val.v.tag, los_val.v.data);
+		return NULL;
+	}
+
+	r = GetRoomDataByID(room_val.v.data);
+	if (r == NULL)
+	{
+		bprintf("%s can't find room %i\n", c_name, room_val.v.data);
+		return NULL;
+	}
+
+	filter->center.X = GRIDCOORDTOROO(col.v.data, finecol.v.data);
+	filter->center.Y = GRIDCOORDTOROO(row.v.data, finerow.v.data);
+	filter->radius = FINENESSKODTOROO((float)radius.v.data);
+	filter->c = NULL;
+	if (class_val.v.tag == TAG_CLASS)
+	{
+		filter->c = GetClassByID(class_val.v.data);
+		if (filter->c == NULL)
+		{
+			bprintf("%s can't find class %i\n", c_name, class_val.v.data);
+			return NULL;
+		}
+	}
+	filter->except_object_id = (except_val.v.tag == TAG_OBJECT ? except_val.v.data : INVALID_OBJECT);
+	filter->check_view = False;
+	filter->view_angle = 0;
+	filter->check_los = (los_val.v.data != 0);
+
+	return r;
+}
+
+int C_GetObjectsInRadius(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	interest_filter filter;
+	room_node *r;
+
+	r = RetrieveInterestFilter("C_GetObjectsInRadius", object_id, local_vars,
+		normal_parm_array, &filter);
+	if (r == NULL)
+		return NIL;
+
+	ForEachInterestFound(r, &filter, 0, AddInterestFoundObject);
+
+	return MakeInterestFoundList();
+}
+
+int C_GetNearestObjects(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type count_val;
+	interest_filter filter;
+	room_node *r;
+
+	r = RetrieveInterestFilter("C_GetNearestObjects", object_id, local_vars,
+		normal_parm_array, &filter);
+	if (r == NULL)
+		return NIL;
+
+	count_val = RetrieveValue(object_id, local_vars, normal_parm_array[9].type,
+		normal_parm_array[9].value);
+	if (count_val.v.tag != TAG_INT)
+	{
+		bprintf("C_GetNearestObjects count can't use non int %i,%i\n",
+			count_val.v.tag, count_val.v.data);
+		return NIL;
+	}
+
+	if (count_val.v.data <= 0)
+		return NIL;
+
+	ForEachInterestFound(r, &filter, count_val.v.data, AddInterestFoundObject);
+
+	return MakeInterestFoundList();
+}
+
+int C_GetObjectsInView(int object_id, local_var_type *local_vars,
+	int num_normal_parms, parm_node normal_parm_array[],
+	int num_name_parms, parm_node name_parm_array[])
+{
+	val_type angle_val;
+	interest_filter filter;
+	room_node *r;
+
+	r = RetrieveInterestFilter("C_GetObjectsInView", object_id, local_vars,
+		normal_parm_array, &filter);
+	if (r == NULL)
+		return NIL;
+
+	angle_val = RetrieveValue(object_id, local_vars, normal_parm_array[9].type,
+		normal_parm_array[9].value);
+	if (angle_val.v.tag != TAG_INT)
+	{
+		bprintf("C_GetObjectsInView angle can't use non int %i,%i\n",
+			angle_val.v.tag, angle_val.v.data);
+		return NIL;
+	}
+
+	filter.check_view = True;
+	filter.view_angle = angle_val.v.data;
+	ForEachInterestFound(r, &filter, 0, AddInterestFoundObject);
+
+	return MakeInterestFoundList();
+}
+
 /*
  * C_AppendListElem: takes a list and an item to be appended to the list,
  *    appends the item to the end of the list. Returns the original list
@@ -3827,7 +4774,6 @@ int C_List(int object_id,local_var_type *local_vars,
 	ret_val.int_val = NIL;
 	for (i=num_normal_parms-1;i>=0;i--)
 	{
-		extern list_node *list_nodes;
 		temp = RetrieveValue(object_id,local_vars,normal_parm_array[i].type,
 			normal_parm_array[i].value);
 		ret_val.v.data = Cons(temp,ret_val);
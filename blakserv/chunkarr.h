@@ -0,0 +1,90 @@
+// Meridian 59, Copyright 1994-2012 Andrew Kirmse and Chris Kirmse.
+// All rights reserved.
+//
+// This software is distributed under a license that is described in
+// the LICENSE file that accompanies it.
+//
+// Meridian is a registered trademark.
+/*
+ * chunkarr.h
+ *
+
+ A chunk_array is an array indexed by id like a plain C array, but kept
+ as fixed size chunks of CHUNK_ARRAY_SIZE elements, found through a small
+ table of chunk pointers: element id is chunks[id >> CHUNK_ARRAY_SHIFT]
+ [id & CHUNK_ARRAY_MASK].
+
+ Growing it only allocates new chunks, so it never copies the elements
+ and pointers to them stay good until the array shrinks below them.  Only
+ the table of chunk pointers is ever resized, and it's small.
+
+ The objects, list nodes, strings and tables of the Blakod are kept in
+ these.
+
+ */
+
+#ifndef _CHUNKARR_H
+#define _CHUNKARR_H
+
+#define CHUNK_ARRAY_SHIFT 12
+#define CHUNK_ARRAY_SIZE (1 << CHUNK_ARRAY_SHIFT)
+#define CHUNK_ARRAY_MASK (CHUNK_ARRAY_SIZE - 1)
+
+template <class T> class chunk_array
+{
+public:
+   void Init(int new_malloc_id,int count)
+   {
+      malloc_id = new_malloc_id;
+      num_chunks = 0;
+      max_chunks = 0;
+      chunks = NULL;
+      Grow(count);
+   }
+
+   /* make room for at least count elements */
+   void Grow(int count)
+   {
+      int old_max;
+
+      while (num_chunks * CHUNK_ARRAY_SIZE < count)
+      {
+         if (num_chunks == max_chunks)
+         {
+            old_max = max_chunks;
+            max_chunks = (max_chunks == 0) ? 16 : max_chunks * 2;
+            chunks = (T **)ResizeMemory(malloc_id,chunks,old_max*sizeof(T *),
+                                        max_chunks*sizeof(T *));
+         }
+         chunks[num_chunks++] = (T *)AllocateMemory(malloc_id,CHUNK_ARRAY_SIZE*sizeof(T));
+      }
+   }
+
+   /* free the chunks not needed to hold count elements */
+   void Shrink(int count)
+   {
+      while (num_chunks > 0 && (num_chunks - 1) * CHUNK_ARRAY_SIZE >= count)
+      {
+         num_chunks--;
+         FreeMemory(malloc_id,chunks[num_chunks],CHUNK_ARRAY_SIZE*sizeof(T));
+      }
+   }
+
+   int Capacity(void) const
+   {
+      return num_chunks * CHUNK_ARRAY_SIZE;
+   }
+
+   T & operator[](int id)
+   {
+      return chunks[id >> CHUNK_ARRAY_SHIFT][id & CHUNK_ARRAY_MASK];
+   }
+
+private:
+   int malloc_id;
+   int num_chunks;
+   int max_chunks;
+   T **chunks;
+};
+
+#endif
@@ -34,6 +34,7 @@ static sihash_type class_name_map;
 /* local function prototypes */
 void SetOneClassVariables(class_node *c,class_node *setvar_class);
 void SetOneClassPropertyNames(class_node *c);
+int SetClassOrder(class_node *c,int order);
 
 void InitClass(void)
 {
@@ -123,6 +124,9 @@ void AddClass(int id,bof_class_header *class_data,char *fname,char *bof_base,
 	new_node->num_prop_defaults = props->num_default_prop_vals;
 	new_node->messages = NULL;
 	new_node->num_messages = 0;
+	new_node->dispatch = NULL;
+	new_node->dispatch_mask = 0;
+	new_node->dispatch_count = 0;
 	if (new_node->num_prop_defaults != 0)
 	{
 		new_node->prop_default = (prop_default_type *)
@@ -143,6 +147,10 @@ void AddClass(int id,bof_class_header *class_data,char *fname,char *bof_base,
 	new_node->property_names_this = NULL;
 	new_node->classvar_names = NULL;
 	new_node->super_ptr = NULL;
+	new_node->first_child = NULL;
+	new_node->next_sibling = NULL;
+	new_node->order = 0;
+	new_node->order_last = -1;
 	new_node->bof_base = bof_base; /* is really pointer to file in memory,
 	which is the base from which the dstrs are */
 	new_node->dstrs = dstrs;
@@ -196,7 +204,9 @@ void SetClassName(int id,char *name)
 /* SetClassesSuperPtr
 *
 * After calling addclass for all classes, call this to setup our class
-* hierarchy parent pointers 
+* hierarchy parent pointers.  It also numbers the class tree in preorder,
+* so that IsClassDescendant is a range check rather than a walk up the
+* super_ptr chain.
 *
 */
 void SetClassesSuperPtr(void)
@@ -204,6 +214,7 @@ void SetClassesSuperPtr(void)
 	class_node *c,*super_ptr;
 	int i;
 	int length; 
+	int order;
 
 	for (i=0;i<classes_table_size;i++)
 	{
@@ -219,7 +230,11 @@ void SetClassesSuperPtr(void)
 					eprintf("SetClassesSuperPtr found class %i with invalid parent id %i! "
 					"[possibly obsolete bof]\n",c->class_id, c->super_id);
 				else
+				{
 					c->super_ptr = super_ptr;
+					c->next_sibling = super_ptr->first_child;
+					super_ptr->first_child = c;
+				}
 			}
 			c = c->next;
 		}
@@ -228,6 +243,26 @@ void SetClassesSuperPtr(void)
 			eprintf("Fatal: Class hash bin %3i has length %i; Increase SizeClassHash in [Memory] in blakserv.cfg\n",i,length);
 
 	}
+
+	/* number each tree from its root class */
+	order = 0;
+	for (i=0;i<classes_table_size;i++)
+		for (c = classes[i]; c != NULL; c = c->next)
+			if (c->super_ptr == NULL)
+				order = SetClassOrder(c,order);
+}
+
+/* returns the next unused number */
+int SetClassOrder(class_node *c,int order)
+{
+	class_node *child;
+
+	c->order = order++;
+	for (child = c->first_child; child != NULL; child = child->next_sibling)
+		order = SetClassOrder(child,order);
+	c->order_last = order - 1;
+
+	return order;
 }
 
 void SetClassVariables(void)
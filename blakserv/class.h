@@ -31,6 +31,10 @@ typedef struct class_struct
    int super_id;
 
    message_node **messages;
+   /* open addressed, dispatch_mask+1 entries, built by SetMessagesDispatch */
+   dispatch_entry *dispatch;
+   int dispatch_mask;
+   int dispatch_count;
    char *fname;
    char *class_name;
 
@@ -55,6 +59,13 @@ typedef struct class_struct
 
    struct class_struct *super_ptr;
 
+   /* class tree links and preorder numbering, set by SetClassesSuperPtr.
+      A class's subclasses are numbered order+1 through order_last. */
+   struct class_struct *first_child;
+   struct class_struct *next_sibling;
+   int order;
+   int order_last;
+
    struct class_struct *next; /* for open hash table linked list */
 } class_node;
 
@@ -66,6 +77,14 @@ message_node *GetMessageByName(int class_id,char *message_name,class_node **foun
 /* the 629 is just a number to mult by to get reasonable hash results */
 #define GetClassHashNum(a) (((a+10000)*629)%classes_table_size)
 
+/* True if c is ancestor or one of its subclasses, in constant time.
+   A NULL ancestor matches nothing. */
+__inline Bool IsClassDescendant(class_node *c,class_node *ancestor)
+{
+   return ancestor != NULL &&
+      c->order >= ancestor->order && c->order <= ancestor->order_last;
+}
+
 
 
 void InitClass(void);
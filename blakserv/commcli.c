@@ -211,18 +211,13 @@ void ClearPacket()
 
 void ClientHangupToBlakod(session_node *session)
 {
-   val_type command,parm_list;
+   /* in parsecli.c; like the lists for client messages, it's made once
+      instead of for every hangup */
+   extern val_type cli_hangup_list;
    parm_node parms[1];
 
-   command.v.tag = TAG_INT;
-   command.v.data = BP_REQ_QUIT;
-
-   parm_list.int_val = NIL;
-   parm_list.v.data = Cons(command,parm_list);
-   parm_list.v.tag = TAG_LIST;
-
    parms[0].type = CONSTANT;
-   parms[0].value = parm_list.int_val;
+   parms[0].value = cli_hangup_list.int_val;
    parms[0].name_id = CLIENT_PARM;
 
    SendTopLevelBlakodMessage(session->game->object_id,RECEIVE_CLIENT_MSG,1,parms);
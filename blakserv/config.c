@@ -144,6 +144,7 @@ config_table_type config_table[] =
 { MEMORY_SIZE_RESOURCE_HASH,F,"SizeResourceHash", CONFIG_INT,"99971" },
 { MEMORY_SIZE_RESOURCE_NAME_HASH,F,"SizeResourceNameHash", CONFIG_INT,"99971" },
 { MEMORY_SIZE_PROPERTIES_NAME_HASH,F,"SizePropertiesNameHash", CONFIG_INT,   "499" },
+{ MEMORY_INTERN_STRINGS,  T, "InternStrings", CONFIG_BOOL,  "Yes" },
 
 { AUTO_GROUP,             F, "[Auto]",        CONFIG_GROUP, "" },
 { AUTO_GARBAGE_TIME,      F, "GarbageTime",   CONFIG_INT,   "90", }, /* minutes */
@@ -157,6 +158,7 @@ config_table_type config_table[] =
 { AUTO_TRANSMITTED_PERIOD,F, "TransmittedPeriod",CONFIG_INT,"60", }, /* seconds */
 { AUTO_RESET_POOL_TIME,   F, "ResetPoolTime", CONFIG_INT,   "0", },
 { AUTO_RESET_POOL_PERIOD, F, "ResetPoolPeriod",CONFIG_INT,  "60", },
+{ AUTO_RECLAIM_LISTS_PERIOD,F,"ReclaimListsPeriod",CONFIG_INT,"60", }, /* seconds */
 
 { EMAIL_GROUP,            F, "[Email]",       CONFIG_GROUP, "" },
 { EMAIL_LISTEN,           F, "Listen",        CONFIG_BOOL,  "No" },
@@ -226,6 +228,11 @@ config_table_type config_table[] =
 
 { BLAKOD_GROUP,           F, "[Blakod]",      CONFIG_GROUP, "" },
 { BLAKOD_MATCHES_LIST_MAX,T, "MatchesList",   CONFIG_INT,   "10000" },
+{ BLAKOD_TIMER_BATCH,     T, "TimerBatch",    CONFIG_BOOL,  "Yes" },
+	/* fire every due timer in one locked pass, up to TimerBatchMax timers
+	   or TimerBatchTime milliseconds, before going back to the sockets */
+{ BLAKOD_TIMER_BATCH_MAX, T, "TimerBatchMax", CONFIG_INT,   "256" },
+{ BLAKOD_TIMER_BATCH_MS,  T, "TimerBatchTime",CONFIG_INT,   "50" },
 };
 
 enum
@@ -68,6 +68,7 @@ enum
    MEMORY_SIZE_RESOURCE_HASH,
    MEMORY_SIZE_RESOURCE_NAME_HASH,
    MEMORY_SIZE_PROPERTIES_NAME_HASH,
+   MEMORY_INTERN_STRINGS,
 
    AUTO_GROUP,
    AUTO_GARBAGE_TIME, AUTO_GARBAGE_PERIOD, AUTO_SAVE_TIME, AUTO_SAVE_PERIOD,
@@ -75,6 +76,7 @@ enum
    AUTO_INTERFACE_UPDATE,
    AUTO_TRANSMITTED_TIME, AUTO_TRANSMITTED_PERIOD,
    AUTO_RESET_POOL_TIME, AUTO_RESET_POOL_PERIOD,
+   AUTO_RECLAIM_LISTS_PERIOD,
    AUTO_CHECK_PORTAL_TIME, AUTO_CHECK_PORTAL_PERIOD,
 
    EMAIL_GROUP,
@@ -117,6 +119,7 @@ enum
 
    BLAKOD_GROUP,
    BLAKOD_MATCHES_LIST_MAX,
+   BLAKOD_TIMER_BATCH, BLAKOD_TIMER_BATCH_MAX, BLAKOD_TIMER_BATCH_MS,
    
    NUM_CONFIG_VALUES
 };
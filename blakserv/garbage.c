@@ -40,6 +40,8 @@ void RenumberObjectContainerReferences(object_node *o);
 void RenumberTableListNodeReferences(table_node *t, int table_id);
 void RenumberListNodeReferences(val_type *vlist_ptr);
 void CompactListNode(list_node *l,int list_id);
+void MarkEveryTableListNode(table_node *t,int table_id);
+void FreeUnreferencedListNode(list_node *l,int list_id);
 
 /* Table garbage collection */
 void ClearTableGarbageRef(table_node *t,int table_id);
@@ -59,6 +61,8 @@ void DeleteUnreferencedObject(object_node *o);
 
 void RenumberObject(object_node *o);
 void RenumberBlockerObjects(room_node *r);
+void RenumberInterestObjects(room_node *r);
+void RenumberInterestNode(interest_node *i);
 void RenumberObjectReferences(object_node *o);
 void RenumberUserObjectReferences(user_node *u);
 void RenumberSessionObjectReferences(session_node *s);
@@ -205,6 +209,8 @@ void GarbageCollect()
    ForEachObject(RenumberObject);
    // Renumber object IDs in each room's blocker data.
    ForEachRoom(RenumberBlockerObjects);
+   // And in each room's interest set.
+   ForEachRoom(RenumberInterestObjects);
    ForEachObject(RenumberObjectReferences); // Also mark strings here
    ForEachListNode(RenumberListNodeObjectReferences); // Also mark strings here
    ForEachTable(RenumberTableObjectReferences); // Also mark strings here
@@ -238,6 +244,48 @@ void GarbageCollect()
    SetNumStrings(next_string_renumber);
 }
 
+/* ReclaimListNodes
+ *
+ * Finds the list nodes nothing refers to and puts them on the list free
+ * list, without renumbering anything.  The marking is the same as in
+ * GarbageCollect(), but since no ids change nobody has to be told and
+ * it can run between garbage collections.
+ *
+ * Locals of running Blakod aren't looked at, so this must only be called
+ * from the main loop, never while a message is being handled.
+ */
+void ReclaimListNodes(void)
+{
+   extern val_type cli_list_nodes[];
+   extern val_type cli_hangup_list;
+
+   if (GetMessageDepth() != 0 || GetPostQueueDepth() != 0)
+   {
+      eprintf("ReclaimListNodes called while running Blakod\n");
+      return;
+   }
+
+   ForEachListNode(ClearListNodeGarbageRef);
+   ForEachTable(ClearTableGarbageRef);
+
+   ForEachObject(MarkObjectListNodesAndTables);
+
+   // Tables nothing refers to aren't deleted until the next garbage
+   // collection, so keep what's in them until then.
+   ForEachTable(MarkEveryTableListNode);
+
+   // The lists handed to Blakod for client messages are kept around.
+   if (cli_list_nodes[0].v.tag == TAG_LIST)
+      MarkListNode(cli_list_nodes[0].v.data);
+   if (cli_hangup_list.v.tag == TAG_LIST)
+      MarkListNode(cli_hangup_list.v.data);
+
+   ClearListFreeNodes();
+   ForEachListNode(FreeUnreferencedListNode);
+
+   ForEachTable(ClearTableGarbageRef);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 void GarbageKickoffGamePick(session_node *s)
@@ -305,14 +353,13 @@ void MarkTableListNode(int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_LIST)
             MarkListNode(hn->data_val.v.data);
          else if (hn->data_val.v.tag == TAG_TABLE)
             MarkTableListNode(hn->data_val.v.data);
-         hn = hn->next;
       }
    }
 }
@@ -374,12 +421,11 @@ void RenumberTableListNodeReferences(table_node *t, int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_LIST)
             RenumberListNodeReferences(&(hn->data_val));
-         hn = hn->next;
       }
    }
 }
@@ -430,6 +476,17 @@ void CompactListNode(list_node *l,int list_id)
       MoveListNode(l->garbage_ref & ~VISITED_LIST,list_id);
 }
 
+void MarkEveryTableListNode(table_node *t,int table_id)
+{
+   MarkTableListNode(table_id);
+}
+
+void FreeUnreferencedListNode(list_node *l,int list_id)
+{
+   if (l->garbage_ref == UNREFERENCED)
+      FreeListNode(list_id);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Tables
 /////////////////////////////////////////////////////////////////////////////
@@ -489,12 +546,11 @@ void RenumberTableReferences(val_type *vtable_ptr)
       t->garbage_ref = t->garbage_ref | VISITED_LIST;
       for (int i = 0; i < t->size; ++i)
       {
-         hn = t->table[i];
-         while (hn != NULL)
+         hn = &t->table[i];
+         if (hn->hash != 0)
          {
             if (hn->data_val.v.tag == TAG_TABLE)
                RenumberTableReferences(&(hn->data_val));
-            hn = hn->next;
          }
       }
    }
@@ -610,8 +666,8 @@ void MarkTableObject(int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_OBJECT)
             MarkObject(hn->data_val.v.data);
@@ -619,7 +675,6 @@ void MarkTableObject(int table_id)
             MarkTableObject(hn->data_val.v.data);
          else if (hn->data_val.v.tag == TAG_LIST)
             MarkListNodeObject(hn->data_val.v.data);
-         hn = hn->next;
       }
    }
 }
@@ -645,6 +700,18 @@ void RenumberBlockerObjects(room_node *r)
       b->ObjectID = GetObjectByID(b->ObjectID)->garbage_ref;
       b = b->Next;
    }
+   BSPBlockerRehashIDs(&r->data);
+}
+
+void RenumberInterestObjects(room_node *r)
+{
+   ForEachInterested(r, NULL, 0.0f, RenumberInterestNode);
+   InterestRehashIDs(r);
+}
+
+void RenumberInterestNode(interest_node *i)
+{
+   i->object_id = GetObjectByID(i->object_id)->garbage_ref;
 }
 
 void RenumberObjectReferences(object_node *o)
@@ -693,8 +760,8 @@ void RenumberTableObjectReferences(table_node *t, int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_OBJECT)
          {
@@ -704,7 +771,6 @@ void RenumberTableObjectReferences(table_node *t, int table_id)
          }
          else if (hn->data_val.v.tag == TAG_STRING)
             MarkString(hn->data_val.v.data);
-         hn = hn->next;
       }
    }
 }
@@ -813,14 +879,13 @@ void RenumberTableTimerStringReferences(table_node *t, int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_TIMER)
             ResetTimerReference(&(hn->data_val));
          else if (hn->data_val.v.tag == TAG_STRING)
             ResetStringReference(&(hn->data_val));
-         hn = hn->next;
       }
    }
 }
@@ -888,12 +953,11 @@ void MarkTableStrings(table_node *t, int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          if (hn->data_val.v.tag == TAG_STRING)
             MarkString(hn->data_val.v.data);
-         hn = hn->next;
       }
    }
 }
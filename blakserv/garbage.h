@@ -14,5 +14,6 @@
 #define _GARBAGE_H
 
 void GarbageCollect(void);
+void ReclaimListNodes(void);
 
 #endif
@@ -575,7 +575,7 @@ void StartupComplete()
 	s = CreateSession(conn);
 	if (s == NULL)
 		FatalError("Interface can't make session for console");
-	s->account = GetConsoleAccount();
+	SetSessionAccount(s,GetConsoleAccount());
 	InitSessionState(s,STATE_ADMIN);
 	console_session_id = s->session_id;
 	
@@ -0,0 +1,176 @@
+// Meridian 59, Copyright 1994-2012 Andrew Kirmse and Chris Kirmse.
+// All rights reserved.
+//
+// This software is distributed under a license that is described in
+// the LICENSE file that accompanies it.
+//
+// Meridian is a registered trademark.
+/*
+ * kodprof.c
+ *
+
+ This module is a sampling profiler for the Blakod.  While it is on, the
+ interpreter stops every so many instructions (the interval) and hands us
+ the Blakod call stack: class, message and source line of each frame.
+ Identical stacks are counted together.
+
+ Because samples are taken by instruction count, time spent inside C
+ functions isn't seen, only interpreted work.  In exchange the interpreter
+ pays nothing for the profiler: the sample point is folded into the
+ runaway-handler check it already does on every instruction.
+
+ The result is written as "folded stacks", one line per distinct stack
+ with frames from the top level message down, separated by semicolons,
+ then the sample count.  That's the input format of flamegraph.pl and
+ most other flame graph tools.  Stacks deeper than MAX_PROFILE_DEPTH keep
+ their innermost frames, below a "(truncated)" frame.
+
+ */
+
+#include "blakserv.h"
+
+#include <map>
+
+static Bool profiling = False;
+static int profile_interval = DEFAULT_PROFILE_INTERVAL;
+static int profile_samples;
+
+/* key is class id, message id and line of each frame, outermost first */
+typedef std::map<std::vector<int>,int> profile_map;
+static profile_map profile_stacks;
+
+Bool IsKodProfiling(void)
+{
+   return profiling;
+}
+
+int GetKodProfileInterval(void)
+{
+   return profile_interval;
+}
+
+int GetKodProfileSamples(void)
+{
+   return profile_samples;
+}
+
+void StartKodProfile(int interval)
+{
+   if (interval <= 0)
+      interval = DEFAULT_PROFILE_INTERVAL;
+   profile_interval = interval;
+   profiling = True;
+   SetInterpretLimit();
+}
+
+void StopKodProfile(void)
+{
+   profiling = False;
+   SetInterpretLimit();
+}
+
+void ClearKodProfile(void)
+{
+   profile_stacks.clear();
+   profile_samples = 0;
+}
+
+void AddKodProfileSample(int depth,profile_frame frames[])
+{
+   std::vector<int> key;
+   int i;
+
+   if (depth > MAX_PROFILE_DEPTH)
+      depth = MAX_PROFILE_DEPTH;
+
+   key.reserve(3*depth);
+   for (i=0;i<depth;i++)
+   {
+      key.push_back(frames[i].class_id);
+      key.push_back(frames[i].message_id);
+      key.push_back(frames[i].line);
+   }
+   profile_stacks[key]++;
+   profile_samples++;
+}
+
+static void WriteProfileFrame(FILE *fp,int class_id,int message_id,int line)
+{
+   class_node *c;
+   char *name;
+
+   /* outer frames left out of a deep stack, see TakeProfileSample */
+   if (class_id == INVALID_CLASS)
+   {
+      fputs("(truncated)",fp);
+      return;
+   }
+
+   c = GetClassByID(class_id);
+   name = GetNameByID(message_id);
+   fprintf(fp,"%s::%s:%i",c ? c->class_name : "(unknown)",
+      name ? name : "(unknown)",line);
+}
+
+/* write the samples in folded stack format, returns False if the file
+   couldn't be written */
+Bool WriteKodProfile(char *filename)
+{
+   FILE *fp;
+   profile_map::iterator it;
+   size_t i;
+
+   fp = fopen(filename,"wt");
+   if (fp == NULL)
+   {
+      eprintf("WriteKodProfile can't open %s\n",filename);
+      return False;
+   }
+
+   for (it = profile_stacks.begin(); it != profile_stacks.end(); ++it)
+   {
+      const std::vector<int> &key = it->first;
+
+      for (i=0;i<key.size();i+=3)
+      {
+         if (i > 0)
+            fputc(';',fp);
+         WriteProfileFrame(fp,key[i],key[i+1],key[i+2]);
+      }
+      fprintf(fp," %i\n",it->second);
+   }
+
+   fclose(fp);
+   return True;
+}
+
+/* calls back with the innermost frames that got the most samples, most
+   first */
+void ForEachKodProfileLeaf(int max_leaves,void (*callback_func)(profile_frame *f,int samples))
+{
+   std::map<std::vector<int>,int> leaves;
+   std::vector<std::pair<int,std::vector<int> > > sorted;
+   profile_map::iterator it;
+   profile_frame f;
+   int i;
+
+   for (it = profile_stacks.begin(); it != profile_stacks.end(); ++it)
+   {
+      const std::vector<int> &key = it->first;
+      if (key.size() < 3)
+         continue;
+      leaves[std::vector<int>(key.end() - 3,key.end())] += it->second;
+   }
+
+   for (it = leaves.begin(); it != leaves.end(); ++it)
+      sorted.push_back(std::make_pair(it->second,it->first));
+   std::sort(sorted.rbegin(),sorted.rend());
+
+   for (i=0;i<(int)sorted.size() && i<max_leaves;i++)
+   {
+      f.class_id = sorted[i].second[0];
+      f.message_id = sorted[i].second[1];
+      f.line = sorted[i].second[2];
+      callback_func(&f,sorted[i].first);
+   }
+}
@@ -0,0 +1,36 @@
+// Meridian 59, Copyright 1994-2012 Andrew Kirmse and Chris Kirmse.
+// All rights reserved.
+//
+// This software is distributed under a license that is described in
+// the LICENSE file that accompanies it.
+//
+// Meridian is a registered trademark.
+/*
+ * kodprof.h
+ *
+ */
+
+#ifndef _KODPROF_H
+#define _KODPROF_H
+
+#define DEFAULT_PROFILE_INTERVAL 10007 /* prime, so we don't beat with loops */
+#define MAX_PROFILE_DEPTH 64
+
+typedef struct
+{
+   int class_id;
+   int message_id;
+   int line;
+} profile_frame;
+
+void StartKodProfile(int interval);
+void StopKodProfile(void);
+void ClearKodProfile(void);
+Bool IsKodProfiling(void);
+int GetKodProfileInterval(void);
+int GetKodProfileSamples(void);
+void AddKodProfileSample(int depth,profile_frame frames[]);
+Bool WriteKodProfile(char *filename);
+void ForEachKodProfileLeaf(int max_leaves,void (*callback_func)(profile_frame *f,int samples));
+
+#endif
@@ -11,23 +11,70 @@
 
   This module maintains a dynamically sized array with the list nodes
   used by the Blakod.  They are like LISP list nodes, keeping values in
-  two fields, first and rest.
-  
+  two fields, first and rest.  The array is a chunk_array, so a node
+  pointer stays good while other nodes are allocated.
+
+  Walking the rest fields makes Nth, Length and Last cost the length of
+  the list, so lists that are long enough also get a list vector: an array
+  of their node ids, last node first.  Node n of a list whose head is at
+  ids[i] is ids[i-n+1], so any tail of the list can use the same vector.
+  The cons nodes are still the real list, the vector is only an index over
+  them, so sharing through Rest works as always and garbage collection
+  and saving don't need to know about vectors.
+
+  A node is in at most one vector.  Each node remembers the vector and
+  position it was given; that's trusted only if the vector still has the
+  node at that spot, so stale entries are harmless.  Cons onto the head of
+  a vector and appends to its end extend it; any other change to a rest
+  field throws the vector away, and it is rebuilt when next needed.  If two
+  lists share a tail, building a vector for one drops the other's.
+
+  Between garbage collections, ReclaimListNodes() in garbage.c finds the
+  nodes nothing refers to any more and gives them back here.  They're
+  kept on a free list chained through their rest fields, and handed out
+  again before the array grows.  Unlike a garbage collection, that doesn't
+  move any node, so it can be done often.
+
 */
 
 #include "blakserv.h"
 
-list_node *list_nodes;
-int num_nodes,max_nodes;
+chunk_array<list_node> list_nodes;
+int num_nodes;
+
+typedef struct
+{
+	Bool used;
+	std::vector<int> ids; /* node ids, from ids[lo] (last node) to the end */
+	int lo;
+	int offset;           /* ids index of a node is its vector_pos + offset */
+} list_vector;
+
+static std::vector<list_vector> list_vectors;
+static int num_list_vectors;
+static int next_list_vector;
+static std::vector<int> vector_scratch;
+
+static int free_list_id;        /* first reclaimed node, or INVALID_ID */
+static int num_free_nodes;
+static int nodes_since_reclaim; /* allocated since the free list was made */
 
 /* local function prototypes */
 int AllocateListNode(void);
+void ClearListVectors(void);
+list_vector * GetListVector(int list_id,int *index);
+list_vector * BuildListVector(int list_id,int *length);
+void DropListVector(list_vector *v);
+void AddToListVectorFront(list_vector *v,int list_id);
+void AddToListVectorBack(list_vector *v,int list_id);
+Bool GetListVectorNth(int n,int list_id,int *node_id);
 
 void InitList(void)
 {
 	num_nodes = 0;
-	max_nodes = INIT_LIST_NODES;
-	list_nodes = (list_node *)AllocateMemory(MALLOC_ID_LIST,max_nodes*sizeof(list_node));
+	list_nodes.Init(MALLOC_ID_LIST,INIT_LIST_NODES);
+	ClearListVectors();
+	ClearListFreeNodes();
 }
 
 void ResetList(void)
@@ -43,15 +90,10 @@ void ResetList(void)
 */
 void ClearList(void)
 {
-	int old_nodes;
-	
-	old_nodes = max_nodes;
-	
 	num_nodes = 0;
-	max_nodes = INIT_LIST_NODES;
-	list_nodes = (list_node *)
-		ResizeMemory(MALLOC_ID_LIST,list_nodes,old_nodes*sizeof(list_node),
-		max_nodes*sizeof(list_node));
+	list_nodes.Shrink(INIT_LIST_NODES);
+	ClearListVectors();
+	ClearListFreeNodes();
 }
 
 int GetListNodesUsed(void)
@@ -59,23 +101,234 @@ int GetListNodesUsed(void)
 	return num_nodes;
 }
 
+int GetListNodesFree(void)
+{
+	return num_free_nodes;
+}
+
+int GetListNodesSinceReclaim(void)
+{
+	return nodes_since_reclaim;
+}
+
+/* forget the free list, when node ids change or it's about to be rebuilt */
+void ClearListFreeNodes(void)
+{
+	free_list_id = INVALID_ID;
+	num_free_nodes = 0;
+	nodes_since_reclaim = 0;
+}
+
+/* only for nodes that nothing refers to; see ReclaimListNodes() */
+void FreeListNode(int list_id)
+{
+	list_node *l;
+	list_vector *v;
+	int index;
+	
+	v = GetListVector(list_id,&index);
+	if (v)
+		DropListVector(v);
+	
+	l = &list_nodes[list_id];
+	l->first.int_val = NIL;
+	l->rest.v.tag = TAG_NIL;
+	l->rest.v.data = free_list_id;
+	free_list_id = list_id;
+	num_free_nodes++;
+}
+
+int GetListVectorsUsed(void)
+{
+	return num_list_vectors;
+}
+
 int AllocateListNode(void)
 {
-	int old_nodes;
+	int list_id;
 	
-	if (num_nodes == max_nodes)
+	nodes_since_reclaim++;
+	if (free_list_id != INVALID_ID)
 	{
-		old_nodes = max_nodes;
-		max_nodes = max_nodes + ( INIT_LIST_NODES/2) ;
-		
-		list_nodes = (list_node *)
-			ResizeMemory(MALLOC_ID_LIST,list_nodes,old_nodes*sizeof(list_node),
-			max_nodes*sizeof(list_node));      
-		lprintf("AllocateListNode resized to %i list nodes\n",max_nodes);
+		list_id = free_list_id;
+		free_list_id = list_nodes[list_id].rest.v.data;
+		num_free_nodes--;
+		list_nodes[list_id].vector_id = INVALID_ID;
+		return list_id;
 	}
+	
+	if (num_nodes == list_nodes.Capacity())
+		list_nodes.Grow(num_nodes + 1);
+	list_nodes[num_nodes].vector_id = INVALID_ID;
 	return num_nodes++;
 }
 
+/* list vectors, see the top of the file */
+
+void ClearListVectors(void)
+{
+	list_vectors.clear();
+	list_vectors.reserve(MAX_LIST_VECTORS); /* so vectors never move */
+	num_list_vectors = 0;
+	next_list_vector = 0;
+}
+
+/* returns the vector list_id is in and sets index to where, or NULL */
+list_vector * GetListVector(int list_id,int *index)
+{
+	list_node *l;
+	list_vector *v;
+	int i;
+	
+	if (!IsListNodeByID(list_id))
+		return NULL;
+	
+	l = &list_nodes[list_id];
+	if (l->vector_id < 0 || l->vector_id >= (int)list_vectors.size())
+		return NULL;
+	
+	v = &list_vectors[l->vector_id];
+	i = l->vector_pos + v->offset;
+	if (!v->used || i < v->lo || i >= (int)v->ids.size() || v->ids[i] != list_id)
+		return NULL;
+	
+	*index = i;
+	return v;
+}
+
+void DropListVector(list_vector *v)
+{
+	if (!v->used)
+		return;
+	
+	v->used = False;
+	std::vector<int>().swap(v->ids);
+	num_list_vectors--;
+}
+
+void SetListVectorNode(list_vector *v,int index,int list_id)
+{
+	list_vector *old_v;
+	int old_index;
+	
+	/* a node can only be in one vector */
+	old_v = GetListVector(list_id,&old_index);
+	if (old_v != NULL && old_v != v)
+		DropListVector(old_v);
+	
+	v->ids[index] = list_id;
+	list_nodes[list_id].vector_id = (int)(v - &list_vectors[0]);
+	list_nodes[list_id].vector_pos = index - v->offset;
+}
+
+/* list_id was just consed onto the head of v */
+void AddToListVectorBack(list_vector *v,int list_id)
+{
+	v->ids.push_back(INVALID_ID);
+	SetListVectorNode(v,(int)v->ids.size() - 1,list_id);
+}
+
+/* list_id was just appended after the last node of v */
+void AddToListVectorFront(list_vector *v,int list_id)
+{
+	int gap;
+	
+	if (v->lo == 0)
+	{
+		/* make room in front; positions stored in nodes stay good since
+		   offset moves with them */
+		gap = std::max((int)v->ids.size(),LIST_VECTOR_MIN);
+		v->ids.insert(v->ids.begin(),gap,INVALID_ID);
+		v->lo += gap;
+		v->offset += gap;
+	}
+	v->lo--;
+	SetListVectorNode(v,v->lo,list_id);
+}
+
+/* Walks the list starting at list_id, setting length to its length, or -1
+   if it isn't a proper list.  If it's long enough, makes a vector for it
+   and returns that, with list_id at the end of it. */
+list_vector * BuildListVector(int list_id,int *length)
+{
+	list_node *l;
+	list_vector *v;
+	int i,id;
+	
+	*length = -1;
+	vector_scratch.clear();
+	
+	id = list_id;
+	for (;;)
+	{
+		if (!IsListNodeByID(id) || (int)vector_scratch.size() >= num_nodes)
+			return NULL;
+		vector_scratch.push_back(id);
+		l = &list_nodes[id];
+		if (l->rest.v.tag == TAG_NIL)
+			break;
+		if (l->rest.v.tag != TAG_LIST)
+			return NULL;
+		id = l->rest.v.data;
+	}
+	
+	*length = (int)vector_scratch.size();
+	if (*length < LIST_VECTOR_MIN)
+		return NULL;
+	
+	if (num_list_vectors < MAX_LIST_VECTORS)
+	{
+		/* find a free one, growing the table if they're all in use */
+		if (num_list_vectors == (int)list_vectors.size())
+			list_vectors.resize(list_vectors.size() + 1);
+		while (list_vectors[next_list_vector].used)
+			next_list_vector = (next_list_vector + 1) % list_vectors.size();
+	}
+	else
+	{
+		/* all used, so reuse the next one in turn */
+		next_list_vector = (next_list_vector + 1) % list_vectors.size();
+		DropListVector(&list_vectors[next_list_vector]);
+	}
+	
+	v = &list_vectors[next_list_vector];
+	v->used = True;
+	v->lo = 0;
+	v->offset = 0;
+	num_list_vectors++;
+	
+	v->ids.resize(*length,INVALID_ID);
+	for (i=0;i<*length;i++)
+		SetListVectorNode(v,i,vector_scratch[*length - 1 - i]);
+	
+	return v;
+}
+
+/* Finds node n of the list at list_id through its vector, making one if
+   n says the list is long enough.  Returns False if there's no vector to
+   use, otherwise sets node_id, to INVALID_ID if the list is shorter. */
+Bool GetListVectorNth(int n,int list_id,int *node_id)
+{
+	list_vector *v;
+	int index,length;
+	
+	v = GetListVector(list_id,&index);
+	if (v == NULL)
+	{
+		if (n < LIST_VECTOR_MIN)
+			return False;
+		v = BuildListVector(list_id,&length);
+		if (v == NULL)
+			return False;
+		index = (int)v->ids.size() - 1;
+	}
+	
+	if (n > 1)
+		index -= n - 1;
+	*node_id = (index >= v->lo) ? v->ids[index] : INVALID_ID;
+	return True;
+}
+
 Bool LoadList(int list_id,val_type first,val_type rest)
 {
 	if (AllocateListNode() != list_id)
@@ -126,18 +379,14 @@ int Rest(int list_id)
 
 int AppendListElem(val_type source, val_type list_val)
 {
-   int list_id, new_list_id, n = 0, temp_list_id = -1;
+   int list_id, new_list_id, n = 0, last_id, index;
    list_node *l, *new_node;
+   list_vector *v;
 
    if (list_val.v.tag == TAG_NIL)
       return Cons(source,list_val);
    list_id = list_val.v.data;
 
-   // If we're appending a list, get the ID now in case memory is reallocated.
-   if (source.v.tag == TAG_LIST)
-      temp_list_id = source.v.data;
-
-   // Allocate first, so a resize doesn't clobber list references.
    new_list_id = AllocateListNode();
    new_node = GetListNodeByID(new_list_id);
    if (!new_node)
@@ -153,35 +402,47 @@ int AppendListElem(val_type source, val_type list_val)
       return list_id;
    }
 
-   while (l && l->rest.v.tag != TAG_NIL)
+   v = GetListVector(list_id,&index);
+   if (v)
    {
-      l = GetListNodeByID(l->rest.v.data);
-      n++;
+      last_id = v->ids[v->lo];
+      l = &list_nodes[last_id];
    }
+   else
+   {
+      last_id = list_id;
+      while (l && l->rest.v.tag != TAG_NIL)
+      {
+         last_id = l->rest.v.data;
+         l = GetListNodeByID(last_id);
+         n++;
+      }
 
-   if (n > 500)
-      bprintf("Warning, AppendListElem adding to large list, length %i",n);
+      if (n > 500)
+         bprintf("Warning, AppendListElem adding to large list, length %i",n);
+   }
 
    new_node->rest.int_val = NIL;
-
-   if (temp_list_id >= 0)
-   {
-      new_node->first.v.tag = TAG_LIST;
-      new_node->first.v.data = temp_list_id;
-   }
-   else
-      new_node->first.int_val = source.int_val;
+   new_node->first.int_val = source.int_val;
 
    l->rest.v.data = new_list_id;
    l->rest.v.tag = TAG_LIST;
 
+   // The old last node is last in any vector it's in, so extend that.
+   v = GetListVector(last_id,&index);
+   if (v)
+      AddToListVectorFront(v,new_list_id);
+   else if (n >= LIST_VECTOR_MIN)
+      BuildListVector(list_id,&n);
+
    return list_id;
 }
 
 int Cons(val_type source,val_type dest)
 {
-   int list_id, source_id = -1, dest_id = -1;
+   int list_id, source_id = -1, dest_id = -1, index;
    list_node *new_node;
+   list_vector *v;
 
    if (source.v.tag == TAG_LIST)
       source_id = source.v.data;
@@ -207,6 +468,11 @@ int Cons(val_type source,val_type dest)
    {
       new_node->rest.v.tag = TAG_LIST;
       new_node->rest.v.data = dest_id;
+
+      // Consing onto the head of a vector extends it.
+      v = GetListVector(dest_id,&index);
+      if (v && index == (int)v->ids.size() - 1)
+         AddToListVectorBack(v,list_id);
    }
    else
       new_node->rest.int_val = dest.int_val;
@@ -216,13 +482,23 @@ int Cons(val_type source,val_type dest)
 
 int Length(int list_id)
 {
-	int len_so_far;
+	int len_so_far,index;
 	list_node *l;
+	list_vector *v;
 	
 	l = GetListNodeByID(list_id);
 	if (!l)
 		return 0;
 	
+	v = GetListVector(list_id,&index);
+	if (v)
+		return index - v->lo + 1;
+	
+	/* counts the list, and remembers it if it's long */
+	BuildListVector(list_id,&len_so_far);
+	if (len_so_far > 0)
+		return len_so_far;
+	
 	len_so_far = 1;
 	while (l && l->rest.v.tag != TAG_NIL)
 	{
@@ -234,9 +510,20 @@ int Length(int list_id)
 
 int Nth(int n,int list_id)
 {
-	int i;
+	int i,node_id;
 	list_node *l;
 	
+	if (n > 1 && GetListVectorNth(n,list_id,&node_id))
+	{
+		if (node_id == INVALID_ID)
+		{
+			bprintf("Nth can't go past end of list %i, length %i\n",
+				list_id,Length(list_id));
+			return NIL;
+		}
+		return list_nodes[node_id].first.int_val;
+	}
+	
 	l = GetListNodeByID(list_id);
 	for (i=1;i<n;i++)
 	{
@@ -322,6 +609,8 @@ int IsListMatch(int list_one_id, int list_two_id)
 int Last(int list_id)
 {
    list_node *l;
+   list_vector *v;
+   int index, n = 0;
 
    l = GetListNodeByID(list_id);
    if (!l)
@@ -330,11 +619,19 @@ int Last(int list_id)
       return NIL;
    }
 
+   v = GetListVector(list_id,&index);
+   if (v)
+      return list_nodes[v->ids[v->lo]].first.int_val;
+
    while (l && l->rest.v.tag != TAG_NIL)
    {
       l = GetListNodeByID(l->rest.v.data);
+      n++;
    }
 
+   if (l && n >= LIST_VECTOR_MIN)
+      BuildListVector(list_id,&n);
+
    if (!l)
    {
       bprintf("Last found invalid list node somewhere in list %i\n",
@@ -358,9 +655,19 @@ int SetFirst(int list_id,val_type new_val)
 
 int SetNth(int n,int list_id,val_type new_val)
 {
-	int i;
+	int i,node_id;
 	list_node *l;
 	
+	if (n > 1 && GetListVectorNth(n,list_id,&node_id))
+	{
+		if (node_id == INVALID_ID)
+			bprintf("SetNth can't go past end o' list %i, length %i\n",
+				list_id,Length(list_id));
+		else
+			list_nodes[node_id].first = new_val;
+		return NIL;
+	}
+	
 	l = GetListNodeByID(list_id);
 	for (i=1;i<n;i++)
 	{
@@ -389,6 +696,24 @@ int SwapListElem(int list_id,int elem_one,int elem_two)
 {
    list_node *l, *list_node_one, *list_node_two;
    val_type temp;
+   int id_one, id_two;
+
+   if (std::max(elem_one,elem_two) > 1
+      && GetListVectorNth(std::max(elem_one,elem_two),list_id,&id_two))
+   {
+      GetListVectorNth(elem_one,list_id,&id_one);
+      GetListVectorNth(elem_two,list_id,&id_two);
+      if (id_one == INVALID_ID || id_two == INVALID_ID)
+      {
+         bprintf("SwapListElem can't go past end of list %i, length %i\n",
+            list_id,Length(list_id));
+         return NIL;
+      }
+      temp = list_nodes[id_two].first;
+      list_nodes[id_two].first = list_nodes[id_one].first;
+      list_nodes[id_one].first = temp;
+      return NIL;
+   }
 
    l = GetListNodeByID(list_id);
 
@@ -463,13 +788,15 @@ int GetAllListNodesByClass(int list_id, int position, int class_id)
 {
    list_node *l;
    object_node *o;
-   class_node *c;
+   class_node *c, *ancestor;
    int new_list_id = -1, l_list_id;
    val_type nil_val, obj_val, first_val, rest_val;
    nil_val.int_val = NIL;
    first_val.v.tag = TAG_LIST;
    rest_val.v.tag = TAG_LIST;
 
+   ancestor = GetClassByID(class_id);
+
    l = GetListNodeByID(list_id);
    if (!l)
    {
@@ -506,16 +833,11 @@ int GetAllListNodesByClass(int list_id, int position, int class_id)
             FlushDefaultChannels();
             return NIL;
          }
-         do
+         if (IsClassDescendant(c,ancestor))
          {
-            if (c->class_id == class_id)
-            {
-               first_val.v.data = ListCopy(l->first.v.data);
-               new_list_id = Cons(first_val, nil_val);
-               break;
-            }
-            c = c->super_ptr;
-         } while (c != NULL);
+            first_val.v.data = ListCopy(l->first.v.data);
+            new_list_id = Cons(first_val, nil_val);
+         }
 
          // Just made an allocation, get list_node again.
          l = &list_nodes[list_id];
@@ -558,25 +880,20 @@ int GetAllListNodesByClass(int list_id, int position, int class_id)
                return NIL;
             }
 
-            do
+            if (IsClassDescendant(c,ancestor))
             {
-               if (c->class_id == class_id)
+               if (new_list_id < 0)
                {
-                  if (new_list_id < 0)
-                  {
-                     first_val.v.data = ListCopy(l->first.v.data);
-                     new_list_id = Cons(first_val, nil_val);
-                  }
-                  else
-                  {
-                     first_val.v.data = ListCopy(l->first.v.data);
-                     rest_val.v.data = new_list_id;
-                     new_list_id = Cons(first_val, rest_val);
-                  }
-                  break;
+                  first_val.v.data = ListCopy(l->first.v.data);
+                  new_list_id = Cons(first_val, nil_val);
                }
-               c = c->super_ptr;
-            } while (c != NULL);
+               else
+               {
+                  first_val.v.data = ListCopy(l->first.v.data);
+                  rest_val.v.data = new_list_id;
+                  new_list_id = Cons(first_val, rest_val);
+               }
+            }
             // Just made an allocation, get list_node again.
             l = &list_nodes[l_list_id];
          }
@@ -592,7 +909,9 @@ int GetListElemByClass(val_type list_id, int class_id)
 {
    list_node *l;
    object_node *o;
-   class_node *c;
+   class_node *c, *ancestor;
+
+   ancestor = GetClassByID(class_id);
 
    l = GetListNodeByID(list_id.v.data);
    if (!l)
@@ -617,12 +936,8 @@ int GetListElemByClass(val_type list_id, int class_id)
          FlushDefaultChannels();
          return NIL;
       }
-      do
-      {
-         if (c->class_id == class_id)
-            return l->first.int_val;
-         c = c->super_ptr;
-      } while (c != NULL);
+      if (IsClassDescendant(c,ancestor))
+         return l->first.int_val;
    }
 
    while (l && l->rest.v.data != NIL)
@@ -645,12 +960,8 @@ int GetListElemByClass(val_type list_id, int class_id)
             FlushDefaultChannels();
             return NIL;
          }
-         do
-         {
-            if (c->class_id == class_id)
-               return l->first.int_val;
-            c = c->super_ptr;
-         } while (c != NULL);
+         if (IsClassDescendant(c,ancestor))
+            return l->first.int_val;
       }
    }
 
@@ -705,19 +1016,11 @@ int GetListNode(val_type list_id, int position, val_type list_elem)
    return NIL;
 }
 
-// ListCopy makes a lot of list allocations, and if a list allocation causes
-// the list_nodes memory to be resized, all existing list_node references
-// here are invalidated. As a result, this function is structured so that
-// no old list_nodes are accessed after an allocation or recursive ListCopy
-// call. This adds overhead, but is still the fastest safe way to copy a list.
+// Copies list_id, and any lists in it.
 int ListCopy(int list_id)
 {
-   list_node *l, *new_node, *new_next;
-   int new_list_id, first_list_id, rest_list_id, l_list_id;
-   int temp;
-
-   // Allocate first so a resize doesn't clobber references.
-   new_list_id = first_list_id = AllocateListNode();
+   list_node *l, *new_node, *prev_node = NULL;
+   int new_list_id = NIL, node_id;
 
    l = GetListNodeByID(list_id);
    if (!l)
@@ -726,108 +1029,49 @@ int ListCopy(int list_id)
       return NIL;
    }
 
-   if (l->first.v.tag == TAG_LIST)
-   {
-      // Copy to temp, in case ListCopy resizes memory.
-      temp = ListCopy(l->first.v.data);
-
-      // After a ListCopy call, any existing list reference may be invalid.
-      // Access list_nodes directly, list node already confirmed to exist.
-      l = &list_nodes[list_id];
-
-      new_node = GetListNodeByID(new_list_id);
-      if (!new_node)
-      {
-         bprintf("ListCopy couldn't allocate new node! %i\n",new_list_id);
-         return NIL;
-      }
-      new_node->first.v.data = temp;
-      new_node->first.v.tag = TAG_LIST;
-   }
-   else
+   while (l)
    {
-      new_node = GetListNodeByID(new_list_id);
+      node_id = AllocateListNode();
+      new_node = GetListNodeByID(node_id);
       if (!new_node)
       {
-         bprintf("ListCopy couldn't allocate new node! %i\n",new_list_id);
-         return NIL;
-      }
-      new_node->first.int_val = l->first.int_val;
-   }
-
-   // Get next list id for accessing after allocation.
-   l_list_id = l->rest.v.data;
-
-   while (l && l->rest.v.data != NIL)
-   {
-      // Allocate first so a resize doesn't clobber references.
-      rest_list_id = AllocateListNode();
-
-      l = GetListNodeByID(l_list_id);
-      if (!l)
-      {
-         bprintf("ListCopy got invalid list node %i %i\n",
-            l->rest.v.tag, l->rest.v.data);
+         bprintf("ListCopy couldn't allocate new node! %i\n",node_id);
          return NIL;
       }
 
       if (l->first.v.tag == TAG_LIST)
       {
-         // Copy to temp, in case ListCopy resizes memory.
-         temp = ListCopy(l->first.v.data);
-         // After a ListCopy call, any existing list reference may be invalid.
-         // Access list_nodes directly, list node already confirmed to exist.
-         l = &list_nodes[l_list_id];
-
-         // Get new list node.
-         new_next = GetListNodeByID(rest_list_id);
-         if (!new_next)
-         {
-            bprintf("ListCopy couldn't allocate new node! %i\n",
-               new_list_id);
-            return NIL;
-         }
-         // Access list_nodes directly, list node already confirmed to exist.
-         new_node = &list_nodes[first_list_id];
-         new_node->rest.v.tag = TAG_LIST;
-         new_node->rest.v.data = rest_list_id;
-         new_node = new_next;
-
-         new_node->first.v.data = temp;
          new_node->first.v.tag = TAG_LIST;
+         new_node->first.v.data = ListCopy(l->first.v.data);
       }
       else
-      {
-         // Get new list node.
-         new_next = GetListNodeByID(rest_list_id);
-         if (!new_next)
-         {
-            bprintf("ListCopy couldn't allocate new node! %i\n",
-               new_list_id);
-            return NIL;
-         }
-         // Access list_nodes directly, list node already confirmed to exist.
-         new_node = &list_nodes[first_list_id];
-         new_node->rest.v.tag = TAG_LIST;
-         new_node->rest.v.data = rest_list_id;
-         new_node = new_next;
-
          new_node->first.int_val = l->first.int_val;
+      new_node->rest.int_val = NIL;
+
+      if (prev_node)
+      {
+         prev_node->rest.v.tag = TAG_LIST;
+         prev_node->rest.v.data = node_id;
       }
+      else
+         new_list_id = node_id;
+      prev_node = new_node;
 
-      // Save list node refs, so we can get them next iteration after the allocation.
-      first_list_id = rest_list_id;
-      l_list_id = l->rest.v.data;
+      if (l->rest.v.tag != TAG_LIST)
+         break;
+      l = GetListNodeByID(l->rest.v.data);
+      if (!l)
+         bprintf("ListCopy got invalid list node in list %i\n",list_id);
    }
-   new_node->rest.int_val = NIL;
 
    return new_list_id;
 }
 
 int InsertListElem(int n,int list_id,val_type new_val)
 {
-   int new_list_id, temp_list_id = -1;
+   int new_list_id, l_id = list_id, prev_id = INVALID_ID, index;
    list_node *l, *prev = NULL, *new_node;
+   list_vector *v;
 
    if (n == 0)
    {
@@ -836,11 +1080,6 @@ int InsertListElem(int n,int list_id,val_type new_val)
       return list_id;
    }
 
-   // If the element we're adding is a list, get the list node now before
-   // allocating another node, in case memory is resized.
-   if (new_val.v.tag == TAG_LIST)
-      temp_list_id = new_val.v.data;
-   // Allocate first, so a resize doesn't clobber list references.
    new_list_id = AllocateListNode();
    new_node = GetListNodeByID(new_list_id);
    if (!new_node)
@@ -865,24 +1104,21 @@ int InsertListElem(int n,int list_id,val_type new_val)
       {
          // Add the new value to the end of the list.
          new_node->rest.int_val = NIL;
-
-         // Use temp id if element we're adding is a list, in case allocate
-         // resized memory.
-         if (temp_list_id >= 0)
-         {
-            new_node->first.v.tag = TAG_LIST;
-            new_node->first.v.data = temp_list_id;
-         }
-         else
-            new_node->first.int_val = new_val.int_val;
+         new_node->first.int_val = new_val.int_val;
 
          // Previous node points to this one.
          l->rest.v.tag = TAG_LIST;
          l->rest.v.data = new_list_id;
+
+         v = GetListVector(l_id,&index);
+         if (v)
+            AddToListVectorFront(v,new_list_id);
          return list_id;
       }
       prev = l;
-      l = GetListNodeByID(l->rest.v.data);
+      prev_id = l_id;
+      l_id = l->rest.v.data;
+      l = GetListNodeByID(l_id);
    }
 
    if (!l || !prev)
@@ -896,26 +1132,24 @@ int InsertListElem(int n,int list_id,val_type new_val)
    // Points to the old node.
    new_node->rest.v.data = prev->rest.v.data;
    new_node->rest.v.tag = TAG_LIST;
-
-   // Use temp id if element we're adding is a list, in case allocate
-   // resized memory.
-   if (temp_list_id >= 0)
-   {
-      new_node->first.v.tag = TAG_LIST;
-      new_node->first.v.data = temp_list_id;
-   }
-   else
-      new_node->first.int_val = new_val.int_val;
+   new_node->first.int_val = new_val.int_val;
 
    // Previous node points to this one.
    prev->rest.v.data = new_list_id;
 
+   // Can't insert into the middle of a vector.
+   v = GetListVector(prev_id,&index);
+   if (v)
+      DropListVector(v);
+
    return list_id;
 }
 
 int DelListElem(val_type list_id,val_type list_elem)
 {
 	list_node *l,*prev;
+	list_vector *v;
+	int l_id,prev_id,index;
 	
 	l = GetListNodeByID(list_id.v.data);
 	if (!l)
@@ -927,14 +1161,28 @@ int DelListElem(val_type list_id,val_type list_elem)
 		return l->rest.int_val;
 	}
 	
+	l_id = prev_id = list_id.v.data;
 	while (l && l->rest.v.data != NIL && l->first.int_val != list_elem.int_val)
 	{
 		prev = l;
-		l = GetListNodeByID(l->rest.v.data);
+		prev_id = l_id;
+		l_id = l->rest.v.data;
+		l = GetListNodeByID(l_id);
 	}
 	if (l && l->first.int_val == list_elem.int_val)
 	{
 		prev->rest = l->rest;
+		
+		/* taking off the last node just shortens a vector, otherwise the
+		   vector prev is in no longer matches the list.  prev may be a node
+		   of another list sharing the tail, then the vector's list hasn't
+		   changed */
+		v = GetListVector(l_id,&index);
+		if (v && index == v->lo && index + 1 < (int)v->ids.size() &&
+			v->ids[index+1] == prev_id)
+			v->lo++;
+		else if ((v = GetListVector(prev_id,&index)) != NULL)
+			DropListVector(v);
 		return list_id.int_val;
 	}
 	
@@ -1241,7 +1489,9 @@ int SendListMessageByClass(int list_id, int class_id, bool ret_false,
    int obj_id = INVALID_OBJECT, return_int = True;
    val_type ret_val;
    object_node *o = NULL;
-   class_node *c;
+   class_node *c, *ancestor;
+
+   ancestor = GetClassByID(class_id);
 
    l = GetListNodeByID(list_id);
    if (!l)
@@ -1271,22 +1521,17 @@ int SendListMessageByClass(int list_id, int class_id, bool ret_false,
          FlushDefaultChannels();
          return return_int;
       }
-      do
+      if (IsClassDescendant(c,ancestor))
       {
-         if (c->class_id == class_id)
+         ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+         o = NULL;
+         if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
          {
-            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-            o = NULL;
-            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-            {
-               if (ret_false)
-                  return False;
-               return_int = False;
-            }
-            break;
+            if (ret_false)
+               return False;
+            return_int = False;
          }
-         c = c->super_ptr;
-      } while (c != NULL);
+      }
    }
 
    while (l && l->rest.v.tag != TAG_NIL)
@@ -1321,22 +1566,17 @@ int SendListMessageByClass(int list_id, int class_id, bool ret_false,
          FlushDefaultChannels();
          return return_int;
       }
-      do
+      if (IsClassDescendant(c,ancestor))
       {
-         if (c->class_id == class_id)
+         ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+         o = NULL;
+         if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
          {
-            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-            o = NULL;
-            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-            {
-               if (ret_false)
-                  return False;
-               return_int = False;
-            }
-            break;
+            if (ret_false)
+               return False;
+            return_int = False;
          }
-         c = c->super_ptr;
-      } while (c != NULL);
+      }
    }
 
    return return_int;
@@ -1350,7 +1590,9 @@ int SendFirstListMessageByClass(int list_id, int class_id, bool ret_false,
    int obj_id = INVALID_OBJECT, return_int = True;
    val_type ret_val;
    object_node *o = NULL;
-   class_node *c;
+   class_node *c, *ancestor;
+
+   ancestor = GetClassByID(class_id);
 
    l = GetListNodeByID(list_id);
    if (!l)
@@ -1393,22 +1635,17 @@ int SendFirstListMessageByClass(int list_id, int class_id, bool ret_false,
             FlushDefaultChannels();
             return return_int;
          }
-         do
+         if (IsClassDescendant(c,ancestor))
          {
-            if (c->class_id == class_id)
+            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+            o = NULL;
+            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
             {
-               ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-               o = NULL;
-               if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-               {
-                  if (ret_false)
-                     return False;
-                  return_int = False;
-               }
-               break;
+               if (ret_false)
+                  return False;
+               return_int = False;
             }
-            c = c->super_ptr;
-         } while (c != NULL);
+         }
       }
    }
 
@@ -1459,22 +1696,17 @@ int SendFirstListMessageByClass(int list_id, int class_id, bool ret_false,
          FlushDefaultChannels();
          return return_int;
       }
-      do
+      if (IsClassDescendant(c,ancestor))
       {
-         if (c->class_id == class_id)
+         ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+         o = NULL;
+         if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
          {
-            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-            o = NULL;
-            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-            {
-               if (ret_false)
-                  return False;
-               return_int = False;
-            }
-            break;
+            if (ret_false)
+               return False;
+            return_int = False;
          }
-         c = c->super_ptr;
-      } while (c != NULL);
+      }
    }
 
    return return_int;
@@ -1488,7 +1720,9 @@ int SendNthListMessageByClass(int list_id, int position, int class_id, bool ret_
    int obj_id = INVALID_OBJECT, return_int = True;
    val_type ret_val, obj_val;
    object_node *o = NULL;
-   class_node *c;
+   class_node *c, *ancestor;
+
+   ancestor = GetClassByID(class_id);
 
    l = GetListNodeByID(list_id);
    if (!l)
@@ -1527,22 +1761,17 @@ int SendNthListMessageByClass(int list_id, int position, int class_id, bool ret_
             FlushDefaultChannels();
             return return_int;
          }
-         do
+         if (IsClassDescendant(c,ancestor))
          {
-            if (c->class_id == class_id)
+            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+            o = NULL;
+            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
             {
-               ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-               o = NULL;
-               if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-               {
-                  if (ret_false)
-                     return False;
-                  return_int = False;
-               }
-               break;
+               if (ret_false)
+                  return False;
+               return_int = False;
             }
-            c = c->super_ptr;
-         } while (c != NULL);
+         }
       }
    }
 
@@ -1586,22 +1815,17 @@ int SendNthListMessageByClass(int list_id, int position, int class_id, bool ret_
          FlushDefaultChannels();
          return return_int;
       }
-      do
+      if (IsClassDescendant(c,ancestor))
       {
-         if (c->class_id == class_id)
+         ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
+         o = NULL;
+         if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
          {
-            ret_val.int_val = SendBlakodMessage(o->object_id, message_id, num_parms, parms);
-            o = NULL;
-            if (ret_val.v.tag == TAG_INT && ret_val.v.data == False)
-            {
-               if (ret_false)
-                  return False;
-               return_int = False;
-            }
-            break;
+            if (ret_false)
+               return False;
+            return_int = False;
          }
-         c = c->super_ptr;
-      } while (c != NULL);
+      }
    }
 
    return return_int;
@@ -1644,4 +1868,8 @@ void MoveListNode(int dest_id,int source_id)
 void SetNumListNodes(int new_num_nodes)
 {
 	num_nodes = new_num_nodes;
+	
+	/* node ids have all changed */
+	ClearListVectors();
+	ClearListFreeNodes();
 }
@@ -15,17 +15,32 @@
 
 #define INIT_LIST_NODES (4000000)
 
+/* lists at least this long get a vector of their node ids, so that
+   Nth, Length and Last don't walk the list */
+#define LIST_VECTOR_MIN 8
+#define MAX_LIST_VECTORS 16384
+
+/* don't bother reclaiming list nodes until this many have been handed out */
+#define LIST_RECLAIM_MIN 100000
+
 typedef struct
 {
    val_type first;
    val_type rest;
    int garbage_ref;
+   int vector_id;  /* list vector this node may be in, see list.c */
+   int vector_pos;
 } list_node;
 
 void InitList(void);
 void ResetList(void);
 void ClearList(void);
 int GetListNodesUsed(void);
+int GetListNodesFree(void);
+int GetListNodesSinceReclaim(void);
+void ClearListFreeNodes(void);
+void FreeListNode(int list_id);
+int GetListVectorsUsed(void);
 Bool LoadList(int list_id,val_type first,val_type rest);
 list_node * GetListNodeByID(int list_id);
 Bool IsListNodeByID(int list_id);
@@ -105,6 +105,7 @@ Bool LoadGameObject(void);
 Bool LoadGameListNodes(void);
 Bool LoadGameTables(void);
 Bool LoadGameTimer(void);
+Bool LoadGamePeriodicTimer(void);
 Bool LoadGameUser(void);
 Bool LoadGameClass(void);
 void LoadAddPropertyName(load_game_class_node *lgc,int prop_old_id,char *prop_name);
@@ -252,6 +253,10 @@ Bool LoadGameParse(char *filename)
 			if (!LoadGameTimer())
 				return False;
 			break;
+		case SAVE_GAME_PERIODIC_TIMER :
+			if (!LoadGamePeriodicTimer())
+				return False;
+			break;
 		case SAVE_GAME_USER :
 			if (!LoadGameUser())
 				return False;
@@ -392,6 +397,10 @@ Bool LoadGameTables(void)
       LoadGameReadInt(&size);
       LoadGameReadInt(&num_entries);
 
+      // Tables can outgrow the largest size Kod may ask for; inserting
+      // the entries grows them back.
+      if (size > MAX_TABLE_SIZE)
+         size = MAX_TABLE_SIZE;
       table_id = CreateTable(size);
       t = GetTableByID(table_id);
       if (t == NULL)
@@ -407,13 +416,6 @@ Bool LoadGameTables(void)
          return False;
       }
 
-      if (t->size != size)
-      {
-         eprintf("LoadGameTables got invalid table size %i, expected %i\n",
-            t->size, size);
-         return False;
-      }
-
       for (int j = 0; j < num_entries; ++j)
       {
          LoadGameReadInt(&key_val.int_val);
@@ -439,7 +441,7 @@ Bool LoadGameTimer(void)
 	LoadGameReadString(buf,sizeof(buf));
 	LoadGameReadInt(&milliseconds);
 	
-	if (!LoadTimer(timer_id,object_id,buf,milliseconds))
+	if (!LoadTimer(timer_id,object_id,buf,milliseconds,0))
 	{
 		eprintf("LoadGameTimer can't set timer %i\n",timer_id);
 		/* still ok */
@@ -447,6 +449,31 @@ Bool LoadGameTimer(void)
 	return True;
 }
 
+Bool LoadGamePeriodicTimer(void)
+{
+	int timer_id,object_id,milliseconds,period;
+	char buf[100];
+	
+	LoadGameReadInt(&timer_id);
+	LoadGameReadInt(&object_id);
+	LoadGameReadString(buf,sizeof(buf));
+	LoadGameReadInt(&milliseconds);
+	LoadGameReadInt(&period);
+	
+	if (period <= 0)
+	{
+		eprintf("LoadGamePeriodicTimer got bad period %i for timer %i\n",period,timer_id);
+		period = 0;
+	}
+	
+	if (!LoadTimer(timer_id,object_id,buf,milliseconds,period))
+	{
+		eprintf("LoadGamePeriodicTimer can't set timer %i\n",timer_id);
+		/* still ok */
+	}
+	return True;
+}
+
 Bool LoadGameUser(void)
 {   
 	int object_id,account_id;
@@ -14,6 +14,11 @@
   file is maintained.  When each .bof file is loaded, the classes and
   message handlers are created by class.c and message.c.  The format of
   the .bof files is in bof.txt.
+
+  After all the classes are set up, each message handler's bkod is
+  translated into a pre-decoded instruction stream (TranslateBkod), which
+  is what sendmsg.c actually executes.  The raw bkod stays loaded and is
+  still used for debugging info and source line lookups.
   
 */
 
@@ -28,11 +33,19 @@ static unsigned char magic_num[] = { 'B', 'O', 'F', 0xFF };
 /* variables */
 loaded_bof_node *mem_files;
 
+static int num_translated;
+static int num_untranslated;
+static int num_unsorted_parms;
+
 /* local function prototypes */
 Bool LoadBofName(char *fname);
 void AddFileMem(char *fname,char *ptr,int size);
 void FindClasses(char *fmem,char *fname);
 void FindMessages(char *fmem,int class_id,bof_dispatch *dispatch);
+void TranslateClassMessages(class_node *c);
+kod_code * TranslateBkod(class_node *c,message_node *m,char *bof_end);
+Bool VerifyBkodCode(class_node *c,message_node *m,kod_code *code);
+Bool VerifyOperand(class_node *c,kod_code *code,int type,int index,Bool store);
 
 void InitLoadBof(void)
 {
@@ -84,6 +97,19 @@ void LoadBof(void)
 	SetClassesSuperPtr();
 	SetClassVariables();
 	SetMessagesPropagate();
+	SetMessagesDispatch();
+
+	num_translated = 0;
+	num_untranslated = 0;
+	num_unsorted_parms = 0;
+	ForEachClass(TranslateClassMessages);
+	if (num_untranslated > 0)
+		dprintf("LoadBof couldn't translate %i of %i message handlers, they will run "
+			"as raw bkod\n",num_untranslated,num_translated + num_untranslated);
+	/* the compiler sorts parameter lists; binding still works if it didn't,
+	   but is slower */
+	if (num_unsorted_parms > 0)
+		dprintf("LoadBof found %i unsorted parameter lists\n",num_unsorted_parms);
 
 	//dprintf("LoadBof loaded %i of %i found .bof files\n",files_loaded,files.size());
 }
@@ -230,3 +256,403 @@ void FindMessages(char *fmem,int class_id,bof_dispatch *dispatch)
                  (char *)(fmem + messages[i].offset),
                  messages[i].dstr_id);
 }
+
+int GetNumTranslatedHandlers(void)
+{
+	return num_translated;
+}
+
+int GetNumUntranslatedHandlers(void)
+{
+	return num_untranslated;
+}
+
+void FreeBkodCode(kod_code *code)
+{
+	FreeMemory(MALLOC_ID_LOADBOF,code,code->size);
+}
+
+void TranslateClassMessages(class_node *c)
+{
+	loaded_bof_node *lf;
+	message_node *m;
+	char *bof_end;
+	int i;
+
+	if (!c->num_messages)
+		return;
+
+	/* need the end of the file so we never decode past it */
+	bof_end = NULL;
+	for (lf = mem_files; lf != NULL; lf = lf->next)
+		if (lf->mem == c->bof_base)
+			bof_end = lf->mem + lf->length;
+	if (bof_end == NULL)
+	{
+		eprintf("TranslateClassMessages can't find bof for CLASS %i\n",c->class_id);
+		return;
+	}
+
+	for (i = 0; i < MESSAGE_TABLE_SIZE; ++i)
+	{
+		for (m = c->messages[i]; m != NULL; m = m->next)
+		{
+			m->code = TranslateBkod(c,m,bof_end);
+			if (m->code != NULL && !VerifyBkodCode(c,m,m->code))
+			{
+				FreeBkodCode(m->code);
+				m->code = NULL;
+			}
+			if (m->code == NULL)
+				num_untranslated++;
+			else
+				num_translated++;
+		}
+	}
+}
+
+/* TranslateBkod
+*
+* Decodes one message handler into a kod_code block.  The handler has no
+* stored length, so we decode linearly from the start and stop at the
+* first RETURN or unconditional GOTO which isn't followed by the target of
+* some earlier forward jump; anything after that is unreachable.  Returns
+* NULL if the handler has something the translator doesn't understand
+* (bad opcode, jump into the middle of an instruction, etc.), in which
+* case the interpreter falls back to running the raw bkod.
+*/
+kod_code * TranslateBkod(class_node *c,message_node *m,char *bof_end)
+{
+	std::vector<kod_inst> insts;
+	std::vector<int> offsets,targets,call_parm_base;
+	std::vector<kod_call> calls;
+	std::vector<parm_node> parms;
+	kod_code *code;
+	kod_call *code_calls;
+	parm_node *code_parms;
+	char *start,*p;
+	int num_locals,num_parms,max_target,size,i,j;
+
+	p = m->handler;
+	if (p + 2 > bof_end)
+		return NULL;
+	num_locals = (unsigned char) *p++;
+	num_parms = (unsigned char) *p++;
+	if (num_locals + num_parms > MAX_LOCALS || p + num_parms*8 > bof_end)
+		return NULL;
+	/* parm ids and defaults are read straight from the header below */
+	p += num_parms*8;
+	start = p;
+
+	max_target = 0;
+	for (;;)
+	{
+		opcode_type opcode;
+		kod_inst inst;
+		Bool done = False;
+		int offset = (int)(p - start);
+
+		if (p + 1 > bof_end)
+			return NULL;
+		memcpy(&opcode,p,1);
+		memset(&inst,0,sizeof(inst));
+		inst.bkod = p;
+		p++;
+
+		offsets.push_back(offset);
+		targets.push_back(-1);
+		call_parm_base.push_back(-1);
+
+		switch (opcode.command)
+		{
+		case UNARY_ASSIGN :
+			if (p + 1 + 2*sizeof(bkod_type) > bof_end)
+				return NULL;
+			if ((unsigned char) *p > PRE_DECREMENT)
+				return NULL;
+			inst.op = KI_UNARY_BASE + (unsigned char) *p++;
+			inst.dest_type = opcode.dest;
+			inst.source1_type = opcode.source1;
+			memcpy(&inst.dest,p,4);
+			memcpy(&inst.source1,p + 4,4);
+			p += 8;
+			break;
+
+		case BINARY_ASSIGN :
+			if (p + 1 + 3*sizeof(bkod_type) > bof_end)
+				return NULL;
+			if ((unsigned char) *p > BITWISE_OR)
+				return NULL;
+			inst.op = KI_BINARY_BASE + (unsigned char) *p++;
+			inst.dest_type = opcode.dest;
+			inst.source1_type = opcode.source1;
+			inst.source2_type = opcode.source2;
+			memcpy(&inst.dest,p,4);
+			memcpy(&inst.source1,p + 4,4);
+			memcpy(&inst.source2,p + 8,4);
+			p += 12;
+			break;
+
+		case GOTO :
+		{
+			int dest_addr;
+
+			if (p + 4 > bof_end)
+				return NULL;
+			memcpy(&dest_addr,p,4);
+			p += 4;
+			targets.back() = offset + dest_addr;
+			if (offset + dest_addr > max_target)
+				max_target = offset + dest_addr;
+			if (opcode.source2 == GOTO_UNCONDITIONAL)
+			{
+				inst.op = KI_GOTO;
+				done = True;
+				break;
+			}
+			if (p + 4 > bof_end)
+				return NULL;
+			inst.op = (opcode.dest == GOTO_IF_TRUE) ? KI_GOTO_IF_TRUE : KI_GOTO_IF_FALSE;
+			inst.source1_type = opcode.source1;
+			memcpy(&inst.source1,p,4);
+			p += 4;
+			break;
+		}
+
+		case CALL :
+		{
+			kod_call call;
+
+			memset(&call,0,sizeof(call));
+			call.send_cache.class_id = INVALID_CLASS;
+			call.send_cache.num_bound = -1;
+			inst.op = KI_CALL;
+			if (p + 1 > bof_end)
+				return NULL;
+			call.function = (unsigned char) *p++;
+			call.assign_type = opcode.source1;
+			if (call.assign_type == CALL_ASSIGN_LOCAL_VAR ||
+				call.assign_type == CALL_ASSIGN_PROPERTY)
+			{
+				if (p + 4 > bof_end)
+					return NULL;
+				memcpy(&call.assign_index,p,4);
+				p += 4;
+			}
+			else
+				call.assign_type = CALL_NO_ASSIGN;
+
+			call_parm_base.back() = (int) parms.size();
+
+			if (p + 1 > bof_end)
+				return NULL;
+			call.num_normal_parms = (unsigned char) *p++;
+			if (call.num_normal_parms > MAX_C_PARMS ||
+				p + call.num_normal_parms*5 + 1 > bof_end)
+				return NULL;
+			for (i = 0; i < call.num_normal_parms; i++)
+			{
+				parm_node parm;
+				parm.name_id = 0;
+				parm.type = *p++;
+				memcpy(&parm.value,p,4);
+				p += 4;
+				parms.push_back(parm);
+			}
+
+			call.num_name_parms = (unsigned char) *p++;
+			if (call.num_name_parms > MAX_NAME_PARMS ||
+				p + call.num_name_parms*9 > bof_end)
+				return NULL;
+			call.name_parms_sorted = True;
+			for (i = 0; i < call.num_name_parms; i++)
+			{
+				parm_node parm;
+				memcpy(&parm.name_id,p,4);
+				parm.type = p[4];
+				memcpy(&parm.value,p + 5,4);
+				p += 9;
+				if (i > 0 && parm.name_id <= parms.back().name_id)
+					call.name_parms_sorted = False;
+				parms.push_back(parm);
+			}
+			if (!call.name_parms_sorted)
+				num_unsorted_parms++;
+
+			inst.dest = (int) calls.size();
+			calls.push_back(call);
+			break;
+		}
+
+		case RETURN :
+			if (opcode.dest == PROPAGATE)
+				inst.op = KI_PROPAGATE;
+			else
+			{
+				if (p + 4 > bof_end)
+					return NULL;
+				inst.op = KI_RETURN;
+				inst.source1_type = opcode.source1;
+				memcpy(&inst.source1,p,4);
+				p += 4;
+			}
+			done = True;
+			break;
+
+		default :
+			return NULL;
+		}
+
+		inst.handler = GetKodInstHandler(inst.op);
+		insts.push_back(inst);
+
+		if (done && max_target < (int)(p - start))
+			break;
+	}
+
+	/* one block holds the header, instructions, calls, call parms and the
+	   handler's parameter list */
+	size = sizeof(kod_code) + insts.size()*sizeof(kod_inst) +
+		calls.size()*sizeof(kod_call) + parms.size()*sizeof(parm_node) +
+		num_parms*(sizeof(val_type) + sizeof(int));
+	code = (kod_code *) AllocateMemory(MALLOC_ID_LOADBOF,size);
+	code->size = size;
+	code->num_locals = num_locals;
+	code->num_parms = num_parms;
+	code->num_inst = (int) insts.size();
+	code->inst = (kod_inst *)(code + 1);
+	code_calls = (kod_call *)(code->inst + insts.size());
+	code_parms = (parm_node *)(code_calls + calls.size());
+	code->parm_defaults = (val_type *)(code_parms + parms.size());
+	code->parm_ids = (int *)(code->parm_defaults + num_parms);
+
+	code->parms_sorted = True;
+	p = m->handler + 2;
+	for (i = 0; i < num_parms; i++)
+	{
+		memcpy(&code->parm_ids[i],p,4);
+		memcpy(&code->parm_defaults[i].int_val,p + 4,4);
+		p += 8;
+		if (i > 0 && code->parm_ids[i] <= code->parm_ids[i-1])
+			code->parms_sorted = False;
+	}
+	if (!code->parms_sorted)
+		num_unsorted_parms++;
+
+	if (!parms.empty())
+		memcpy(code_parms,&parms[0],parms.size()*sizeof(parm_node));
+
+	for (i = 0; i < code->num_inst; i++)
+	{
+		kod_inst *inst = &code->inst[i];
+
+		*inst = insts[i];
+		if (inst->op == KI_CALL)
+		{
+			kod_call *call = &code_calls[inst->dest];
+
+			*call = calls[inst->dest];
+			call->normal_parms = code_parms + call_parm_base[i];
+			call->name_parms = call->normal_parms + call->num_normal_parms;
+			inst->call = call;
+			inst->dest = 0;
+		}
+		else if (targets[i] >= 0)
+		{
+			/* offsets are in increasing order */
+			std::vector<int>::iterator it =
+				std::lower_bound(offsets.begin(),offsets.end(),targets[i]);
+			if (it == offsets.end() || *it != targets[i])
+			{
+				FreeBkodCode(code);
+				return NULL;
+			}
+			j = (int)(it - offsets.begin());
+			inst->target = &code->inst[j];
+		}
+	}
+
+	return code;
+}
+
+/* VerifyBkodCode
+*
+* Checks every operand of a translated handler: local variables must be
+* within the handler's locals and parms, properties within the class's
+* properties (subclasses only add more), and class vars within the
+* class's vars.  Stores must go to a local or a property.  InterpretCode
+* relies on this to skip the range checks in RetrieveValue and StoreValue.
+* A handler that fails is reported and left to run as raw bkod, which
+* still checks each access.
+*/
+Bool VerifyBkodCode(class_node *c,message_node *m,kod_code *code)
+{
+	kod_inst *inst;
+	kod_call *call;
+	int i,j;
+	Bool ok;
+
+	for (i = 0; i < code->num_inst; i++)
+	{
+		inst = &code->inst[i];
+		ok = True;
+
+		if (inst->op < KI_BINARY_BASE)
+		{
+			ok = VerifyOperand(c,code,inst->source1_type,inst->source1,False) &&
+				VerifyOperand(c,code,inst->dest_type,inst->dest,True);
+			/* increments and decrements also write back to the source */
+			if (inst->op >= KI_POST_INCREMENT)
+				ok = ok && VerifyOperand(c,code,inst->dest_type,inst->source1,True);
+		}
+		else if (inst->op < KI_GOTO)
+		{
+			ok = VerifyOperand(c,code,inst->source1_type,inst->source1,False) &&
+				VerifyOperand(c,code,inst->source2_type,inst->source2,False) &&
+				VerifyOperand(c,code,inst->dest_type,inst->dest,True);
+		}
+		else if (inst->op == KI_GOTO_IF_TRUE || inst->op == KI_GOTO_IF_FALSE ||
+			inst->op == KI_RETURN)
+		{
+			ok = VerifyOperand(c,code,inst->source1_type,inst->source1,False);
+		}
+		else if (inst->op == KI_CALL)
+		{
+			call = inst->call;
+			for (j = 0; ok && j < call->num_normal_parms; j++)
+				ok = VerifyOperand(c,code,call->normal_parms[j].type,
+					call->normal_parms[j].value,False);
+			for (j = 0; ok && j < call->num_name_parms; j++)
+				ok = VerifyOperand(c,code,call->name_parms[j].type,
+					call->name_parms[j].value,False);
+			if (ok && call->assign_type != CALL_NO_ASSIGN)
+				ok = VerifyOperand(c,code,call->assign_type,call->assign_index,True);
+		}
+
+		if (!ok)
+		{
+			eprintf("VerifyBkodCode found a bad operand in CLASS %s MESSAGE %s (%i) "
+				"at offset %i, it will run as raw bkod\n",c->class_name,
+				GetNameByID(m->message_id),m->message_id,(int)(inst->bkod - c->bof_base));
+			return False;
+		}
+	}
+	return True;
+}
+
+Bool VerifyOperand(class_node *c,kod_code *code,int type,int index,Bool store)
+{
+	switch (type)
+	{
+	case LOCAL_VAR :
+		return index >= 0 && index < code->num_locals + code->num_parms;
+	case PROPERTY :
+		/* property 0 is self */
+		return index >= 0 && index <= c->num_properties;
+	case CONSTANT :
+		return !store;
+	case CLASS_VAR :
+		return !store && index >= 0 && index < c->num_vars;
+	}
+	return False;
+}
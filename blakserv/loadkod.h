@@ -21,9 +21,101 @@ typedef struct loaded_bof_struct
    struct loaded_bof_struct *next;
 } loaded_bof_node;
 
+/* Pre-decoded instruction ops.  Each message handler's bkod is translated
+   into an array of kod_inst at load time (see TranslateBkod), with the
+   unary and binary info bytes folded into the op so the interpreter
+   dispatches once per instruction.  The unary and binary ops are in the
+   same order as their info bytes in bkod.h. */
+enum
+{
+   KI_NOT = 0,
+   KI_NEGATE,
+   KI_NONE,
+   KI_BITWISE_NOT,
+   KI_POST_INCREMENT,
+   KI_POST_DECREMENT,
+   KI_PRE_INCREMENT,
+   KI_PRE_DECREMENT,
+
+   KI_ADD,
+   KI_SUBTRACT,
+   KI_MULTIPLY,
+   KI_DIV,
+   KI_MOD,
+   KI_AND,
+   KI_OR,
+   KI_EQUAL,
+   KI_NOT_EQUAL,
+   KI_LESS_THAN,
+   KI_GREATER_THAN,
+   KI_LESS_EQUAL,
+   KI_GREATER_EQUAL,
+   KI_BITWISE_AND,
+   KI_BITWISE_OR,
+
+   KI_GOTO,
+   KI_GOTO_IF_TRUE,
+   KI_GOTO_IF_FALSE,
+   KI_CALL,
+   KI_RETURN,
+   KI_PROPAGATE,
+
+   NUM_KI_OPS
+};
+
+#define KI_UNARY_BASE KI_NOT
+#define KI_BINARY_BASE KI_ADD
+
+typedef struct kod_call_struct
+{
+   unsigned char function;     /* c function id */
+   unsigned char assign_type;  /* CALL_ASSIGN_LOCAL_VAR etc. */
+   unsigned char num_normal_parms;
+   unsigned char num_name_parms;
+   unsigned char name_parms_sorted; /* name_parms in increasing name_id order */
+   int assign_index;
+   parm_node *normal_parms;    /* passed to the c function as is */
+   parm_node *name_parms;      /* type/value are the unresolved operand */
+   send_cache_type send_cache; /* for SENDMESSAGE calls */
+} kod_call;
+
+typedef struct kod_inst_struct
+{
+   const void *handler;        /* label of op, when using threaded dispatch */
+   unsigned char op;
+   unsigned char dest_type;
+   unsigned char source1_type;
+   unsigned char source2_type;
+   int dest;
+   int source1;
+   int source2;
+   union
+   {
+      struct kod_inst_struct *target; /* for gotos */
+      kod_call *call;                 /* for calls */
+   };
+   char *bkod;                 /* raw bkod of this instruction, for debugging */
+} kod_inst;
+
+/* one allocated block per message handler; the arrays follow the header */
+typedef struct kod_code_struct
+{
+   int size;
+   int num_locals;
+   int num_parms;
+   int num_inst;
+   Bool parms_sorted;          /* parm_ids in increasing order */
+   int *parm_ids;
+   val_type *parm_defaults;
+   kod_inst *inst;
+} kod_code;
+
 void InitLoadBof(void);
 void ResetLoadBof(void);
 void LoadBof(void);
+void FreeBkodCode(kod_code *code);
+int GetNumTranslatedHandlers(void);
+int GetNumUntranslatedHandlers(void);
 void CloseAllFiles(void);
 
 #endif
@@ -250,6 +250,7 @@ const char *memory_stat_names[] =
 		"Configuration", "Rooms",
 		"Admin constants", "Buffers", "Game loading",
 		"Tables", "Socket blocks", "Game saving",
+		"Posted messages",
 		
 		NULL
 };
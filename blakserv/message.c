@@ -21,6 +21,8 @@
 /* local function prototypes */
 void ResetMessageClass(class_node *c);
 void SetEachClassMessagesPropagate(class_node *c);
+void SetEachClassMessagesDispatch(class_node *c);
+void AddDispatchEntry(class_node *c,int message_id,message_node *m,class_node *found_class);
 
 static int max_messages;
 static int hash_collisions;
@@ -43,6 +45,15 @@ void ResetMessageClass(class_node *c)
 {
    message_node *m, *temp;
 
+   if (c->dispatch != NULL)
+   {
+      FreeMemory(MALLOC_ID_MESSAGE, c->dispatch,
+         (c->dispatch_mask + 1) * sizeof(dispatch_entry));
+      c->dispatch = NULL;
+      c->dispatch_mask = 0;
+      c->dispatch_count = 0;
+   }
+
    if (!c->num_messages)
       return;
 
@@ -52,6 +63,8 @@ void ResetMessageClass(class_node *c)
       while (m != NULL)
       {
          temp = m->next;
+         if (m->code != NULL)
+            FreeBkodCode(m->code);
          FreeMemory(MALLOC_ID_MESSAGE, m, sizeof(message_node));
          m = temp;
       }
@@ -112,6 +125,9 @@ void AddMessage(int class_id,int count,int message_id,char *offset,int dstr_id)
    m->timed_call_count = 0;
    m->untimed_call_count = 0;
    m->total_call_time = 0.0;
+   m->propagate_message = NULL;
+   m->propagate_class = NULL;
+   m->code = NULL;
 
    m->next = NULL;
 
@@ -157,10 +173,86 @@ void SetEachClassMessagesPropagate(class_node *c)
    }
 }
 
+/* SetMessagesDispatch
+   Builds each class's flattened dispatch table, so finding the handler for
+   a message is one hash probe instead of a search up the class chain.
+   Must be called after SetClassesSuperPtr. */
+
+void SetMessagesDispatch()
+{
+   ForEachClass(SetEachClassMessagesDispatch);
+}
+
+void SetEachClassMessagesDispatch(class_node *c)
+{
+   dispatch_entry *super_dispatch;
+   message_node *m;
+   int size, super_size, i;
+
+   if (c->dispatch != NULL)
+      return;
+
+   /* build the parent's table first, then start from a copy of it */
+   super_dispatch = NULL;
+   super_size = 0;
+   size = c->num_messages;
+   if (c->super_ptr != NULL)
+   {
+      SetEachClassMessagesDispatch(c->super_ptr);
+      super_dispatch = c->super_ptr->dispatch;
+      super_size = c->super_ptr->dispatch_mask + 1;
+      size += c->super_ptr->dispatch_count;
+   }
+
+   /* keep the table at most half full */
+   i = 8;
+   while (i < 2 * size)
+      i *= 2;
+   c->dispatch_mask = i - 1;
+   c->dispatch_count = 0;
+   c->dispatch = (dispatch_entry *)AllocateMemoryCalloc(MALLOC_ID_MESSAGE,
+      i, sizeof(dispatch_entry));
+
+   for (i = 0; i < super_size; ++i)
+      if (super_dispatch[i].m != NULL)
+         AddDispatchEntry(c, super_dispatch[i].message_id, super_dispatch[i].m,
+                          super_dispatch[i].found_class);
+
+   /* this class's own handlers override inherited ones */
+   if (!c->num_messages)
+      return;
+   for (i = 0; i < MESSAGE_TABLE_SIZE; ++i)
+      for (m = c->messages[i]; m != NULL; m = m->next)
+         AddDispatchEntry(c, m->message_id, m, c);
+}
+
+void AddDispatchEntry(class_node *c, int message_id, message_node *m, class_node *found_class)
+{
+   int hash_num;
+
+   hash_num = GetDispatchHashNum(message_id, c->dispatch_mask);
+   while (c->dispatch[hash_num].m != NULL)
+   {
+      if (c->dispatch[hash_num].message_id == message_id)
+      {
+         c->dispatch[hash_num].m = m;
+         c->dispatch[hash_num].found_class = found_class;
+         return;
+      }
+      hash_num = (hash_num + 1) & c->dispatch_mask;
+   }
+
+   c->dispatch[hash_num].message_id = message_id;
+   c->dispatch[hash_num].m = m;
+   c->dispatch[hash_num].found_class = found_class;
+   c->dispatch_count++;
+}
+
 message_node *GetMessageByID(int class_id, int message_id, class_node **found_class)
 {
    class_node *c;
    message_node *m;
+   dispatch_entry *d;
 
    c = GetClassByID(class_id);
 
@@ -170,6 +262,24 @@ message_node *GetMessageByID(int class_id, int message_id, class_node **found_cl
       return NULL;
    }
 
+   if (c->dispatch != NULL)
+   {
+      d = &c->dispatch[GetDispatchHashNum(message_id, c->dispatch_mask)];
+      while (d->m != NULL)
+      {
+         if (d->message_id == message_id)
+         {
+            if (found_class != NULL)
+               *found_class = d->found_class;
+            return d->m;
+         }
+         if (++d > &c->dispatch[c->dispatch_mask])
+            d = c->dispatch;
+      }
+      return NULL;
+   }
+
+   /* dispatch tables not built yet (still loading) */
    do
    {
       if (c->num_messages)
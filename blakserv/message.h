@@ -30,15 +30,44 @@ typedef struct message_struct
    int timed_call_count;
    struct message_struct *propagate_message;
    struct class_struct *propagate_class;
+   struct kod_code_struct *code; /* pre-decoded handler, NULL if untranslated */
    double total_call_time;
    struct message_struct *next; /* for open hash table linked list */
 } message_node;
 
+/* Entry in a class's flattened dispatch table, which holds every message
+   the class responds to, inherited ones included.  found_class is the
+   class that actually defines the handler. */
+typedef struct
+{
+   int message_id;
+   message_node *m;
+   struct class_struct *found_class;
+} dispatch_entry;
+
+#define GetDispatchHashNum(id,mask) ((((unsigned int)(id)) * 2654435761U >> 12) & (mask))
+
+#define MAX_BOUND_PARMS 16
+
+/* Monomorphic inline cache for a send site, see SendBlakodMessageCached.
+   bound_parm maps each parameter of the cached handler to the index of the
+   site's named parameter that supplies it, or -1 to use the default. */
+typedef struct
+{
+   int class_id;
+   int message_id;
+   message_node *m;
+   struct class_struct *found_class;
+   int num_bound;    /* -1 if the handler has no binding */
+   signed char bound_parm[MAX_BOUND_PARMS];
+} send_cache_type;
+
 void InitMessage(void);
 void ResetMessage(void);
 void SetClassNumMessages(int class_id,int num_messages);
 void AddMessage(int class_id,int count,int message_id,char *offset,int dstr_id);
 void SetMessagesPropagate(void);
+void SetMessagesDispatch(void);
 int GetHighestMessageCount(void);
 int GetNumMessageHashCollisions(void);
 
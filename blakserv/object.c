@@ -10,51 +10,58 @@
  *
 
  This module maintains a dynamically sized array with the Blakod
- objects. 
+ objects.  It's a chunk_array, so object pointers survive new objects
+ being created.
+
+ The properties of each object are a block of num_props values.  Blocks
+ are cut from big slabs, one set of slabs for each block size, so the
+ properties of objects made one after another sit next to each other
+ instead of all over the heap.  Freed blocks are kept for reuse by the
+ next object with that many properties; the slabs themselves are only
+ freed when all objects are.
 
  */
 
 #include "blakserv.h"
 
-object_node *objects;
-int num_objects,max_objects;
+chunk_array<object_node> objects;
+int num_objects;
+
+typedef struct
+{
+   std::vector<prop_type *> free_blocks;
+   prop_type *next;  /* unused part of the newest slab */
+   int num_left;     /* blocks left there */
+} prop_slab_list;
+
+/* indexed by block size in properties */
+static std::vector<prop_slab_list> prop_slabs;
+
+typedef struct
+{
+   prop_type *mem;
+   int size;
+} prop_slab;
+
+static std::vector<prop_slab> prop_slab_mem;
 
 /* local function prototypes */
 void SetObjectProperties(int object_id,class_node *c);
+prop_type * AllocateProperties(int num_props);
+void FreeProperties(prop_type *p,int num_props);
+void FreeAllProperties(void);
 
 void InitObject()
 {
    num_objects = 0;
-   max_objects = INIT_OBJECTS;
-   objects = (object_node *)AllocateMemory(MALLOC_ID_OBJECT,max_objects*sizeof(object_node));
+   objects.Init(MALLOC_ID_OBJECT,INIT_OBJECTS);
 }
 
 void ResetObject()
 {
-   int i,old_objects;
-   class_node *c;
-
-   for (i=0;i<num_objects;i++)
-   {
-      if (!objects[i].deleted)
-      {
-	 c = GetClassByID(objects[i].class_id);
-	 if (c == NULL)
-	 {
-	    eprintf("ResetObject can't find class id %i\n",objects[i].class_id);
-	    return;
-	 }
-
-	 FreeMemory(MALLOC_ID_OBJECT_PROPERTIES,objects[i].p,
-		    sizeof(prop_type)*(1+c->num_properties));
-      }
-   }
-   old_objects = max_objects;
+   FreeAllProperties();
    num_objects = 0;  
-   max_objects = INIT_OBJECTS;
-   objects = (object_node *)
-      ResizeMemory(MALLOC_ID_OBJECT,objects,old_objects*sizeof(object_node),
-		   max_objects*sizeof(object_node));
+   objects.Shrink(INIT_OBJECTS);
 }
 
 /* ClearObject
@@ -64,14 +71,9 @@ void ResetObject()
  */
 void ClearObject()
 {
-   int old_objects;
-
-   old_objects = max_objects;
+   FreeAllProperties();
    num_objects = 0;
-   max_objects = INIT_OBJECTS;
-   objects = (object_node *)
-      ResizeMemory(MALLOC_ID_OBJECT,objects,old_objects*sizeof(object_node),
-		   max_objects*sizeof(object_node));
+   objects.Shrink(INIT_OBJECTS);
 }
 
 int GetObjectsUsed()
@@ -79,9 +81,60 @@ int GetObjectsUsed()
    return num_objects;
 }
 
+prop_type * AllocateProperties(int num_props)
+{
+   prop_slab_list *sl;
+   prop_slab slab;
+   prop_type *p;
+   int num_blocks;
+
+   if (num_props >= (int)prop_slabs.size())
+      prop_slabs.resize(num_props + 1);
+   sl = &prop_slabs[num_props];
+
+   if (!sl->free_blocks.empty())
+   {
+      p = sl->free_blocks.back();
+      sl->free_blocks.pop_back();
+      return p;
+   }
+
+   if (sl->num_left == 0)
+   {
+      num_blocks = std::max(1,(int)(PROP_SLAB_BYTES/(num_props*sizeof(prop_type))));
+      slab.size = num_blocks*num_props*sizeof(prop_type);
+      slab.mem = (prop_type *)AllocateMemory(MALLOC_ID_OBJECT_PROPERTIES,slab.size);
+      prop_slab_mem.push_back(slab);
+      sl->next = slab.mem;
+      sl->num_left = num_blocks;
+   }
+
+   p = sl->next;
+   sl->next += num_props;
+   sl->num_left--;
+   return p;
+}
+
+void FreeProperties(prop_type *p,int num_props)
+{
+   if (num_props < 0 || num_props >= (int)prop_slabs.size())
+   {
+      eprintf("FreeProperties got invalid block size %i\n",num_props);
+      return;
+   }
+   prop_slabs[num_props].free_blocks.push_back(p);
+}
+
+void FreeAllProperties(void)
+{
+   for (int i = 0; i < (int)prop_slab_mem.size(); ++i)
+      FreeMemory(MALLOC_ID_OBJECT_PROPERTIES,prop_slab_mem[i].mem,prop_slab_mem[i].size);
+   prop_slab_mem.clear();
+   prop_slabs.clear();
+}
+
 int AllocateObject(int class_id)
 {
-   int old_objects;
    class_node *c;
 
    c = GetClassByID(class_id);
@@ -91,22 +144,14 @@ int AllocateObject(int class_id)
       return INVALID_OBJECT;
    }
 
-   if (num_objects == max_objects)
-   {
-      old_objects = max_objects;
-      max_objects = max_objects * 2;
-      objects = (object_node *)
-	 ResizeMemory(MALLOC_ID_OBJECT,objects,old_objects*sizeof(object_node),
-		      max_objects*sizeof(object_node));
-      lprintf("AllocateObject resized to %i objects\n",max_objects);
-   }
+   if (num_objects == objects.Capacity())
+      objects.Grow(num_objects + 1);
 
    objects[num_objects].object_id = num_objects;
    objects[num_objects].class_id = class_id;
    objects[num_objects].deleted = False;
    objects[num_objects].num_props = 1 + c->num_properties;
-   objects[num_objects].p = (prop_type *)AllocateMemory(MALLOC_ID_OBJECT_PROPERTIES,
-							sizeof(prop_type)*(1+c->num_properties));
+   objects[num_objects].p = AllocateProperties(1 + c->num_properties);
 
    return num_objects++;
 }
@@ -179,7 +224,6 @@ int CreateObject(int class_id,int num_parms,parm_node parms[])
       return INVALID_OBJECT;
    
    /* set self = prop 0 */
-   objects[new_object_id].p[0].id = 0; 
    objects[new_object_id].p[0].val.v.tag = TAG_OBJECT; 
    objects[new_object_id].p[0].val.v.data = new_object_id;
 
@@ -221,7 +265,6 @@ Bool LoadObject(int object_id,char *class_name)
    }
 
    /* set self = prop 0 */
-   objects[object_id].p[0].id = 0;
    objects[object_id].p[0].val.v.tag = TAG_OBJECT; 
    objects[object_id].p[0].val.v.data = object_id;
 
@@ -273,13 +316,6 @@ Bool SetObjectPropertyByName(int object_id,char *prop_name,val_type val)
 	      property_id,object_id,c->class_name,c->class_id);
       return False;
    }
-   
-   if (o->p[property_id].id != property_id)
-   {
-      eprintf("SetObjectPropertyByName property index/id mismatch %i %i\n",
-	      property_id,o->p[property_id].id);
-      return False;
-   }
 
    o->p[property_id].val = val;
    return True;
@@ -301,7 +337,6 @@ void SetObjectProperties(int object_id,class_node *c)
       }
       else
       {
-	 objects[object_id].p[c->prop_default[i].id].id = c->prop_default[i].id;
 	 objects[object_id].p[c->prop_default[i].id].val.int_val =
 	    c->prop_default[i].val.int_val;
       }
@@ -310,7 +345,6 @@ void SetObjectProperties(int object_id,class_node *c)
 
 void DeleteBlakodObject(int object_id)
 {
-   class_node *c;
    object_node *o;
 
    o = GetObjectByID(object_id);
@@ -320,16 +354,9 @@ void DeleteBlakodObject(int object_id)
       return;
    }
 
-   c = GetClassByID(o->class_id);
-   if (c == NULL)
-   {
-      eprintf("DeleteBlakodObject can't find class %i\n",o->class_id);
-      return;
-   }
-
    /* now remove object */
 
-   FreeMemory(MALLOC_ID_OBJECT_PROPERTIES,o->p,sizeof(prop_type)*(1+c->num_properties));
+   FreeProperties(o->p,o->num_props);
    o->deleted = True;
 }   
 
@@ -15,9 +15,12 @@
 
 #define INIT_OBJECTS 1000000
 
+/* property blocks are carved from slabs of about this many bytes */
+#define PROP_SLAB_BYTES (64*1024)
+
+/* property i of an object is p[i]; the index is the property id */
 typedef struct
 {
-   int id;
    val_type val;
 } prop_type;
 
@@ -31,6 +31,7 @@ client_table_node *user_table,*system_table,*usercommand_table;
 
 /* stuff for client -> server */
 val_type cli_list_nodes[MAX_CLIENT_PARMS];
+val_type cli_hangup_list; /* [BP_REQ_QUIT], for ClientHangupToBlakod() */
 
 /* local function prototypes */
 void ParseClientSendBlakod(int session_id,int msg_len,unsigned char *msg_data,int object_id,
@@ -128,6 +129,12 @@ void AllocateParseClientListNodes()
 		list_val.v.tag = TAG_LIST;
 		cli_list_nodes[i] = list_val;
 	}
+	
+	temp.v.tag = TAG_INT;
+	temp.v.data = BP_REQ_QUIT;
+	list_val.int_val = NIL;
+	cli_hangup_list.v.data = Cons(temp,list_val);
+	cli_hangup_list.v.tag = TAG_LIST;
 }
 
 void GameMessageCount(unsigned char message_type)
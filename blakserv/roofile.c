@@ -124,42 +124,31 @@ __inline bool BSPCanMoveInRoomTreeInternal(Sector* SectorS, Sector* SectorE, Sid
    return true;
 }
 
-void BSPUpdateLeafHeights(room_type* Room, Sector* Sector, bool Floor)
+// gets the 3d point of a leaf polygon vertex on the floor or ceiling of the
+// leaf's sector in this room
+__inline void GetLeafPoint(Sector* Sector, V2* P, bool Floor, V3* Out)
 {
-   for (int i = 0; i < Room->TreeNodesCount; i++)
-   {
-      BspNode* node = &Room->TreeNodes[i];
-
-      if (node->Type != BspLeafType || !node->u.leaf.Sector || node->u.leaf.Sector != Sector)
-         continue;
-
-      for (int j = 0; j < node->u.leaf.PointsCount; j++)
-      {
-         V2 p = { node->u.leaf.PointsFloor[j].X, node->u.leaf.PointsFloor[j].Y };
-
-         if (Floor)
-            node->u.leaf.PointsFloor[j].Z = SECTORHEIGHTFLOOR(node->u.leaf.Sector, &p);
-
-         else
-            node->u.leaf.PointsCeiling[j].Z = SECTORHEIGHTCEILING(node->u.leaf.Sector, &p);
-      }
-   }
+   Out->X = P->X;
+   Out->Y = P->Y;
+   Out->Z = Floor ? SECTORHEIGHTFLOOR(Sector, P) : SECTORHEIGHTCEILING(Sector, P);
 }
 
-bool BSPGetHeightTree(BspNode* Node, V2* P, float* HeightF, float* HeightFWD, float* HeightC, BspLeaf** Leaf)
+bool BSPGetHeightTree(room_type* Room, BspNode* Node, V2* P, float* HeightF, float* HeightFWD, float* HeightC, BspLeaf** Leaf)
 {
    // note: we don't check for other nullptrs here because caller is doing it and we're recursive..
    if (!Node)
       return false;
 
    // reached a leaf
-   if (Node->Type == BspLeafType && Node->u.leaf.Sector)
+   if (Node->Type == BspLeafType && Node->u.leaf.SectorNum)
    {
+      Sector* sector = ROOMSECTOR(Room, Node->u.leaf.SectorNum);
+
       // set output params
       *Leaf = &Node->u.leaf;
-      *HeightF = SECTORHEIGHTFLOOR(Node->u.leaf.Sector, P);
-      *HeightFWD = GetSectorHeightFloorWithDepth(Node->u.leaf.Sector, P);
-      *HeightC = SECTORHEIGHTCEILING(Node->u.leaf.Sector, P);
+      *HeightF = SECTORHEIGHTFLOOR(sector, P);
+      *HeightFWD = GetSectorHeightFloorWithDepth(sector, P);
+      *HeightC = SECTORHEIGHTCEILING(sector, P);
       return true;
    }
 
@@ -167,14 +156,14 @@ bool BSPGetHeightTree(BspNode* Node, V2* P, float* HeightF, float* HeightFWD, fl
    else if (Node->Type == BspInternalType)
    {
       return (DISTANCETOSPLITTERSIGNED(&Node->u.internal, P) >= 0.0f) ?
-         BSPGetHeightTree(Node->u.internal.RightChild, P, HeightF, HeightFWD, HeightC, Leaf) :
-         BSPGetHeightTree(Node->u.internal.LeftChild, P, HeightF, HeightFWD, HeightC, Leaf);
+         BSPGetHeightTree(Room, Node->u.internal.RightChild, P, HeightF, HeightFWD, HeightC, Leaf) :
+         BSPGetHeightTree(Room, Node->u.internal.LeftChild, P, HeightF, HeightFWD, HeightC, Leaf);
    }
 
    return false;
 }
 
-bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
+bool BSPLineOfSightTree(room_type* Room, BspNode* Node, V3* S, V3* E)
 {
    if (!Node)
       return true;
@@ -185,21 +174,25 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
    if (Node->Type == BspLeafType)
    {
       // no collisions with leafs without sectors
-      if (!Node->u.leaf.Sector)
+      if (!Node->u.leaf.SectorNum)
          return true;
 
+      Sector* sector = ROOMSECTOR(Room, Node->u.leaf.SectorNum);
+      V3 p0, p1, p2;
+
       // floors and ceilings don't have backsides.
       // therefore a floor can only collide if
       // the start height is bigger than end height
       // and for ceiling the other way round.
-      if (S->Z > E->Z && Node->u.leaf.Sector->FloorTexture > 0)
+      if (S->Z > E->Z && sector->FloorTexture > 0)
       {
+         GetLeafPoint(sector, &Node->u.leaf.Points[0], true, &p0);
          for (int i = 0; i < Node->u.leaf.PointsCount - 2; i++)
          {
-            bool blocked = IntersectLineTriangle(
-               &Node->u.leaf.PointsFloor[i + 2],
-               &Node->u.leaf.PointsFloor[i + 1],
-               &Node->u.leaf.PointsFloor[0], S, E);
+            GetLeafPoint(sector, &Node->u.leaf.Points[i + 1], true, &p1);
+            GetLeafPoint(sector, &Node->u.leaf.Points[i + 2], true, &p2);
+
+            bool blocked = IntersectLineTriangle(&p2, &p1, &p0, S, E);
 
             // blocked by floor
             if (blocked)
@@ -213,14 +206,15 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
       }
 
       // check ceiling collision
-      else if (S->Z < E->Z && Node->u.leaf.Sector->CeilingTexture > 0)
+      else if (S->Z < E->Z && sector->CeilingTexture > 0)
       {
+         GetLeafPoint(sector, &Node->u.leaf.Points[0], false, &p0);
          for (int i = 0; i < Node->u.leaf.PointsCount - 2; i++)
          {
-            bool blocked = IntersectLineTriangle(
-               &Node->u.leaf.PointsCeiling[i + 2],
-               &Node->u.leaf.PointsCeiling[i + 1],
-               &Node->u.leaf.PointsCeiling[0], S, E);
+            GetLeafPoint(sector, &Node->u.leaf.Points[i + 1], false, &p1);
+            GetLeafPoint(sector, &Node->u.leaf.Points[i + 2], false, &p2);
+
+            bool blocked = IntersectLineTriangle(&p2, &p1, &p0, S, E);
 
             // blocked by ceiling
             if (blocked)
@@ -252,12 +246,12 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
    // both endpoints on positive (right) side
    // --> climb down only right subtree
    if (distS > EPSILON && distE > EPSILON)
-      return BSPLineOfSightTree(Node->u.internal.RightChild, S, E);
+      return BSPLineOfSightTree(Room, Node->u.internal.RightChild, S, E);
 
    // both endpoints on negative (left) side
    // --> climb down only left subtree
    else if (distS < -EPSILON && distE < -EPSILON)
-      return BSPLineOfSightTree(Node->u.internal.LeftChild, S, E);
+      return BSPLineOfSightTree(Room, Node->u.internal.LeftChild, S, E);
 
    // endpoints are on different sides or one/both on infinite line
    // --> check walls of splitter first and then possibly climb down both
@@ -300,16 +294,20 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
                   continue;
                }
 
+               Sector* rightSector = ROOMSECTOR(Room, wall->RightSectorNum);
+               Sector* leftSector = ROOMSECTOR(Room, wall->LeftSectorNum);
+
                // must have at least a sector on one side of the wall
                // otherwise skip this wall
-               if (!wall->RightSector && !wall->LeftSector)
+               if (!rightSector && !leftSector)
                {
                   wall = wall->NextWallInPlane;
                   continue;
                }
 
                // pick side ray is coming from
-               Side* side = (distS > 0.0f) ? wall->RightSide : wall->LeftSide;
+               Side* side = (distS > 0.0f) ?
+                  ROOMSIDE(Room, wall->RightSideNum) : ROOMSIDE(Room, wall->LeftSideNum);
 
                // no collision with unset sides
                if (!side)
@@ -333,21 +331,21 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
                float rayheight = S->Z + lambda * se.Z;
 
                // get heights of right and left floor/ceiling
-               float hFloorRight = (wall->RightSector) ?
-                  SECTORHEIGHTFLOOR(wall->RightSector, &q) :
-                  SECTORHEIGHTFLOOR(wall->LeftSector, &q);
+               float hFloorRight = (rightSector) ?
+                  SECTORHEIGHTFLOOR(rightSector, &q) :
+                  SECTORHEIGHTFLOOR(leftSector, &q);
 
-               float hFloorLeft = (wall->LeftSector) ?
-                  SECTORHEIGHTFLOOR(wall->LeftSector, &q) :
-                  SECTORHEIGHTFLOOR(wall->RightSector, &q);
+               float hFloorLeft = (leftSector) ?
+                  SECTORHEIGHTFLOOR(leftSector, &q) :
+                  SECTORHEIGHTFLOOR(rightSector, &q);
 
-               float hCeilingRight = (wall->RightSector) ?
-                  SECTORHEIGHTCEILING(wall->RightSector, &q) :
-                  SECTORHEIGHTCEILING(wall->LeftSector, &q);
+               float hCeilingRight = (rightSector) ?
+                  SECTORHEIGHTCEILING(rightSector, &q) :
+                  SECTORHEIGHTCEILING(leftSector, &q);
 
-               float hCeilingLeft = (wall->LeftSector) ?
-                  SECTORHEIGHTCEILING(wall->LeftSector, &q) :
-                  SECTORHEIGHTCEILING(wall->RightSector, &q);
+               float hCeilingLeft = (leftSector) ?
+                  SECTORHEIGHTCEILING(leftSector, &q) :
+                  SECTORHEIGHTCEILING(rightSector, &q);
 
                // build all 4 possible heights (h0 lowest)
                float h3 = fmax(hCeilingRight, hCeilingLeft);
@@ -408,18 +406,18 @@ bool BSPLineOfSightTree(BspNode* Node, V3* S, V3* E)
       /****************************************************************/
 
       // try right subtree first
-      bool retval = BSPLineOfSightTree(Node->u.internal.RightChild, S, E);
+      bool retval = BSPLineOfSightTree(Room, Node->u.internal.RightChild, S, E);
 
       // found a collision there? return it
       if (!retval)
          return retval;
 
       // otherwise try left subtree
-      return BSPLineOfSightTree(Node->u.internal.LeftChild, S, E);
+      return BSPLineOfSightTree(Room, Node->u.internal.LeftChild, S, E);
    }
 }
 
-bool BSPCanMoveInRoomTree(BspNode* Node, V2* S, V2* E, Wall** BlockWall)
+bool BSPCanMoveInRoomTree(room_type* Room, BspNode* Node, V2* S, V2* E, Wall** BlockWall)
 {
    // reached a leaf or nullchild, movements not blocked by leafs
    if (!Node || Node->Type != BspInternalType)
@@ -436,12 +434,12 @@ bool BSPCanMoveInRoomTree(BspNode* Node, V2* S, V2* E, Wall** BlockWall)
    // both endpoints far away enough on positive (right) side
    // --> climb down only right subtree
    if (distS > WALLMINDISTANCE && distE > WALLMINDISTANCE)
-      return BSPCanMoveInRoomTree(Node->u.internal.RightChild, S, E, BlockWall);
+      return BSPCanMoveInRoomTree(Room, Node->u.internal.RightChild, S, E, BlockWall);
 
    // both endpoints far away enough on negative (left) side
    // --> climb down only left subtree
    else if (distS < -WALLMINDISTANCE && distE < -WALLMINDISTANCE)
-      return BSPCanMoveInRoomTree(Node->u.internal.LeftChild, S, E, BlockWall);
+      return BSPCanMoveInRoomTree(Room, Node->u.internal.LeftChild, S, E, BlockWall);
 
    // endpoints are on different sides, or one/both on infinite line or potentially too close
    // --> check walls of splitter first and then possibly climb down both subtrees
@@ -499,24 +497,24 @@ bool BSPCanMoveInRoomTree(BspNode* Node, V2* S, V2* E, Wall** BlockWall)
                   // set from and to sector / side
                   if (distS > 0.0f)
                   {
-                     sideS = wall->RightSide;
-                     sectorS = wall->RightSector;
+                     sideS = ROOMSIDE(Room, wall->RightSideNum);
+                     sectorS = ROOMSECTOR(Room, wall->RightSectorNum);
                   }
                   else
                   {
-                     sideS = wall->LeftSide;
-                     sectorS = wall->LeftSector;
+                     sideS = ROOMSIDE(Room, wall->LeftSideNum);
+                     sectorS = ROOMSECTOR(Room, wall->LeftSectorNum);
                   }
 
                   if (distE > 0.0f)
                   {
-                     sideE = wall->RightSide;
-                     sectorE = wall->RightSector;
+                     sideE = ROOMSIDE(Room, wall->RightSideNum);
+                     sectorE = ROOMSECTOR(Room, wall->RightSectorNum);
                   }
                   else
                   {
-                     sideE = wall->LeftSide;
-                     sectorE = wall->LeftSector;
+                     sideE = ROOMSIDE(Room, wall->LeftSideNum);
+                     sectorE = ROOMSECTOR(Room, wall->LeftSectorNum);
                   }
 
                   // check the transition data for this wall
@@ -561,17 +559,17 @@ bool BSPCanMoveInRoomTree(BspNode* Node, V2* S, V2* E, Wall** BlockWall)
                // and (E) is assumed to be on the other side.
                if (distS >= 0.0f)
                {
-                  sideS = wall->RightSide;
-                  sectorS = wall->RightSector;
-                  sideE = wall->LeftSide;
-                  sectorE = wall->LeftSector;
+                  sideS = ROOMSIDE(Room, wall->RightSideNum);
+                  sectorS = ROOMSECTOR(Room, wall->RightSectorNum);
+                  sideE = ROOMSIDE(Room, wall->LeftSideNum);
+                  sectorE = ROOMSECTOR(Room, wall->LeftSectorNum);
                }
                else
                {
-                  sideS = wall->LeftSide;
-                  sectorS = wall->LeftSector;
-                  sideE = wall->RightSide;
-                  sectorE = wall->RightSector;
+                  sideS = ROOMSIDE(Room, wall->LeftSideNum);
+                  sectorS = ROOMSECTOR(Room, wall->LeftSectorNum);
+                  sideE = ROOMSIDE(Room, wall->RightSideNum);
+                  sectorE = ROOMSECTOR(Room, wall->RightSectorNum);
                }
 
                // check the transition data for this wall
@@ -588,15 +586,478 @@ bool BSPCanMoveInRoomTree(BspNode* Node, V2* S, V2* E, Wall** BlockWall)
       /****************************************************************/
 
       // try right subtree first
-      bool retval = BSPCanMoveInRoomTree(Node->u.internal.RightChild, S, E, BlockWall);
+      bool retval = BSPCanMoveInRoomTree(Room, Node->u.internal.RightChild, S, E, BlockWall);
 
       // found a collision there? return it
       if (!retval)
          return retval;
 
       // otherwise try left subtree
-      return BSPCanMoveInRoomTree(Node->u.internal.LeftChild, S, E, BlockWall);
+      return BSPCanMoveInRoomTree(Room, Node->u.internal.LeftChild, S, E, BlockWall);
+   }
+}
+
+/*********************************************************************************************/
+/* Blockers are kept in a uniform grid over the thingsbox, each in the cell its position     */
+/* is in (positions outside go to the nearest border cell), so checks only look at the       */
+/* cells around what they check. They're also hashed by object id for BSPBlockerMove and     */
+/* BSPBlockerRemove.                                                                         */
+/*********************************************************************************************/
+__inline int BSPBlockerCellCoord(float Value, int Count)
+{
+   if (Value <= 0.0f)
+      return 0;
+
+   float cell = Value / BLOCKERCELLSIZE;
+   if (cell >= (float)(Count - 1))
+      return Count - 1;
+
+   return (int)cell;
+}
+
+__inline int BSPBlockerCell(room_type* Room, V2* P)
+{
+   return BSPBlockerCellCoord(P->Y, Room->BlockerCellsRows) * Room->BlockerCellsCols +
+      BSPBlockerCellCoord(P->X, Room->BlockerCellsCols);
+}
+
+__inline unsigned int BSPBlockerIdBucket(room_type* Room, int ObjectID)
+{
+   return (unsigned int)ObjectID & (unsigned int)(Room->BlockerIdsSize - 1);
+}
+
+void BSPBlockerLinkCell(room_type* Room, Blocker* B)
+{
+   B->Cell = BSPBlockerCell(Room, &B->Position);
+   B->PrevInCell = NULL;
+   B->NextInCell = Room->BlockerCells[B->Cell];
+   if (B->NextInCell)
+      B->NextInCell->PrevInCell = B;
+   Room->BlockerCells[B->Cell] = B;
+}
+
+void BSPBlockerUnlinkCell(room_type* Room, Blocker* B)
+{
+   if (B->PrevInCell)
+      B->PrevInCell->NextInCell = B->NextInCell;
+   else
+      Room->BlockerCells[B->Cell] = B->NextInCell;
+
+   if (B->NextInCell)
+      B->NextInCell->PrevInCell = B->PrevInCell;
+}
+
+void BSPBlockerUnhashID(room_type* Room, Blocker* B)
+{
+   Blocker** link = &Room->BlockerIds[BSPBlockerIdBucket(Room, B->ObjectID)];
+   while (*link && *link != B)
+      link = &(*link)->NextById;
+
+   if (*link)
+      *link = B->NextById;
+}
+
+// rebuilds the id hash with Size buckets (a power of 2)
+void BSPBlockerResizeIDs(room_type* Room, int Size)
+{
+   FreeMemory(MALLOC_ID_ROOM, Room->BlockerIds, Room->BlockerIdsSize * sizeof(Blocker*));
+   Room->BlockerIdsSize = Size;
+   Room->BlockerIds = (Blocker**)AllocateMemoryCalloc(MALLOC_ID_ROOM, Size, sizeof(Blocker*));
+
+   // insert oldest first, so like in the list the newest blocker
+   // of an object is found first
+   Blocker* last = Room->Blocker;
+   while (last && last->Next)
+      last = last->Next;
+
+   for (Blocker* b = last; b; b = b->Prev)
+   {
+      unsigned int bucket = BSPBlockerIdBucket(Room, b->ObjectID);
+      b->NextById = Room->BlockerIds[bucket];
+      Room->BlockerIds[bucket] = b;
+   }
+}
+
+Blocker* BSPBlockerFind(room_type* Room, int ObjectID)
+{
+   if (!Room->BlockerIds)
+      return NULL;
+
+   Blocker* blocker = Room->BlockerIds[BSPBlockerIdBucket(Room, ObjectID)];
+   while (blocker && blocker->ObjectID != ObjectID)
+      blocker = blocker->NextById;
+
+   return blocker;
+}
+
+// true if P is closer than OBJMINDISTANCE to any blocker
+bool BSPBlockerIsNear(room_type* Room, V2* P)
+{
+   if (!Room->BlockerCells)
+      return false;
+
+   int col0 = BSPBlockerCellCoord(P->X - OBJMINDISTANCE, Room->BlockerCellsCols);
+   int col1 = BSPBlockerCellCoord(P->X + OBJMINDISTANCE, Room->BlockerCellsCols);
+   int row0 = BSPBlockerCellCoord(P->Y - OBJMINDISTANCE, Room->BlockerCellsRows);
+   int row1 = BSPBlockerCellCoord(P->Y + OBJMINDISTANCE, Room->BlockerCellsRows);
+
+   for (int row = row0; row <= row1; row++)
+   {
+      for (int col = col0; col <= col1; col++)
+      {
+         Blocker* blocker = Room->BlockerCells[row * Room->BlockerCellsCols + col];
+         while (blocker)
+         {
+            V2 b;
+            V2SUB(&b, P, &blocker->Position);
+
+            // too close
+            if (V2LEN2(&b) < OBJMINDISTANCE2)
+               return true;
+
+            blocker = blocker->NextInCell;
+         }
+      }
+   }
+
+   return false;
+}
+/*********************************************************************************************/
+/* Navigation graph: the leafs with a sector are its nodes, the portals where they touch     */
+/* its edges. Whether a portal can be crossed depends on the room's sector heights and       */
+/* textures, so that's checked when searching, like a move from NAVCROSS before the portal   */
+/* to NAVCROSS after it, which is also the waypoint of the portal.                           */
+/*********************************************************************************************/
+BspNode* BSPFindLeaf(BspNode* Root, V2* P)
+{
+   BspNode* node = Root;
+
+   while (node && node->Type == BspInternalType)
+      node = (DISTANCETOSPLITTERSIGNED(&node->u.internal, P) >= 0.0f) ?
+         node->u.internal.RightChild : node->u.internal.LeftChild;
+
+   return (node && node->Type == BspLeafType && node->u.leaf.SectorNum) ? node : NULL;
+}
+
+void BSPBuildNavGraph(RooGeometry* Geometry)
+{
+   // leaf sharing a part of the current edge, and which part (0..1)
+   typedef struct NavNeighbour
+   {
+      int Leaf;
+      float T0;
+      float T1;
+   } NavNeighbour;
+
+   NavNeighbour neighbours[16];
+   int capacity = 256;
+
+   Geometry->NavPortalsCount = 0;
+   Geometry->NavPortals = (NavPortal*)AllocateMemory(MALLOC_ID_ROOM, capacity * sizeof(NavPortal));
+   Geometry->NavFirstPortal = (int*)AllocateMemory(MALLOC_ID_ROOM,
+      (Geometry->TreeNodesCount + 1) * sizeof(int));
+
+   for (int i = 0; i < Geometry->TreeNodesCount; i++)
+   {
+      BspNode* node = &Geometry->TreeNodes[i];
+      Geometry->NavFirstPortal[i] = Geometry->NavPortalsCount;
+
+      if (node->Type != BspLeafType || !node->u.leaf.SectorNum || node->u.leaf.PointsCount < 3)
+         continue;
+
+      BspLeaf* leaf = &node->u.leaf;
+
+      // edges' normals point away from the center
+      V2 center = { 0.0f, 0.0f };
+      for (int k = 0; k < leaf->PointsCount; k++)
+      {
+         V2ADD(&center, &center, &leaf->Points[k]);
+      }
+      V2SCALE(&center, 1.0f / (float)leaf->PointsCount);
+
+      for (int k = 0; k < leaf->PointsCount; k++)
+      {
+         V2* p1 = &leaf->Points[k];
+         V2* p2 = &leaf->Points[(k + 1) % leaf->PointsCount];
+         V2 d, n, m;
+
+         V2SUB(&d, p2, p1);
+         float len = V2LEN(&d);
+         if (len < 1.0f)
+            continue;
+         V2SCALE(&d, 1.0f / len);
+
+         n.X = -d.Y;
+         n.Y = d.X;
+         V2SUB(&m, p1, &center);
+         if (V2DOT(&n, &m) < 0.0f)
+         {
+            V2SCALE(&n, -1.0f);
+         }
+
+         // probe along the edge just outside of it for the leafs there
+         int probes = (int)(len / NAVPROBESTEP) + 1;
+         int count = 0;
+         for (int j = 0; j < probes; j++)
+         {
+            float t = ((float)j + 0.5f) / (float)probes;
+            V2 q;
+            q.X = p1->X + d.X * t * len + n.X * NAVPROBE;
+            q.Y = p1->Y + d.Y * t * len + n.Y * NAVPROBE;
+
+            BspNode* other = BSPFindLeaf(&Geometry->TreeNodes[0], &q);
+            if (!other || other == node)
+               continue;
+
+            int o = (int)(other - Geometry->TreeNodes);
+            int c = 0;
+            while (c < count && neighbours[c].Leaf != o)
+               c++;
+
+            if (c == count)
+            {
+               if (count == 16)
+                  continue;
+               neighbours[c].Leaf = o;
+               neighbours[c].T0 = t;
+               count++;
+            }
+            neighbours[c].T1 = t;
+         }
+
+         for (int c = 0; c < count; c++)
+         {
+            if (Geometry->NavPortalsCount == capacity)
+            {
+               NavPortal* portals = (NavPortal*)AllocateMemory(MALLOC_ID_ROOM,
+                  capacity * 2 * sizeof(NavPortal));
+               memcpy(portals, Geometry->NavPortals, capacity * sizeof(NavPortal));
+               FreeMemory(MALLOC_ID_ROOM, Geometry->NavPortals, capacity * sizeof(NavPortal));
+               Geometry->NavPortals = portals;
+               capacity *= 2;
+            }
+
+            NavPortal* portal = &Geometry->NavPortals[Geometry->NavPortalsCount++];
+            float t = 0.5f * (neighbours[c].T0 + neighbours[c].T1);
+            portal->Leaf = (unsigned short)neighbours[c].Leaf;
+            portal->P.X = p1->X + d.X * t * len;
+            portal->P.Y = p1->Y + d.Y * t * len;
+            portal->N = n;
+         }
+      }
    }
+   Geometry->NavFirstPortal[Geometry->TreeNodesCount] = Geometry->NavPortalsCount;
+
+   // shrink to fit
+   NavPortal* portals = (NavPortal*)AllocateMemory(MALLOC_ID_ROOM,
+      (Geometry->NavPortalsCount + 1) * sizeof(NavPortal));
+   memcpy(portals, Geometry->NavPortals, Geometry->NavPortalsCount * sizeof(NavPortal));
+   FreeMemory(MALLOC_ID_ROOM, Geometry->NavPortals, capacity * sizeof(NavPortal));
+   Geometry->NavPortals = portals;
+}
+
+// Before is NAVCROSS before the portal, otherwise NAVCROSS after it
+__inline void BSPNavWaypoint(NavPortal* Portal, bool Before, V2* P)
+{
+   float cross = Before ? -NAVCROSS : NAVCROSS;
+   P->X = Portal->P.X + Portal->N.X * cross;
+   P->Y = Portal->P.Y + Portal->N.Y * cross;
+}
+
+__inline bool BSPNavCanCross(room_type* Room, NavPortal* Portal)
+{
+   V2 s, e;
+   Wall* blockWall = NULL;
+
+   BSPNavWaypoint(Portal, true, &s);
+   BSPNavWaypoint(Portal, false, &e);
+
+   return BSPCanMoveInRoomTree(Room, &Room->TreeNodes[0], &s, &e, &blockWall);
+}
+
+// Waypoint Num of the path of Entry: before, after each portal, then E
+__inline void BSPNavPathWaypoint(room_type* Room, NavCacheEntry* Entry, V2* E, int Num, V2* P)
+{
+   if (Num < 2 * Entry->PortalsCount)
+      BSPNavWaypoint(&Room->Geometry->NavPortals[Entry->Portals[Num / 2]], (Num % 2) == 0, P);
+   else
+      *P = *E;
+}
+
+// A* search state, kept between searches and grown to the biggest room searched.
+// A node is in the search if its Stamp is the current search's.
+typedef struct NavHeapEntry
+{
+   float F;
+   int   Node;
+} NavHeapEntry;
+
+static struct
+{
+   int           NodesSize;
+   int*          Stamp;
+   bool*         Closed;
+   float*        G;
+   V2*           Pos;
+   int*          Via;          // portal the node was reached by, -1 for start
+   int*          Parent;
+   int           HeapSize;
+   int           HeapCount;
+   NavHeapEntry* Heap;
+   int           CurrentStamp;
+} nav;
+
+void BSPNavReserve(int Nodes, int Portals)
+{
+   if (Nodes > nav.NodesSize)
+   {
+      if (nav.NodesSize)
+      {
+         FreeMemory(MALLOC_ID_ROOM, nav.Stamp, nav.NodesSize * sizeof(int));
+         FreeMemory(MALLOC_ID_ROOM, nav.Closed, nav.NodesSize * sizeof(bool));
+         FreeMemory(MALLOC_ID_ROOM, nav.G, nav.NodesSize * sizeof(float));
+         FreeMemory(MALLOC_ID_ROOM, nav.Pos, nav.NodesSize * sizeof(V2));
+         FreeMemory(MALLOC_ID_ROOM, nav.Via, nav.NodesSize * sizeof(int));
+         FreeMemory(MALLOC_ID_ROOM, nav.Parent, nav.NodesSize * sizeof(int));
+      }
+      nav.NodesSize = Nodes;
+      nav.Stamp = (int*)AllocateMemoryCalloc(MALLOC_ID_ROOM, Nodes, sizeof(int));
+      nav.Closed = (bool*)AllocateMemory(MALLOC_ID_ROOM, Nodes * sizeof(bool));
+      nav.G = (float*)AllocateMemory(MALLOC_ID_ROOM, Nodes * sizeof(float));
+      nav.Pos = (V2*)AllocateMemory(MALLOC_ID_ROOM, Nodes * sizeof(V2));
+      nav.Via = (int*)AllocateMemory(MALLOC_ID_ROOM, Nodes * sizeof(int));
+      nav.Parent = (int*)AllocateMemory(MALLOC_ID_ROOM, Nodes * sizeof(int));
+      nav.CurrentStamp = 0;
+   }
+
+   // each portal is pushed at most once, plus the start
+   if (Portals + 1 > nav.HeapSize)
+   {
+      if (nav.HeapSize)
+         FreeMemory(MALLOC_ID_ROOM, nav.Heap, nav.HeapSize * sizeof(NavHeapEntry));
+      nav.HeapSize = Portals + 1;
+      nav.Heap = (NavHeapEntry*)AllocateMemory(MALLOC_ID_ROOM, nav.HeapSize * sizeof(NavHeapEntry));
+   }
+}
+
+void BSPNavHeapPush(float F, int Node)
+{
+   int i = nav.HeapCount++;
+   while (i > 0)
+   {
+      int parent = (i - 1) / 2;
+      if (nav.Heap[parent].F <= F)
+         break;
+      nav.Heap[i] = nav.Heap[parent];
+      i = parent;
+   }
+   nav.Heap[i].F = F;
+   nav.Heap[i].Node = Node;
+}
+
+int BSPNavHeapPop()
+{
+   int node = nav.Heap[0].Node;
+   NavHeapEntry last = nav.Heap[--nav.HeapCount];
+   int i = 0;
+
+   while (true)
+   {
+      int child = 2 * i + 1;
+      if (child >= nav.HeapCount)
+         break;
+      if (child + 1 < nav.HeapCount && nav.Heap[child + 1].F < nav.Heap[child].F)
+         child++;
+      if (last.F <= nav.Heap[child].F)
+         break;
+      nav.Heap[i] = nav.Heap[child];
+      i = child;
+   }
+   if (nav.HeapCount > 0)
+      nav.Heap[i] = last;
+
+   return node;
+}
+
+// A* from leaf node From (at S) to leaf node To (at E). On success sets
+// Entry->Portals to the portals crossed.
+bool BSPNavSearch(room_type* Room, int From, int To, V2* S, V2* E, NavCacheEntry* Entry)
+{
+   RooGeometry* geometry = Room->Geometry;
+   V2 d;
+
+   BSPNavReserve(Room->TreeNodesCount, geometry->NavPortalsCount);
+
+   // stamps wrapped, forget all
+   if (++nav.CurrentStamp <= 0)
+   {
+      memset(nav.Stamp, 0, nav.NodesSize * sizeof(int));
+      nav.CurrentStamp = 1;
+   }
+
+   nav.HeapCount = 0;
+   nav.Stamp[From] = nav.CurrentStamp;
+   nav.Closed[From] = false;
+   nav.G[From] = 0.0f;
+   nav.Pos[From] = *S;
+   nav.Via[From] = -1;
+   nav.Parent[From] = -1;
+   V2SUB(&d, E, S);
+   BSPNavHeapPush(V2LEN(&d), From);
+
+   while (nav.HeapCount > 0)
+   {
+      int node = BSPNavHeapPop();
+      if (nav.Closed[node])
+         continue;
+      nav.Closed[node] = true;
+
+      if (node == To)
+      {
+         int count = 0;
+         for (int n = node; nav.Via[n] >= 0; n = nav.Parent[n])
+            count++;
+
+         Entry->PortalsCount = count;
+         Entry->Portals = (int*)AllocateMemory(MALLOC_ID_ROOM, (count + 1) * sizeof(int));
+         for (int n = node; nav.Via[n] >= 0; n = nav.Parent[n])
+            Entry->Portals[--count] = nav.Via[n];
+
+         return true;
+      }
+
+      for (int p = geometry->NavFirstPortal[node]; p < geometry->NavFirstPortal[node + 1]; p++)
+      {
+         NavPortal* portal = &geometry->NavPortals[p];
+         int next = portal->Leaf;
+
+         if (nav.Stamp[next] == nav.CurrentStamp && nav.Closed[next])
+            continue;
+
+         V2 w;
+         BSPNavWaypoint(portal, false, &w);
+         V2SUB(&d, &w, &nav.Pos[node]);
+         float g = nav.G[node] + V2LEN(&d);
+
+         if (nav.Stamp[next] == nav.CurrentStamp && nav.G[next] <= g)
+            continue;
+
+         // the expensive part last
+         if (!BSPNavCanCross(Room, portal))
+            continue;
+
+         nav.Stamp[next] = nav.CurrentStamp;
+         nav.Closed[next] = false;
+         nav.G[next] = g;
+         nav.Pos[next] = w;
+         nav.Via[next] = p;
+         nav.Parent[next] = node;
+         V2SUB(&d, E, &w);
+         BSPNavHeapPush(g + V2LEN(&d), next);
+      }
+   }
+
+   return false;
 }
 #pragma endregion
 
@@ -616,7 +1077,7 @@ bool BSPGetHeight(room_type* Room, V2* P, float* HeightF, float* HeightFWD, floa
    if (!Room || Room->TreeNodesCount == 0 || !P || !HeightF || !HeightFWD || !HeightC)
       return false;
 
-   return BSPGetHeightTree(&Room->TreeNodes[0], P, HeightF, HeightFWD, HeightC, Leaf);
+   return BSPGetHeightTree(Room, &Room->TreeNodes[0], P, HeightF, HeightFWD, HeightC, Leaf);
 }
 
 /*********************************************************************************************/
@@ -674,7 +1135,7 @@ bool BSPLineOfSight(room_type* Room, V3* S, V3* E)
       return false;
 
    // test center
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, E))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, E))
       return true;
 
    V3 e;
@@ -683,35 +1144,35 @@ bool BSPLineOfSight(room_type* Room, V3* S, V3* E)
    e.X = E->X;
    e.Y = E->Y;
    e.Z = E->Z - OBJECTHEIGHTROO + 1;
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, &e))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, &e))
       return true;
 
    // test p
    e.X = E->X + LOSEXTEND;
    e.Y = E->Y + LOSEXTEND;
    e.Z = E->Z;
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, &e))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, &e))
       return true;
 
    // test p
    e.X = E->X - LOSEXTEND;
    e.Y = E->Y - LOSEXTEND;
    e.Z = E->Z;
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, &e))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, &e))
       return true;
 
    // test p
    e.X = E->X + LOSEXTEND;
    e.Y = E->Y - LOSEXTEND;
    e.Z = E->Z;
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, &e))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, &e))
       return true;
 
    // test p
    e.X = E->X - LOSEXTEND;
    e.Y = E->Y + LOSEXTEND;
    e.Z = E->Z;
-   if (BSPLineOfSightTree(&Room->TreeNodes[0], S, &e))
+   if (BSPLineOfSightTree(Room, &Room->TreeNodes[0], S, &e))
       return true;
 
    return false;
@@ -735,54 +1196,70 @@ bool BSPCanMoveInRoom(room_type* Room, V2* S, V2* E, int ObjectID, bool moveOuts
    }
 
    // first check against room geometry
-   bool roomok = (moveOutsideBSP || BSPCanMoveInRoomTree(&Room->TreeNodes[0], S, E, BlockWall));
+   bool roomok = (moveOutsideBSP || BSPCanMoveInRoomTree(Room, &Room->TreeNodes[0], S, E, BlockWall));
 
    // already found a collision in room
    if (!roomok)
       return false;
 
    // otherwise also check against blockers
-   Blocker* blocker = Room->Blocker;
-   while (blocker)
+   if (!Room->BlockerCells)
+      return true;
+
+   // only blockers within OBJMINDISTANCE of the move can block it,
+   // so only look in the cells overlapping its box grown by that much
+   int col0 = BSPBlockerCellCoord(fmin(S->X, E->X) - OBJMINDISTANCE, Room->BlockerCellsCols);
+   int col1 = BSPBlockerCellCoord(fmax(S->X, E->X) + OBJMINDISTANCE, Room->BlockerCellsCols);
+   int row0 = BSPBlockerCellCoord(fmin(S->Y, E->Y) - OBJMINDISTANCE, Room->BlockerCellsRows);
+   int row1 = BSPBlockerCellCoord(fmax(S->Y, E->Y) + OBJMINDISTANCE, Room->BlockerCellsRows);
+
+   for (int row = row0; row <= row1; row++)
    {
-      // don't block ourself
-      if (blocker->ObjectID == ObjectID)
+      for (int col = col0; col <= col1; col++)
       {
-         blocker = blocker->Next;
-         continue;
-      }
+         Blocker* blocker = Room->BlockerCells[row * Room->BlockerCellsCols + col];
+         while (blocker)
+         {
+            // don't block ourself
+            if (blocker->ObjectID == ObjectID)
+            {
+               blocker = blocker->NextInCell;
+               continue;
+            }
 
-      V2 ms; // from m to s  
-      V2SUB(&ms, S, &blocker->Position);
-      float ds2 = V2LEN2(&ms);
+            V2 ms; // from m to s  
+            V2SUB(&ms, S, &blocker->Position);
+            float ds2 = V2LEN2(&ms);
 
-      // CASE 1) Start is too close
-      // Note: IntersectLineCircle below will reject moves starting or ending exactly
-      //   on the circle as well as moves going from inside to outside of the circle.
-      //   So this case here must handle moves until the object is out of radius again.
-      if (ds2 <= OBJMINDISTANCE2)
-      {
-         V2 me;
-         V2SUB(&me, E, &blocker->Position); // from m to e
-         float de2 = V2LEN2(&me);
+            // CASE 1) Start is too close
+            // Note: IntersectLineCircle below will reject moves starting or ending exactly
+            //   on the circle as well as moves going from inside to outside of the circle.
+            //   So this case here must handle moves until the object is out of radius again.
+            if (ds2 <= OBJMINDISTANCE2)
+            {
+               V2 me;
+               V2SUB(&me, E, &blocker->Position); // from m to e
+               float de2 = V2LEN2(&me);
 
-         // end must be farer away than start
-         if (de2 <= ds2)
-            return false;
-      }
+               // end must be farer away than start
+               if (de2 <= ds2)
+                  return false;
+            }
 
-      // CASE 2) Start is outside blockradius, verify by intersection algorithm.
-      else
-      {
-         if (IntersectLineCircle(&blocker->Position, OBJMINDISTANCE, S, E))
-         {
+            // CASE 2) Start is outside blockradius, verify by intersection algorithm.
+            else
+            {
+               if (IntersectLineCircle(&blocker->Position, OBJMINDISTANCE, S, E))
+               {
 #if DEBUGMOVE
-            dprintf("MOVEBLOCK BY OBJ %i",blocker->ObjectID);
+                  dprintf("MOVEBLOCK BY OBJ %i",blocker->ObjectID);
 #endif
-            return false;
+                  return false;
+               }
+            }
+            blocker = blocker->NextInCell;
          }
       }
-      blocker = blocker->Next;
    }
 
    return true;
@@ -800,6 +1277,9 @@ void BSPChangeTexture(room_type* Room, unsigned int ServerID, unsigned short New
    bool isCeiling    = ((Flags & CTF_CEILING) == CTF_CEILING);
    bool isReset      = ((Flags & CTF_RESET) == CTF_RESET);
 
+   // lower/upper textures may block moves, paths may have changed
+   Room->NavStamp++;
+
    // change on sides
    if (isAboveWall || isNormalWall || isBelowWall)
    {
@@ -848,6 +1328,9 @@ void BSPChangeTexture(room_type* Room, unsigned int ServerID, unsigned short New
 /*********************************************************************************************/
 void BSPMoveSector(room_type* Room, unsigned int ServerID, bool Floor, float Height, float Speed)
 {
+   // paths may have changed
+   Room->NavStamp++;
+
    for (int i = 0; i < Room->SectorsCount; i++)
    {
       Sector* sector = &Room->Sectors[i];
@@ -858,17 +1341,11 @@ void BSPMoveSector(room_type* Room, unsigned int ServerID, bool Floor, float Hei
 
       // move floor
       if (Floor)
-      {
          sector->FloorHeight = Height;
-         BSPUpdateLeafHeights(Room, sector, true);
-      }
 
       // move ceiling
       else
-      {
          sector->CeilingHeight = Height;
-         BSPUpdateLeafHeights(Room, sector, false);
-      }
    }
 }
 
@@ -914,33 +1391,20 @@ bool BSPGetLocationInfo(room_type* Room, V2* P, unsigned int QueryFlags, unsigne
    }
 
    // check too close to blocker
-   if (isCheckOjectBlock)
-   {
-      Blocker* blocker = Room->Blocker;
-      while (blocker)
-      {
-         V2 b;
-         V2SUB(&b, P, &blocker->Position);
-
-         // too close
-         if (V2LEN2(&b) < OBJMINDISTANCE2)
-         {
-            *ReturnFlags |= LIR_BLOCKED_OBJECT;
-            break;
-         }
-         blocker = blocker->Next;
-      }
-   }
+   if (isCheckOjectBlock && BSPBlockerIsNear(Room, P))
+      *ReturnFlags |= LIR_BLOCKED_OBJECT;
 
    // bsp lookup
    if (isGetSectorInfo && BSPGetHeight(Room, P, HeightF, HeightFWD, HeightC, Leaf))
    {
       *ReturnFlags |= LIR_SECTOR_INSIDE;
 
-      if ((*Leaf)->Sector->FloorTexture > 0)
+      Sector* sector = ROOMSECTOR(Room, (*Leaf)->SectorNum);
+
+      if (sector->FloorTexture > 0)
          *ReturnFlags |= LIR_SECTOR_HASFTEX;
 
-      if ((*Leaf)->Sector->CeilingTexture > 0)
+      if (sector->CeilingTexture > 0)
          *ReturnFlags |= LIR_SECTOR_HASCTEX;
    }
 
@@ -978,29 +1442,11 @@ bool BSPGetRandomPoint(room_type* Room, int MaxAttempts, V2* P)
 			continue;
 		
 		// 2. must also have floor texture set
-		if (leaf && leaf->Sector->FloorTexture == 0)
+		if (leaf && ROOMSECTOR(Room, leaf->SectorNum)->FloorTexture == 0)
 			continue;
 
-		// 3. check for being too close to a blocker
-		Blocker* blocker = Room->Blocker;
-		bool collision = false;
-		while (blocker)
-		{
-			V2 b;
-			V2SUB(&b, P, &blocker->Position);
-
-			// too close
-			if (V2LEN2(&b) < OBJMINDISTANCE2)
-			{
-				collision = true;
-				break;
-			}
-
-			blocker = blocker->Next;
-		}
-
-		// too close to a blocker, roll again
-		if (collision)
+		// 3. check for being too close to a blocker, roll again if so
+		if (BSPBlockerIsNear(Room, P))
 			continue;
 
 		// all good with P
@@ -1310,6 +1756,115 @@ bool BSPGetStepTowards(room_type* Room, V2* S, V2* E, V2* P, unsigned int* Flags
    return false;
 }
 
+/*********************************************************************************************/
+/* BSPGetStepsTowards: Does BSPGetStepTowards for each of Steps in order, and moves the      */
+/*                     blocker of each object that stepped, so the ones after it see it at   */
+/*                     its new location. Objects moving outside the tree keep their blocker, */
+/*                     the caller may still refuse their step. Returns how many stepped.     */
+/*********************************************************************************************/
+int BSPGetStepsTowards(room_type* Room, BSPStep* Steps, int Count)
+{
+   if (!Room || !Steps)
+      return 0;
+
+   int moved = 0;
+   for (int i = 0; i < Count; i++)
+   {
+      BSPStep* step = &Steps[i];
+      bool moveOutsideBSP = ((step->Flags & MSTATE_MOVE_OUTSIDE_BSP) == MSTATE_MOVE_OUTSIDE_BSP);
+
+      step->Moved = BSPGetStepTowards(Room, &step->S, &step->E, &step->P, &step->Flags, step->ObjectID);
+      if (!step->Moved)
+         continue;
+
+      if (!moveOutsideBSP)
+         BSPBlockerMove(Room, step->ObjectID, &step->P);
+
+      moved++;
+   }
+
+   return moved;
+}
+
+/*********************************************************************************************/
+/* BSPGetPath:  Finds a path from S to E across the leafs of the room. Returns the waypoints */
+/*              after S in Path, E last, at most MaxPath (the first ones of longer paths).   */
+/*              Blockers are not checked. Found paths are cached by their leafs.             */
+/*********************************************************************************************/
+bool BSPGetPath(room_type* Room, V2* S, V2* E, V2* Path, int MaxPath, int* PathCount)
+{
+   if (!Room || !Room->Geometry || Room->TreeNodesCount == 0 || !S || !E || !Path || MaxPath < 1)
+      return false;
+
+   BspNode* from = BSPFindLeaf(&Room->TreeNodes[0], S);
+   BspNode* to = BSPFindLeaf(&Room->TreeNodes[0], E);
+   if (!from || !to)
+      return false;
+
+   *PathCount = 0;
+
+   // straight there
+   Wall* blockWall = NULL;
+   if (from == to || BSPCanMoveInRoomTree(Room, &Room->TreeNodes[0], S, E, &blockWall))
+   {
+      Path[(*PathCount)++] = *E;
+      return true;
+   }
+
+   int fromNum = (int)(from - Room->TreeNodes);
+   int toNum = (int)(to - Room->TreeNodes);
+
+   if (!Room->NavCache)
+      Room->NavCache = (NavCacheEntry*)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+         NAVCACHESIZE, sizeof(NavCacheEntry));
+
+   // an entry is used if it has portals or knows there's no path
+   NavCacheEntry* entry = &Room->NavCache[(fromNum * 31 + toNum) & (NAVCACHESIZE - 1)];
+   if ((!entry->Portals && entry->PortalsCount != -1) || entry->Stamp != Room->NavStamp ||
+       entry->FromLeaf != fromNum || entry->ToLeaf != toNum)
+   {
+      if (entry->Portals)
+         FreeMemory(MALLOC_ID_ROOM, entry->Portals, (entry->PortalsCount + 1) * sizeof(int));
+      entry->Portals = NULL;
+
+      entry->FromLeaf = (unsigned short)fromNum;
+      entry->ToLeaf = (unsigned short)toNum;
+      entry->Stamp = Room->NavStamp;
+      if (!BSPNavSearch(Room, fromNum, toNum, S, E, entry))
+         entry->PortalsCount = -1;
+   }
+
+   if (entry->PortalsCount < 0)
+      return false;
+
+   // waypoints are before and after each portal, then E. Skip the ones
+   // that can be reached directly from the last one kept.
+   int count = 2 * entry->PortalsCount + 1;
+   V2 last = *S;
+   int i = 0;
+   while (i < count && *PathCount < MaxPath)
+   {
+      V2 w, next;
+
+      BSPNavPathWaypoint(Room, entry, E, i, &w);
+      while (i + 1 < count)
+      {
+         BSPNavPathWaypoint(Room, entry, E, i + 1, &next);
+         if (!BSPCanMoveInRoomTree(Room, &Room->TreeNodes[0], &last, &next, &blockWall))
+            break;
+
+         w = next;
+         i++;
+      }
+
+      Path[(*PathCount)++] = w;
+      last = w;
+      i++;
+   }
+
+   return true;
+}
+
 /*********************************************************************************************/
 /* BSPBlockerClear:   Clears all registered blocked locations.                               */
 /*********************************************************************************************/
@@ -1323,6 +1878,23 @@ void BSPBlockerClear(room_type* Room)
       blocker = tmp;
    }
    Room->Blocker = NULL;
+   Room->BlockerCount = 0;
+
+   if (Room->BlockerCells)
+   {
+      memset(Room->BlockerCells, 0,
+         Room->BlockerCellsCols * Room->BlockerCellsRows * sizeof(Blocker*));
+      memset(Room->BlockerIds, 0, Room->BlockerIdsSize * sizeof(Blocker*));
+   }
+}
+
+/*********************************************************************************************/
+/* BSPBlockerRehashIDs: Call after changing the ObjectID of blockers directly.               */
+/*********************************************************************************************/
+void BSPBlockerRehashIDs(room_type* Room)
+{
+   if (Room->BlockerIds)
+      BSPBlockerResizeIDs(Room, Room->BlockerIdsSize);
 }
 
 /*********************************************************************************************/
@@ -1333,32 +1905,27 @@ bool BSPBlockerRemove(room_type* Room, int ObjectID)
    if (!Room)
       return false;
 
-   Blocker* blocker = Room->Blocker;
-   Blocker* previous = NULL;
-
-   while (blocker)
-   {
-      if (blocker->ObjectID == ObjectID)
-      {
-         // removing first element
-         if (!previous)
-            Room->Blocker = blocker->Next;
+   Blocker* blocker = BSPBlockerFind(Room, ObjectID);
+   if (!blocker)
+      return false;
 
-         // removing not first element
-         else
-            previous->Next = blocker->Next;
+   // unlink from list, grid and hash
+   if (blocker->Prev)
+      blocker->Prev->Next = blocker->Next;
+   else
+      Room->Blocker = blocker->Next;
 
-         // now cleanup node
-         FreeMemory(MALLOC_ID_ROOM, blocker, sizeof(Blocker));
+   if (blocker->Next)
+      blocker->Next->Prev = blocker->Prev;
 
-         return true;
-      }
+   BSPBlockerUnlinkCell(Room, blocker);
+   BSPBlockerUnhashID(Room, blocker);
+   Room->BlockerCount--;
 
-      previous = blocker;
-      blocker = blocker->Next;
-   }
+   // now cleanup node
+   FreeMemory(MALLOC_ID_ROOM, blocker, sizeof(Blocker));
 
-   return false;
+   return true;
 }
 
 /*********************************************************************************************/
@@ -1369,25 +1936,45 @@ bool BSPBlockerAdd(room_type* Room, int ObjectID, V2* P)
    if (!Room || !P)
       return false;
 
+   // first blocker in this room, make its grid and hash
+   if (!Room->BlockerCells)
+   {
+      Room->BlockerCellsCols = (int)(Room->ThingsBox.Max.X / BLOCKERCELLSIZE) + 1;
+      Room->BlockerCellsRows = (int)(Room->ThingsBox.Max.Y / BLOCKERCELLSIZE) + 1;
+      Room->BlockerCells = (Blocker**)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+         Room->BlockerCellsCols * Room->BlockerCellsRows, sizeof(Blocker*));
+
+      Room->BlockerIdsSize = BLOCKERIDHASHSIZE;
+      Room->BlockerIds = (Blocker**)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+         Room->BlockerIdsSize, sizeof(Blocker*));
+   }
+
    // alloc
    Blocker* newblocker = (Blocker*)AllocateMemory(MALLOC_ID_ROOM, sizeof(Blocker));
 
    // set values on new blocker
    newblocker->ObjectID = ObjectID;
    newblocker->Position = *P;
-   newblocker->Next = NULL;
 
-   // first blocker
-   if (!Room->Blocker)
-      Room->Blocker = newblocker;
+   // we insert at the beginning because it's
+   // (a) faster
+   // (b) it makes sure 'static' objects are at the end (unlikely to be touched again)
+   newblocker->Prev = NULL;
+   newblocker->Next = Room->Blocker;
+   if (Room->Blocker)
+      Room->Blocker->Prev = newblocker;
+   Room->Blocker = newblocker;
 
+   BSPBlockerLinkCell(Room, newblocker);
+
+   // the id hash doubles when there are more blockers than buckets
+   if (++Room->BlockerCount > Room->BlockerIdsSize)
+      BSPBlockerResizeIDs(Room, Room->BlockerIdsSize * 2);
    else
    {
-      // we insert at the beginning because it's
-      // (a) faster
-      // (b) it makes sure 'static' objects are at the end (unlikely to be touched again)
-      newblocker->Next = Room->Blocker;
-      Room->Blocker = newblocker;
+      unsigned int bucket = BSPBlockerIdBucket(Room, ObjectID);
+      newblocker->NextById = Room->BlockerIds[bucket];
+      Room->BlockerIds[bucket] = newblocker;
    }
 
    return true;
@@ -1401,24 +1988,26 @@ bool BSPBlockerMove(room_type* Room, int ObjectID, V2* P)
    if (!Room || !P)
       return false;
 
-   Blocker* blocker = Room->Blocker;
-   while (blocker)
+   Blocker* blocker = BSPBlockerFind(Room, ObjectID);
+   if (!blocker)
+      return false;
+
+   blocker->Position = *P;
+
+   // possibly moved into another cell
+   if (BSPBlockerCell(Room, P) != blocker->Cell)
    {
-      if (blocker->ObjectID == ObjectID)
-      {
-         blocker->Position = *P;
-         return true;
-      }
-      blocker = blocker->Next;
+      BSPBlockerUnlinkCell(Room, blocker);
+      BSPBlockerLinkCell(Room, blocker);
    }
 
-   return false;
+   return true;
 }
 
 /*********************************************************************************************/
-/* BSPRooFileLoadServer:  Fill "room" with server-relevant data from given roo file.         */
+/* BSPLoadGeometry:  Loads the server-relevant data from given roo file, NULL on failure.   */
 /*********************************************************************************************/
-bool BSPLoadRoom(char *fname, room_type *room)
+RooGeometry* BSPLoadGeometry(char *fname)
 {
    int i, j, temp;
    unsigned char byte;
@@ -1428,7 +2017,10 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
    FILE *infile = fopen(fname, "rb");
    if (infile == NULL)
-      return False;
+      return NULL;
+
+   // zeroed, so BSPFreeGeometry can clean up after a partial read
+   RooGeometry* geometry = (RooGeometry*)AllocateMemoryCalloc(MALLOC_ID_ROOM, 1, sizeof(RooGeometry));
 
    /****************************************************************************/
    /*                                HEADER                                    */
@@ -1436,23 +2028,23 @@ bool BSPLoadRoom(char *fname, room_type *room)
    
    // check signature
    if (fread(&temp, 1, 4, infile) != 4 || temp != ROO_SIGNATURE)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // check version
    if (fread(&temp, 1, 4, infile) != 4 || temp < ROO_VERSION)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read room security
-   if (fread(&room->security, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   if (fread(&geometry->security, 1, 4, infile) != 4)
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to client info
    if (fread(&offset_client, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // skip pointer to server info
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    /****************************************************************************/
    /*                               CLIENT DATA                                */
@@ -1461,114 +2053,108 @@ bool BSPLoadRoom(char *fname, room_type *room)
    
    // skip width
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // skip height
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to bsp tree
    if (fread(&offset_tree, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to walls
    if (fread(&offset_walls, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // skip offset to editor walls
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to sides
    if (fread(&offset_sides, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to sectors
    if (fread(&offset_sectors, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // read pointer to things
    if (fread(&offset_things, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    /************************ BSP-TREE ****************************************/
 
    fseek(infile, offset_tree, SEEK_SET);
 
    // read count of nodes
-   if (fread(&room->TreeNodesCount, 1, 2, infile) != 2)
-   { fclose(infile); return False; }
+   if (fread(&geometry->TreeNodesCount, 1, 2, infile) != 2)
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // allocate tree mem
-   room->TreeNodes = (BspNode*)AllocateMemory(
-      MALLOC_ID_ROOM, room->TreeNodesCount * sizeof(BspNode));
+   geometry->TreeNodes = (BspNode*)AllocateMemoryCalloc(
+      MALLOC_ID_ROOM, geometry->TreeNodesCount, sizeof(BspNode));
 
-   for (i = 0; i < room->TreeNodesCount; i++)
+   for (i = 0; i < geometry->TreeNodesCount; i++)
    {
-      BspNode* node = &room->TreeNodes[i];
+      BspNode* node = &geometry->TreeNodes[i];
 
       // type
       if (fread(&byte, 1, 1, infile) != 1)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       node->Type = (BspNodeType)byte;
 
       // boundingbox
       if (fread(&node->BoundingBox.Min.X, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&node->BoundingBox.Min.Y, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&node->BoundingBox.Max.X, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&node->BoundingBox.Max.Y, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       if (node->Type == BspInternalType)
       {
          // line equation coefficients of splitter line
          if (fread(&node->u.internal.A, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&node->u.internal.B, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&node->u.internal.C, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // nums of children
          if (fread(&node->u.internal.RightChildNum, 1, 2, infile) != 2)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&node->u.internal.LeftChildNum, 1, 2, infile) != 2)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // first wall in splitter
          if (fread(&node->u.internal.FirstWallNum, 1, 2, infile) != 2)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       }
       else if (node->Type == BspLeafType)
       {
          // sector num
          if (fread(&node->u.leaf.SectorNum, 1, 2, infile) != 2)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // points count
          if (fread(&node->u.leaf.PointsCount, 1, 2, infile) != 2)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // allocate memory for points of polygon
-         node->u.leaf.PointsFloor = (V3*)AllocateMemory(
-            MALLOC_ID_ROOM, node->u.leaf.PointsCount * sizeof(V3));
-         node->u.leaf.PointsCeiling = (V3*)AllocateMemory(
-            MALLOC_ID_ROOM, node->u.leaf.PointsCount * sizeof(V3));
+         node->u.leaf.Points = (V2*)AllocateMemory(
+            MALLOC_ID_ROOM, node->u.leaf.PointsCount * sizeof(V2));
 
          // read points
          for (j = 0; j < node->u.leaf.PointsCount; j++)
          {
-            if (fread(&node->u.leaf.PointsFloor[j].X, 1, 4, infile) != 4)
-            { fclose(infile); return False; }
-            if (fread(&node->u.leaf.PointsFloor[j].Y, 1, 4, infile) != 4)
-            { fclose(infile); return False; }
-			   
-            // x,y are same on floor/ceiling
-            node->u.leaf.PointsCeiling[j].X = node->u.leaf.PointsFloor[j].X;
-            node->u.leaf.PointsCeiling[j].Y = node->u.leaf.PointsFloor[j].Y;
+            if (fread(&node->u.leaf.Points[j].X, 1, 4, infile) != 4)
+            { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
+            if (fread(&node->u.leaf.Points[j].Y, 1, 4, infile) != 4)
+            { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          }
       }
    }
@@ -1578,59 +2164,59 @@ bool BSPLoadRoom(char *fname, room_type *room)
    fseek(infile, offset_walls, SEEK_SET);
 
    // count of walls
-   if (fread(&room->WallsCount, 1, 2, infile) != 2)
-   { fclose(infile); return False; }
+   if (fread(&geometry->WallsCount, 1, 2, infile) != 2)
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // allocate walls mem
-   room->Walls = (Wall*)AllocateMemory(
-      MALLOC_ID_ROOM, room->WallsCount * sizeof(Wall));
+   geometry->Walls = (Wall*)AllocateMemory(
+      MALLOC_ID_ROOM, geometry->WallsCount * sizeof(Wall));
 
-   for (i = 0; i < room->WallsCount; i++)
+   for (i = 0; i < geometry->WallsCount; i++)
    {
-      Wall* wall = &room->Walls[i];
+      Wall* wall = &geometry->Walls[i];
 
       // save 1-based num for debugging
       wall->Num = i + 1;
 
       // nextwallinplane num
       if (fread(&wall->NextWallInPlaneNum, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // side nums
       if (fread(&wall->RightSideNum, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&wall->LeftSideNum, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // endpoints
       if (fread(&wall->P1.X, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&wall->P1.Y, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&wall->P2.X, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&wall->P2.Y, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // skip length
       if (fread(&temp, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // skip texture offsets
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // sector nums
       if (fread(&wall->RightSectorNum, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&wall->LeftSectorNum, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    }
 
    /***************************** SIDES ****************************************/
@@ -1638,28 +2224,28 @@ bool BSPLoadRoom(char *fname, room_type *room)
    fseek(infile, offset_sides, SEEK_SET);
 
    // count of sides
-   if (fread(&room->SidesCount, 1, 2, infile) != 2)
-   { fclose(infile); return False; }
+   if (fread(&geometry->SidesCount, 1, 2, infile) != 2)
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // allocate sides mem
-   room->Sides = (Side*)AllocateMemory(
-      MALLOC_ID_ROOM, room->SidesCount * sizeof(Side));
+   geometry->Sides = (Side*)AllocateMemory(
+      MALLOC_ID_ROOM, geometry->SidesCount * sizeof(Side));
 
-   for (i = 0; i < room->SidesCount; i++)
+   for (i = 0; i < geometry->SidesCount; i++)
    {
-      Side* side = &room->Sides[i];
+      Side* side = &geometry->Sides[i];
 
       // serverid
       if (fread(&side->ServerID, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // middle,upper,lower texture
       if (fread(&side->TextureMiddle, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&side->TextureUpper, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&side->TextureLower, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // keep track of original texture nums (can change at runtime)
 	  side->TextureLowerOrig  = side->TextureLower;
@@ -1668,11 +2254,11 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
       // flags
      if (fread(&side->Flags, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // skip speed byte
      if (fread(&temp, 1, 1, infile) != 1)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    }
 
    /***************************** SECTORS ****************************************/
@@ -1680,26 +2266,26 @@ bool BSPLoadRoom(char *fname, room_type *room)
    fseek(infile, offset_sectors, SEEK_SET);
 
    // count of sectors
-   if (fread(&room->SectorsCount, 1, 2, infile) != 2)
-   { fclose(infile); return False; }
+   if (fread(&geometry->SectorsCount, 1, 2, infile) != 2)
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // allocate sectors mem
-   room->Sectors = (Sector*)AllocateMemory(
-      MALLOC_ID_ROOM, room->SectorsCount * sizeof(Sector));
+   geometry->Sectors = (Sector*)AllocateMemoryCalloc(
+      MALLOC_ID_ROOM, geometry->SectorsCount, sizeof(Sector));
 
-   for (i = 0; i < room->SectorsCount; i++)
+   for (i = 0; i < geometry->SectorsCount; i++)
    {
-      Sector* sector = &room->Sectors[i];
+      Sector* sector = &geometry->Sectors[i];
 	   
       // serverid
       if (fread(&sector->ServerID, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // floor+ceiling texture
       if (fread(&sector->FloorTexture, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&sector->CeilingTexture, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
 	  // keep track of original texture nums (can change at runtime)
       sector->FloorTextureOrig   = sector->FloorTexture;
@@ -1707,29 +2293,29 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
       // skip texture offsets
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       if (fread(&temp, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // floor+ceiling heights (from 1:64 to 1:1024 like the rest)
       if (fread(&unsigshort, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       sector->FloorHeight = FINENESSKODTOROO((float)unsigshort);
       if (fread(&unsigshort, 1, 2, infile) != 2)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       sector->CeilingHeight = FINENESSKODTOROO((float)unsigshort);
 
       // skip light byte
       if (fread(&temp, 1, 1, infile) != 1)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // flags
       if (fread(&sector->Flags, 1, 4, infile) != 4)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
       // skip speed byte
       if (fread(&temp, 1, 1, infile) != 1)
-      { fclose(infile); return False; }
+      { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 	   
       // possibly load floor slopeinfo
       if ((sector->Flags & SF_SLOPED_FLOOR) == SF_SLOPED_FLOOR)
@@ -1739,25 +2325,25 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
          // read 3d plane equation coefficients (normal vector)
          if (fread(&sector->SlopeInfoFloor->A, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoFloor->B, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoFloor->C, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoFloor->D, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // skip x0, y0, textureangle
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // skip unused payload (vertex indices for roomedit)
          if (fread(&tmpbuf, 1, 18, infile) != 18)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       }
       else
          sector->SlopeInfoFloor = NULL;
@@ -1770,25 +2356,25 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
          // read 3d plane equation coefficients (normal vector)
          if (fread(&sector->SlopeInfoCeiling->A, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoCeiling->B, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoCeiling->C, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&sector->SlopeInfoCeiling->D, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
          // skip x0, y0, textureangle
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
          if (fread(&temp, 1, 4, infile) != 4)
-         { fclose(infile); return False;}
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL;}
 
          // skip unused payload (vertex indices for roomedit)
          if (fread(&tmpbuf, 1, 18, infile) != 18)
-         { fclose(infile); return False; }
+         { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
       }
       else
          sector->SlopeInfoCeiling = NULL;
@@ -1800,11 +2386,11 @@ bool BSPLoadRoom(char *fname, room_type *room)
 
    // count of things
    if (fread(&unsigshort, 1, 2, infile) != 2)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // must have exactly two things describing bbox (each thing a vertex)
    if (unsigshort != 2)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
 
    // note: Things vertices are stored as INT in (1:64) fineness, based on the
    // coordinate-system origin AS SHOWN IN ROOMEDIT (Y-UP).
@@ -1813,41 +2399,41 @@ bool BSPLoadRoom(char *fname, room_type *room)
    float x0, x1, y0, y1;
 
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    x0 = (float)temp;
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    y0 = (float)temp;
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    x1 = (float)temp;
    if (fread(&temp, 1, 4, infile) != 4)
-   { fclose(infile); return False; }
+   { fclose(infile); BSPFreeGeometry(geometry); return NULL; }
    y1 = (float)temp;
    
    // from the 4 bbox points shown in roomedit (defined by 2 vertices)
    // 1) Pick the left-bottom one as minimum (and scale to ROO fineness)
    // 2) Pick the right-up one as maximum (and scale to ROO fineness)
-   room->ThingsBox.Min.X = FINENESSKODTOROO(fmin(x0, x1));
-   room->ThingsBox.Min.Y = FINENESSKODTOROO(fmin(y0, y1));
-   room->ThingsBox.Max.X = FINENESSKODTOROO(fmax(x0, x1));
-   room->ThingsBox.Max.Y = FINENESSKODTOROO(fmax(y0, y1));
+   geometry->ThingsBox.Min.X = FINENESSKODTOROO(fmin(x0, x1));
+   geometry->ThingsBox.Min.Y = FINENESSKODTOROO(fmin(y0, y1));
+   geometry->ThingsBox.Max.X = FINENESSKODTOROO(fmax(x0, x1));
+   geometry->ThingsBox.Max.Y = FINENESSKODTOROO(fmax(y0, y1));
 
    // when roomedit saves the ROO, it translates the origin (0/0)
    // into one boundingbox point, so that origin in ROO (0/0)
    // later is roughly equal to (row=1 col=1)
    
    // translate box so minimum is at (0/0)
-   room->ThingsBox.Max.X = room->ThingsBox.Max.X - room->ThingsBox.Min.X;
-   room->ThingsBox.Max.Y = room->ThingsBox.Max.Y - room->ThingsBox.Min.Y;
-   room->ThingsBox.Min.X = 0.0f;
-   room->ThingsBox.Min.Y = 0.0f;
+   geometry->ThingsBox.Max.X = geometry->ThingsBox.Max.X - geometry->ThingsBox.Min.X;
+   geometry->ThingsBox.Max.Y = geometry->ThingsBox.Max.Y - geometry->ThingsBox.Min.Y;
+   geometry->ThingsBox.Min.X = 0.0f;
+   geometry->ThingsBox.Min.Y = 0.0f;
 
    // calculate the old cols/rows values rather than loading them
-   room->cols = (int)(room->ThingsBox.Max.X / 1024.0f);
-   room->rows = (int)(room->ThingsBox.Max.Y / 1024.0f);
-   room->colshighres = (int)(room->ThingsBox.Max.X / 256.0f);
-   room->rowshighres = (int)(room->ThingsBox.Max.Y / 256.0f);
+   geometry->cols = (int)(geometry->ThingsBox.Max.X / 1024.0f);
+   geometry->rows = (int)(geometry->ThingsBox.Max.Y / 1024.0f);
+   geometry->colshighres = (int)(geometry->ThingsBox.Max.X / 256.0f);
+   geometry->rowshighres = (int)(geometry->ThingsBox.Max.Y / 256.0f);
 
    /************************** DONE READNG **********************************/
 
@@ -1858,171 +2444,208 @@ bool BSPLoadRoom(char *fname, room_type *room)
    /*************************************************************************/
 
    // walls
-   for (int i = 0; i < room->WallsCount; i++)
+   for (int i = 0; i < geometry->WallsCount; i++)
    {
-      Wall* wall = &room->Walls[i];
+      Wall* wall = &geometry->Walls[i];
 
-      // right sector
-      if (wall->RightSectorNum > 0 &&
-          room->SectorsCount > wall->RightSectorNum - 1)
-            wall->RightSector = &room->Sectors[wall->RightSectorNum - 1];
-      else
-         wall->RightSector = NULL;
+      // sides and sectors stay nums, so rooms can look them up in their
+      // own copies. invalid ones become 0 (none)
+      if (wall->RightSectorNum > geometry->SectorsCount)
+         wall->RightSectorNum = 0;
 
-      // left sector
-      if (wall->LeftSectorNum > 0 &&
-         room->SectorsCount > wall->LeftSectorNum - 1)
-            wall->LeftSector = &room->Sectors[wall->LeftSectorNum - 1];
-      else
-         wall->LeftSector = NULL;
+      if (wall->LeftSectorNum > geometry->SectorsCount)
+         wall->LeftSectorNum = 0;
 
-      // right side
-      if (wall->RightSideNum > 0 &&
-         room->SidesCount > wall->RightSideNum - 1)
-            wall->RightSide = &room->Sides[wall->RightSideNum - 1];
-      else
-         wall->RightSide = NULL;
+      if (wall->RightSideNum > geometry->SidesCount)
+         wall->RightSideNum = 0;
 
-      // left side
-      if (wall->LeftSideNum > 0 &&
-         room->SidesCount > wall->LeftSideNum - 1)
-            wall->LeftSide = &room->Sides[wall->LeftSideNum - 1];
-      else
-         wall->LeftSide = NULL;
+      if (wall->LeftSideNum > geometry->SidesCount)
+         wall->LeftSideNum = 0;
 
       // next wall in splitter
       if (wall->NextWallInPlaneNum > 0 &&
-         room->WallsCount > wall->NextWallInPlaneNum - 1)
-            wall->NextWallInPlane = &room->Walls[wall->NextWallInPlaneNum - 1];
+         geometry->WallsCount > wall->NextWallInPlaneNum - 1)
+            wall->NextWallInPlane = &geometry->Walls[wall->NextWallInPlaneNum - 1];
       else
          wall->NextWallInPlane = NULL;
    }
 
    // bsp nodes
-   for (int i = 0; i < room->TreeNodesCount; i++)
+   for (int i = 0; i < geometry->TreeNodesCount; i++)
    {
-      BspNode* node = &room->TreeNodes[i];
+      BspNode* node = &geometry->TreeNodes[i];
 
       // internal nodes
       if (node->Type == BspInternalType)
       {
          // first wall
          if (node->u.internal.FirstWallNum > 0 &&
-             room->WallsCount > node->u.internal.FirstWallNum - 1)
-               node->u.internal.FirstWall = &room->Walls[node->u.internal.FirstWallNum - 1];
+             geometry->WallsCount > node->u.internal.FirstWallNum - 1)
+               node->u.internal.FirstWall = &geometry->Walls[node->u.internal.FirstWallNum - 1];
          else
             node->u.internal.FirstWall = NULL;
 
          // right child
          if (node->u.internal.RightChildNum > 0 &&
-             room->TreeNodesCount > node->u.internal.RightChildNum - 1)
-               node->u.internal.RightChild = &room->TreeNodes[node->u.internal.RightChildNum - 1];
+             geometry->TreeNodesCount > node->u.internal.RightChildNum - 1)
+               node->u.internal.RightChild = &geometry->TreeNodes[node->u.internal.RightChildNum - 1];
          else
             node->u.internal.RightChild = NULL;
 
          // left child
          if (node->u.internal.LeftChildNum > 0 &&
-             room->TreeNodesCount > node->u.internal.LeftChildNum - 1)
-               node->u.internal.LeftChild = &room->TreeNodes[node->u.internal.LeftChildNum - 1];
+             geometry->TreeNodesCount > node->u.internal.LeftChildNum - 1)
+               node->u.internal.LeftChild = &geometry->TreeNodes[node->u.internal.LeftChildNum - 1];
          else
             node->u.internal.LeftChild = NULL;
       }
 
-      // leafs
+      // leafs, sector stays a num like on walls
       else if (node->Type == BspLeafType)
       {
-         // sector this leaf belongs to
-         if (node->u.leaf.SectorNum > 0 &&
-             room->SectorsCount > node->u.leaf.SectorNum - 1)
-               node->u.leaf.Sector = &room->Sectors[node->u.leaf.SectorNum - 1];
-         else
-            node->u.leaf.Sector = NULL;
-      }
-   }
-
-   /*************************************************************************/
-   /*                RESOLVE HEIGHTS OF LEAF POLY POINTS                    */
-   /*************************************************************************/
-
-   for (int i = 0; i < room->TreeNodesCount; i++)
-   {
-      BspNode* node = &room->TreeNodes[i];
-
-      if (node->Type != BspLeafType)
-         continue;
-
-      for (int j = 0; j < node->u.leaf.PointsCount; j++)
-      {
-         if (!node->u.leaf.Sector)
-            continue;
-
-         V2 p = { node->u.leaf.PointsFloor[j].X, node->u.leaf.PointsFloor[j].Y };
-
-         node->u.leaf.PointsFloor[j].Z = 
-            SECTORHEIGHTFLOOR(node->u.leaf.Sector, &p);
-
-         node->u.leaf.PointsCeiling[j].Z =
-            SECTORHEIGHTCEILING(node->u.leaf.Sector, &p);
+         if (node->u.leaf.SectorNum > geometry->SectorsCount)
+            node->u.leaf.SectorNum = 0;
       }
    }
 
    /****************************************************************************/
    /****************************************************************************/
 
-   // no initial blockers
-   room->Blocker = NULL;
+   BSPBuildNavGraph(geometry);
 
-   return True;
+   return geometry;
 }
 
 /*********************************************************************************************/
-/* BSPRoomFreeServer:  Free the parts of a room structure used by the server.                */
+/* BSPFreeGeometry:  Frees what BSPLoadGeometry loaded, once no room uses it anymore.        */
 /*********************************************************************************************/
-void BSPFreeRoom(room_type *room)
+void BSPFreeGeometry(RooGeometry* Geometry)
 {
    int i;
 
-   /****************************************************************************/
-   /*                               CLIENT PARTS                               */
-   /****************************************************************************/
-   
-   // free bsp nodes 'submem'
-   for (i = 0; i < room->TreeNodesCount; i++)
+   if (Geometry->TreeNodes)
    {
-      if (room->TreeNodes[i].Type == BspLeafType)
+      for (i = 0; i < Geometry->TreeNodesCount; i++)
       {
-         FreeMemory(MALLOC_ID_ROOM, room->TreeNodes[i].u.leaf.PointsFloor,
-            room->TreeNodes[i].u.leaf.PointsCount * sizeof(V3));
-         FreeMemory(MALLOC_ID_ROOM, room->TreeNodes[i].u.leaf.PointsCeiling,
-            room->TreeNodes[i].u.leaf.PointsCount * sizeof(V3));
+         if (Geometry->TreeNodes[i].Type == BspLeafType && Geometry->TreeNodes[i].u.leaf.Points)
+            FreeMemory(MALLOC_ID_ROOM, Geometry->TreeNodes[i].u.leaf.Points,
+               Geometry->TreeNodes[i].u.leaf.PointsCount * sizeof(V2));
       }
+      FreeMemory(MALLOC_ID_ROOM, Geometry->TreeNodes, Geometry->TreeNodesCount * sizeof(BspNode));
    }
 
-   // free sectors submem
-   for (i = 0; i < room->SectorsCount; i++)
+   // slopeinfos belong here, the rooms' sector copies only point to them
+   if (Geometry->Sectors)
    {
-      if ((room->Sectors[i].Flags & SF_SLOPED_FLOOR) == SF_SLOPED_FLOOR)
-         FreeMemory(MALLOC_ID_ROOM, room->Sectors[i].SlopeInfoFloor, sizeof(SlopeInfo));
-      if ((room->Sectors[i].Flags & SF_SLOPED_CEILING) == SF_SLOPED_CEILING)
-         FreeMemory(MALLOC_ID_ROOM, room->Sectors[i].SlopeInfoCeiling, sizeof(SlopeInfo));
+      for (i = 0; i < Geometry->SectorsCount; i++)
+      {
+         if (Geometry->Sectors[i].SlopeInfoFloor)
+            FreeMemory(MALLOC_ID_ROOM, Geometry->Sectors[i].SlopeInfoFloor, sizeof(SlopeInfo));
+
+         if (Geometry->Sectors[i].SlopeInfoCeiling)
+            FreeMemory(MALLOC_ID_ROOM, Geometry->Sectors[i].SlopeInfoCeiling, sizeof(SlopeInfo));
+      }
+      FreeMemory(MALLOC_ID_ROOM, Geometry->Sectors, Geometry->SectorsCount * sizeof(Sector));
    }
 
-   FreeMemory(MALLOC_ID_ROOM, room->TreeNodes, room->TreeNodesCount * sizeof(BspNode));
-   FreeMemory(MALLOC_ID_ROOM, room->Walls, room->WallsCount * sizeof(Wall));
+   if (Geometry->Walls)
+      FreeMemory(MALLOC_ID_ROOM, Geometry->Walls, Geometry->WallsCount * sizeof(Wall));
+
+   if (Geometry->Sides)
+      FreeMemory(MALLOC_ID_ROOM, Geometry->Sides, Geometry->SidesCount * sizeof(Side));
+
+   if (Geometry->NavPortals)
+      FreeMemory(MALLOC_ID_ROOM, Geometry->NavPortals,
+         (Geometry->NavPortalsCount + 1) * sizeof(NavPortal));
+
+   if (Geometry->NavFirstPortal)
+      FreeMemory(MALLOC_ID_ROOM, Geometry->NavFirstPortal,
+         (Geometry->TreeNodesCount + 1) * sizeof(int));
+
+   FreeMemory(MALLOC_ID_ROOM, Geometry, sizeof(RooGeometry));
+}
+
+/*********************************************************************************************/
+/* BSPInitRoom:  Sets up room on shared Geometry, with its own copy of sides and sectors.    */
+/*********************************************************************************************/
+void BSPInitRoom(room_type* Room, RooGeometry* Geometry)
+{
+   Room->Geometry = Geometry;
+
+   Room->rows = Geometry->rows;
+   Room->cols = Geometry->cols;
+   Room->rowshighres = Geometry->rowshighres;
+   Room->colshighres = Geometry->colshighres;
+   Room->security = Geometry->security;
+   Room->ThingsBox = Geometry->ThingsBox;
+
+   Room->TreeNodes = Geometry->TreeNodes;
+   Room->TreeNodesCount = Geometry->TreeNodesCount;
+   Room->Walls = Geometry->Walls;
+   Room->WallsCount = Geometry->WallsCount;
+
+   Room->SidesCount = Geometry->SidesCount;
+   Room->Sides = (Side*)AllocateMemory(MALLOC_ID_ROOM, Room->SidesCount * sizeof(Side));
+   memcpy(Room->Sides, Geometry->Sides, Room->SidesCount * sizeof(Side));
+
+   Room->SectorsCount = Geometry->SectorsCount;
+   Room->Sectors = (Sector*)AllocateMemory(MALLOC_ID_ROOM, Room->SectorsCount * sizeof(Sector));
+   memcpy(Room->Sectors, Geometry->Sectors, Room->SectorsCount * sizeof(Sector));
+
+   // no initial blockers
+   Room->Blocker = NULL;
+   Room->BlockerCells = NULL;
+   Room->BlockerCellsCols = 0;
+   Room->BlockerCellsRows = 0;
+   Room->BlockerIds = NULL;
+   Room->BlockerIdsSize = 0;
+   Room->BlockerCount = 0;
+
+   // no paths found yet
+   Room->NavCache = NULL;
+   Room->NavStamp = 0;
+}
+
+/*********************************************************************************************/
+/* BSPFreeRoom:  Free the parts of a room that are its own. The caller releases Geometry.    */
+/*********************************************************************************************/
+void BSPFreeRoom(room_type *room)
+{
    FreeMemory(MALLOC_ID_ROOM, room->Sides, room->SidesCount * sizeof(Side));
    FreeMemory(MALLOC_ID_ROOM, room->Sectors, room->SectorsCount * sizeof(Sector));
 
+   room->TreeNodes = NULL;
+   room->Walls = NULL;
+   room->Sides = NULL;
+   room->Sectors = NULL;
    room->TreeNodesCount = 0;
    room->WallsCount = 0;
    room->SidesCount = 0;
    room->SectorsCount = 0;
-
+   room->Geometry = NULL;
    BSPBlockerClear(room);
 
-   /****************************************************************************/
-   /*                               SERVER PARTS                               */
-   /****************************************************************************/
-  
+   if (room->BlockerCells)
+   {
+      FreeMemory(MALLOC_ID_ROOM, room->BlockerCells,
+         room->BlockerCellsCols * room->BlockerCellsRows * sizeof(Blocker*));
+      FreeMemory(MALLOC_ID_ROOM, room->BlockerIds, room->BlockerIdsSize * sizeof(Blocker*));
+      room->BlockerCells = NULL;
+      room->BlockerIds = NULL;
+   }
+
+   if (room->NavCache)
+   {
+      for (int i = 0; i < NAVCACHESIZE; i++)
+      {
+         NavCacheEntry* entry = &room->NavCache[i];
+         if (entry->Portals)
+            FreeMemory(MALLOC_ID_ROOM, entry->Portals, (entry->PortalsCount + 1) * sizeof(int));
+      }
+      FreeMemory(MALLOC_ID_ROOM, room->NavCache, NAVCACHESIZE * sizeof(NavCacheEntry));
+      room->NavCache = NULL;
+   }
+
    room->rows = 0;
    room->cols = 0;
    room->rowshighres = 0;
@@ -2030,4 +2653,27 @@ void BSPFreeRoom(room_type *room)
    room->resource_id = 0;
    room->roomdata_id = 0;
 }
+
+/*********************************************************************************************/
+/* BSPFreeNavScratch:  Frees the buffers BSPGetPath keeps between searches, for a reset.     */
+/*********************************************************************************************/
+void BSPFreeNavScratch()
+{
+   if (nav.NodesSize)
+   {
+      FreeMemory(MALLOC_ID_ROOM, nav.Stamp, nav.NodesSize * sizeof(int));
+      FreeMemory(MALLOC_ID_ROOM, nav.Closed, nav.NodesSize * sizeof(bool));
+      FreeMemory(MALLOC_ID_ROOM, nav.G, nav.NodesSize * sizeof(float));
+      FreeMemory(MALLOC_ID_ROOM, nav.Pos, nav.NodesSize * sizeof(V2));
+      FreeMemory(MALLOC_ID_ROOM, nav.Via, nav.NodesSize * sizeof(int));
+      FreeMemory(MALLOC_ID_ROOM, nav.Parent, nav.NodesSize * sizeof(int));
+      nav.NodesSize = 0;
+   }
+
+   if (nav.HeapSize)
+   {
+      FreeMemory(MALLOC_ID_ROOM, nav.Heap, nav.HeapSize * sizeof(NavHeapEntry));
+      nav.HeapSize = 0;
+   }
+}
 #pragma endregion
@@ -39,6 +39,13 @@
 #define OBJMINDISTANCE      768.0f                                 // 3 highres rows/cols, old value from kod
 #define OBJMINDISTANCE2     (OBJMINDISTANCE * OBJMINDISTANCE)
 #define LOSEXTEND           64.0f
+#define BLOCKERCELLSIZE     2048.0f            // edge of a cell in the blocker grid of a room
+#define BLOCKERIDHASHSIZE   64                 // initial buckets of the blocker id hash of a room
+#define NAVPROBE            8.0f               // how far outside a leaf edge to look for its neighbour
+#define NAVPROBESTEP        128.0f             // max distance between those probes along an edge
+#define NAVCROSS            (WALLMINDISTANCE + 16.0f) // portal crossings go from this far before to after
+#define NAVCACHESIZE        64                 // paths cached per room, must be a power of 2
+#define NAVMAXPATH          64                 // max waypoints BSPGetPath returns
 
 // Calculation to convert KOD angles to radians.
 #define KODANGLETORADIANS(x) ((float)((x) % (int)MAX_KOD_DEGREE) * PI_MULT_2 / MAX_KOD_DEGREE)
@@ -56,6 +63,11 @@
 #define FLOATTOKODINT(x) \
    (((x) > (float)MAX_KOD_INT) ? MAX_KOD_INT : (((x) < (float)-MIN_KOD_INT) ? -MIN_KOD_INT : (int)x))
 
+// sides and sectors belong to each room, walls and leafs only keep their
+// 1-based nums (0 = none) so they can be shared between rooms
+#define ROOMSIDE(r, num)   ((num) ? &(r)->Sides[(num) - 1] : (Side*)NULL)
+#define ROOMSECTOR(r, num) ((num) ? &(r)->Sectors[(num) - 1] : (Sector*)NULL)
+
 // rounds a floatingpoint-value in ROO fineness to next close
 // value exactly expressable in KOD fineness units
 #define ROUNDROOTOKODFINENESS(a) FINENESSKODTOROO(roundf(FINENESSROOTOKOD(a)))
@@ -141,10 +153,6 @@ typedef struct Wall
    V2             P2;
    unsigned short RightSectorNum;
    unsigned short LeftSectorNum;
-   Sector*        RightSector;
-   Sector*        LeftSector;
-   Side*          RightSide;
-   Side*          LeftSide;
    Wall*          NextWallInPlane;
 } Wall;
 
@@ -171,9 +179,7 @@ typedef struct BspLeaf
 {
    unsigned short SectorNum;
    unsigned short PointsCount;
-   V3*            PointsFloor;
-   V3*            PointsCeiling;
-   Sector*        Sector;
+   V2*            Points;         // heights come from the room's sector
 } BspLeaf;
 
 typedef struct BspNode
@@ -193,9 +199,74 @@ typedef struct Blocker
 {
    int ObjectID;
    V2 Position;
-   Blocker* Next;
+   Blocker* Next;         // all blockers of the room
+   Blocker* Prev;
+   Blocker* NextInCell;   // blockers in the same cell of the room's grid
+   Blocker* PrevInCell;
+   Blocker* NextById;     // blockers in the same bucket of the room's id hash
+   int Cell;
 } Blocker;
 
+// One object's step of a batched BSPGetStepsTowards call.
+typedef struct BSPStep
+{
+   int            ObjectID;
+   V2             S;         // where it is
+   V2             E;         // where it wants to go
+   V2             P;         // where it stepped to
+   unsigned int   Flags;     // state flags, as for BSPGetStepTowards
+   bool           Moved;     // false if it's stuck
+} BSPStep;
+
+// Where a leaf (with a sector) touches another one, made when loading.
+typedef struct NavPortal
+{
+   unsigned short Leaf;      // index in TreeNodes of the leaf on the other side
+   V2             P;         // middle of the part of the edge they share
+   V2             N;         // unit normal from this leaf to the other
+} NavPortal;
+
+// Portals of a path between two leafs, found by BSPGetPath.
+typedef struct NavCacheEntry
+{
+   unsigned short FromLeaf;
+   unsigned short ToLeaf;
+   int            Stamp;         // room's NavStamp when it was found
+   int            PortalsCount;  // -1 if there's no path
+   int*           Portals;
+} NavCacheEntry;
+
+// Everything read from a ROO file. It never changes once loaded, so all
+// rooms loaded from the same file share one (see roomdata.c). The sides
+// and sectors here are the originals each room starts with a copy of.
+typedef struct RooGeometry
+{
+   int refs;             /* Rooms using this, kept by roomdata.c */
+
+   int rows;
+   int cols;
+   int rowshighres;
+   int colshighres;
+   int security;
+
+   BoundingBox2D  ThingsBox;
+
+   BspNode*       TreeNodes;
+   unsigned short TreeNodesCount;
+   Wall*          Walls;
+   unsigned short WallsCount;
+   Side*          Sides;
+   unsigned short SidesCount;
+   Sector*        Sectors;
+   unsigned short SectorsCount;
+
+   // navigation graph, portals of TreeNodes[i] are
+   // NavPortals[NavFirstPortal[i]] to NavPortals[NavFirstPortal[i + 1] - 1]
+   NavPortal*     NavPortals;
+   int            NavPortalsCount;
+   int*           NavFirstPortal;
+} RooGeometry;
+
 typedef struct room_type
 {
    int roomdata_id; 
@@ -211,10 +282,28 @@ typedef struct room_type
    BoundingBox2D  ThingsBox;
    Blocker*       Blocker;
 
+   // blockers indexed by position and by object id, made on first BSPBlockerAdd
+   struct Blocker** BlockerCells;
+   int            BlockerCellsCols;
+   int            BlockerCellsRows;
+   struct Blocker** BlockerIds;
+   int            BlockerIdsSize;
+   int            BlockerCount;
+
+   RooGeometry*   Geometry;
+
+   // paths found by BSPGetPath, made on first use. NavStamp changes
+   // whenever a change to the room may change them.
+   NavCacheEntry* NavCache;
+   int            NavStamp;
+
+   // shared with the other rooms using Geometry
    BspNode*       TreeNodes;
    unsigned short TreeNodesCount;
    Wall*          Walls;
    unsigned short WallsCount;
+
+   // this room's own copies, changed by BSPChangeTexture and BSPMoveSector
    Side*          Sides;
    unsigned short SidesCount;
    Sector*        Sectors;
@@ -235,12 +324,18 @@ void  BSPMoveSector(room_type* Room, unsigned int ServerID, bool Floor, float He
 bool  BSPGetLocationInfo(room_type* Room, V2* P, unsigned int QueryFlags, unsigned int* ReturnFlags, float* HeightF, float* HeightFWD, float* HeightC, BspLeaf** Leaf);
 bool  BSPGetRandomPoint(room_type* Room, int MaxAttempts, V2* P);
 bool  BSPGetStepTowards(room_type* Room, V2* S, V2* E, V2* P, unsigned int* Flags, int ObjectID);
+int   BSPGetStepsTowards(room_type* Room, BSPStep* Steps, int Count);
+bool  BSPGetPath(room_type* Room, V2* S, V2* E, V2* Path, int MaxPath, int* PathCount);
 bool  BSPBlockerAdd(room_type* Room, int ObjectID, V2* P);
 bool  BSPBlockerMove(room_type* Room, int ObjectID, V2* P);
 bool  BSPBlockerRemove(room_type* Room, int ObjectID);
 void  BSPBlockerClear(room_type* Room);
-bool  BSPLoadRoom(char *fname, room_type *room);
+void  BSPBlockerRehashIDs(room_type* Room);
+RooGeometry* BSPLoadGeometry(char *fname);
+void  BSPFreeGeometry(RooGeometry* Geometry);
+void  BSPInitRoom(room_type* Room, RooGeometry* Geometry);
 void  BSPFreeRoom(room_type *room);
+void  BSPFreeNavScratch();
 #pragma endregion
 
 #endif
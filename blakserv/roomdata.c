@@ -8,60 +8,166 @@
 /*
  * roomdata.c
  *
- This module maintains an array of pointers to room_node (all the room data)
- and also an array of pointers to room_rsc_node (used for fast room ID lookup
- by resource id). The arrays have a hardcoded size of 400, and each element
- is a linked list of pointers indexed by room_id % 400 for room_nodes, and
- resource_id % 400 for room_rsc_nodes. This allows a much smaller size to be
- set for the array, but can still handle an unforseen case where more than
- 400 rooms get created. The hardcoded size (INIT_ROOMTABLE_SIZE in roomdata.h)
- should be increased if the 'normal' number of rooms on the server is ever over
- 400 (currently ~270). .roo files loaded by the C function LoadRoom(), called
- from blakod.
+ This module maintains an array of pointers to room_node (all the room data).
+ Each element is a linked list of the rooms with room_id % the size of the
+ array. It starts with INIT_ROOMTABLE_SIZE (in roomdata.h) elements and
+ doubles whenever there are more rooms than elements, so the lists stay
+ short however many rooms get created. .roo files loaded by the C function
+ LoadRoom(), called from blakod.
+
+ What's read from a .roo file never changes, so it's loaded once into a
+ RooGeometry (see roofile.c) and shared by every room loaded from that file,
+ counting how many rooms use it. Each room only has its own copy of the
+ sides and sectors (for changed textures and moved floors/ceilings) and its
+ own blockers.
+
+ Each room also has an interest set (see roomdata.h), so blakod can find
+ the objects near a location (of a class, in view, in line of sight, the
+ nearest ones first) and send a packet to the sessions of the users near it
+ (or in the whole room) without walking its lists of objects.
 
  */
 
 #include "blakserv.h"
 
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
 // Next available room ID.
 int           idcounter = 0;
 // Array of pointers for room data storage.
 room_node     **rooms;
+static int    rooms_size;
+static int    num_rooms;
+
+// Geometry of each loaded .roo file, by path.
+typedef std::map<std::string,RooGeometry *> geometry_map;
+static geometry_map room_geometry;
+
+static RooGeometry * GetRoomGeometry(char *filename)
+{
+   geometry_map::iterator it;
+   RooGeometry *geometry;
+
+   it = room_geometry.find(filename);
+   if (it != room_geometry.end())
+      geometry = it->second;
+   else
+   {
+      geometry = BSPLoadGeometry(filename);
+      if (!geometry)
+         return NULL;
+      room_geometry[filename] = geometry;
+   }
+
+   geometry->refs++;
+   return geometry;
+}
+
+static void ReleaseRoomGeometry(RooGeometry *geometry)
+{
+   geometry_map::iterator it;
+
+   if (--geometry->refs > 0)
+      return;
+
+   for (it = room_geometry.begin(); it != room_geometry.end(); ++it)
+   {
+      if (it->second == geometry)
+      {
+         room_geometry.erase(it);
+         break;
+      }
+   }
+   BSPFreeGeometry(geometry);
+}
+
+static void FreeRoomNode(room_node *room)
+{
+   RooGeometry *geometry;
+   interest_type *interest = &room->interest;
+
+   InterestClear(room);
+   if (interest->cells)
+   {
+      FreeMemory(MALLOC_ID_ROOM, interest->cells,
+         interest->cols * interest->rows * sizeof(interest_node*));
+      FreeMemory(MALLOC_ID_ROOM, interest->ids, interest->ids_size * sizeof(interest_node*));
+   }
+
+   geometry = room->data.Geometry;
+   BSPFreeRoom(&room->data);
+   ReleaseRoomGeometry(geometry);
+   FreeMemory(MALLOC_ID_ROOM, room, sizeof(room_node));
+}
+
+static void GrowRoomTable()
+{
+   room_node **old_rooms, *room, *temp;
+   int old_size, room_hash;
+
+   old_rooms = rooms;
+   old_size = rooms_size;
+
+   rooms_size *= 2;
+   rooms = (room_node **)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+      rooms_size, sizeof(room_node*));
+
+   for (int i = 0; i < old_size; i++)
+   {
+      room = old_rooms[i];
+      while (room)
+      {
+         temp = room->next;
+         room_hash = room->data.roomdata_id % rooms_size;
+         room->next = rooms[room_hash];
+         rooms[room_hash] = room;
+         room = temp;
+      }
+   }
+
+   FreeMemory(MALLOC_ID_ROOM, old_rooms, old_size * sizeof(room_node*));
+}
 
 void InitRooms()
 {
+   rooms_size = INIT_ROOMTABLE_SIZE;
    rooms = (room_node **)AllocateMemoryCalloc(MALLOC_ID_ROOM,
-      INIT_ROOMTABLE_SIZE, sizeof(room_node*));
+      rooms_size, sizeof(room_node*));
+   num_rooms = 0;
    idcounter = 0;
 }
 
 void ExitRooms()
 {
    ResetRooms();
-   FreeMemory(MALLOC_ID_ROOM, rooms, INIT_ROOMTABLE_SIZE * sizeof(room_node*));
+   FreeMemory(MALLOC_ID_ROOM, rooms, rooms_size * sizeof(room_node*));
 }
 
 void ResetRooms()
 {
    room_node *room, *temp;
 
-   for (int i = 0; i < INIT_ROOMTABLE_SIZE; ++i)
+   for (int i = 0; i < rooms_size; ++i)
    {
       if (rooms)
       {
          // Free memory from rooms.
-         room = rooms[i % INIT_ROOMTABLE_SIZE];
+         room = rooms[i];
          while (room)
          {
             temp = room->next;
-            BSPFreeRoom(&room->data);
-            FreeMemory(MALLOC_ID_ROOM, room, sizeof(room_node));
+            FreeRoomNode(room);
             room = temp;
          }
-         rooms[i % INIT_ROOMTABLE_SIZE] = NULL;
+         rooms[i] = NULL;
       }
    }
+   BSPFreeNavScratch();
 
+   num_rooms = 0;
    idcounter = 0;
 }
 
@@ -84,25 +190,29 @@ int LoadRoom(int resource_id)
 
    /****************************************************************/
 
-   // Load ROO
-   room_node* newnode = (room_node*)AllocateMemory(MALLOC_ID_ROOM, sizeof(room_node));
-
    // combine path for roo and filename
    sprintf(s, "%s%s", ConfigStr(PATH_ROOMS), r->resource_val[0]);
 
-   // try load it
-   if (!BSPLoadRoom(s, &newnode->data))
+   // Load ROO, unless another room already did
+   RooGeometry* geometry = GetRoomGeometry(s);
+   if (!geometry)
    {
-      FreeMemory(MALLOC_ID_ROOM, newnode, sizeof(room_node));
       bprintf("LoadRoomData couldn't open %s!!!\n",r->resource_val[0]);
       return NIL;
    }
 
+   room_node* newnode = (room_node*)AllocateMemory(MALLOC_ID_ROOM, sizeof(room_node));
+   BSPInitRoom(&newnode->data, geometry);
+   memset(&newnode->interest, 0, sizeof(interest_type));
+
    // Add this room_node to the rooms table.
    newnode->data.roomdata_id = idcounter++;
    newnode->data.resource_id = resource_id;
-   newnode->next = rooms[newnode->data.roomdata_id % INIT_ROOMTABLE_SIZE];
-   rooms[newnode->data.roomdata_id % INIT_ROOMTABLE_SIZE] = newnode;
+   newnode->next = rooms[newnode->data.roomdata_id % rooms_size];
+   rooms[newnode->data.roomdata_id % rooms_size] = newnode;
+
+   if (++num_rooms > rooms_size)
+      GrowRoomTable();
 
    ret_val.v.data = newnode->data.roomdata_id;
    return ret_val.int_val;
@@ -126,7 +236,7 @@ void UnloadRoom(room_node *r)
       return;
    }
 
-   room_hash = r->data.roomdata_id % INIT_ROOMTABLE_SIZE;
+   room_hash = r->data.roomdata_id % rooms_size;
 
    // Get rooms occupying this position in rooms table.
    room = rooms[room_hash];
@@ -144,8 +254,8 @@ void UnloadRoom(room_node *r)
    if (room->data.roomdata_id == r->data.roomdata_id)
    {
       rooms[room_hash] = room->next;
-      BSPFreeRoom(&room->data);
-      FreeMemory(MALLOC_ID_ROOM, room, sizeof(room_node));
+      FreeRoomNode(room);
+      num_rooms--;
       room = NULL;
 
       return;
@@ -161,8 +271,8 @@ void UnloadRoom(room_node *r)
          // Set current room's next pointer to the next pointer
          // of the room we're freeing.
          room->next = room->next->next;
-         BSPFreeRoom(&temp->data);
-         FreeMemory(MALLOC_ID_ROOM, temp, sizeof(room_node));
+         FreeRoomNode(temp);
+         num_rooms--;
 
          return;
       }
@@ -179,10 +289,10 @@ room_node * GetRoomDataByID(int id)
 {
    room_node *room;
 
-   if (!rooms)
+   if (!rooms || id < 0)
       return NULL;
 
-   room = rooms[id % INIT_ROOMTABLE_SIZE];
+   room = rooms[id % rooms_size];
    while (room)
    {
       if (room->data.roomdata_id == id)
@@ -205,13 +315,15 @@ void PrintRoomTable()
       return;
    }
 
-   for (int i = 0; i < INIT_ROOMTABLE_SIZE; i++)
+   for (int i = 0; i < rooms_size; i++)
    {
       room = rooms[i];
       while (room)
       {
-         aprintf("Room at position %i, roomdata %i, resource %s\n",
-            i, room->data.roomdata_id, GetResourceStrByLanguageID(room->data.resource_id,0));
+         aprintf("Room at position %i, roomdata %i, resource %s, geometry shared by %i, "
+            "%i interested (%i sessions)\n",
+            i, room->data.roomdata_id, GetResourceStrByLanguageID(room->data.resource_id,0),
+            room->data.Geometry->refs, room->interest.count, room->interest.num_sessions);
          room = room->next;
       }
    }
@@ -221,7 +333,7 @@ void ForEachRoom(void(*callback_func)(room_node *r))
 {
    room_node *node;
 
-   for (int i = 0; i < INIT_ROOMTABLE_SIZE; i++)
+   for (int i = 0; i < rooms_size; i++)
    {
       node = rooms[i];
       while (node)
@@ -231,3 +343,465 @@ void ForEachRoom(void(*callback_func)(room_node *r))
       }
    }
 }
+
+/* Interest set. Objects are kept in the grid cell their position is in,
+   positions outside the thingsbox in the nearest border cell. */
+
+static int GetInterestCellCoord(float value, int count)
+{
+   if (value <= 0.0f)
+      return 0;
+
+   value /= INTEREST_CELL_SIZE;
+   if (value >= (float)(count - 1))
+      return count - 1;
+
+   return (int)value;
+}
+
+static int GetInterestCell(interest_type *interest, V2 *pos)
+{
+   return GetInterestCellCoord(pos->Y, interest->rows) * interest->cols +
+      GetInterestCellCoord(pos->X, interest->cols);
+}
+
+static void LinkInterestCell(interest_type *interest, interest_node *i)
+{
+   i->cell = GetInterestCell(interest, &i->pos);
+   i->prev_in_cell = NULL;
+   i->next_in_cell = interest->cells[i->cell];
+   if (i->next_in_cell)
+      i->next_in_cell->prev_in_cell = i;
+   interest->cells[i->cell] = i;
+}
+
+static void UnlinkInterestCell(interest_type *interest, interest_node *i)
+{
+   if (i->prev_in_cell)
+      i->prev_in_cell->next_in_cell = i->next_in_cell;
+   else
+      interest->cells[i->cell] = i->next_in_cell;
+
+   if (i->next_in_cell)
+      i->next_in_cell->prev_in_cell = i->prev_in_cell;
+}
+
+static void LinkInterestSession(interest_type *interest, interest_node *i)
+{
+   i->prev_session = NULL;
+   i->next_session = interest->sessions;
+   if (i->next_session)
+      i->next_session->prev_session = i;
+   interest->sessions = i;
+   interest->num_sessions++;
+}
+
+static void UnlinkInterestSession(interest_type *interest, interest_node *i)
+{
+   if (i->prev_session)
+      i->prev_session->next_session = i->next_session;
+   else
+      interest->sessions = i->next_session;
+
+   if (i->next_session)
+      i->next_session->prev_session = i->prev_session;
+   interest->num_sessions--;
+}
+
+static void ResizeInterestIDs(interest_type *interest, int size)
+{
+   interest_node *i;
+   int cell_count, hash;
+
+   FreeMemory(MALLOC_ID_ROOM, interest->ids, interest->ids_size * sizeof(interest_node*));
+   interest->ids_size = size;
+   interest->ids = (interest_node **)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+      size, sizeof(interest_node*));
+
+   cell_count = interest->cols * interest->rows;
+   for (int cell = 0; cell < cell_count; cell++)
+   {
+      for (i = interest->cells[cell]; i; i = i->next_in_cell)
+      {
+         hash = i->object_id & (size - 1);
+         i->next_by_id = interest->ids[hash];
+         interest->ids[hash] = i;
+      }
+   }
+}
+
+static interest_node * GetInterestNode(interest_type *interest, int object_id)
+{
+   interest_node *i;
+
+   if (!interest->ids)
+      return NULL;
+
+   i = interest->ids[object_id & (interest->ids_size - 1)];
+   while (i && i->object_id != object_id)
+      i = i->next_by_id;
+
+   return i;
+}
+
+Bool InterestAdd(room_node *r, int object_id, int session_id, V2 *pos)
+{
+   interest_type *interest = &r->interest;
+   interest_node *i;
+   int hash;
+
+   // already there, just take the new values
+   i = GetInterestNode(interest, object_id);
+   if (i)
+   {
+      if (i->session_id != -1)
+         UnlinkInterestSession(interest, i);
+      i->session_id = session_id;
+      if (i->session_id != -1)
+         LinkInterestSession(interest, i);
+
+      return InterestMove(r, object_id, pos);
+   }
+
+   // first object in this room, make its grid and hash
+   if (!interest->cells)
+   {
+      interest->cols = (int)(r->data.ThingsBox.Max.X / INTEREST_CELL_SIZE) + 1;
+      interest->rows = (int)(r->data.ThingsBox.Max.Y / INTEREST_CELL_SIZE) + 1;
+      interest->cells = (interest_node **)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+         interest->cols * interest->rows, sizeof(interest_node*));
+
+      interest->ids_size = INIT_INTEREST_HASH_SIZE;
+      interest->ids = (interest_node **)AllocateMemoryCalloc(MALLOC_ID_ROOM,
+         interest->ids_size, sizeof(interest_node*));
+   }
+
+   i = (interest_node *)AllocateMemory(MALLOC_ID_ROOM, sizeof(interest_node));
+   i->object_id = object_id;
+   i->session_id = session_id;
+   i->pos = *pos;
+
+   LinkInterestCell(interest, i);
+   if (session_id != -1)
+      LinkInterestSession(interest, i);
+
+   if (++interest->count > interest->ids_size)
+      ResizeInterestIDs(interest, interest->ids_size * 2);
+   else
+   {
+      hash = object_id & (interest->ids_size - 1);
+      i->next_by_id = interest->ids[hash];
+      interest->ids[hash] = i;
+   }
+
+   return True;
+}
+
+Bool InterestMove(room_node *r, int object_id, V2 *pos)
+{
+   interest_type *interest = &r->interest;
+   interest_node *i;
+
+   i = GetInterestNode(interest, object_id);
+   if (!i)
+      return False;
+
+   i->pos = *pos;
+   if (GetInterestCell(interest, pos) != i->cell)
+   {
+      UnlinkInterestCell(interest, i);
+      LinkInterestCell(interest, i);
+   }
+
+   return True;
+}
+
+Bool InterestRemove(room_node *r, int object_id)
+{
+   interest_type *interest = &r->interest;
+   interest_node *i, **link;
+
+   i = GetInterestNode(interest, object_id);
+   if (!i)
+      return False;
+
+   link = &interest->ids[object_id & (interest->ids_size - 1)];
+   while (*link != i)
+      link = &(*link)->next_by_id;
+   *link = i->next_by_id;
+
+   UnlinkInterestCell(interest, i);
+   if (i->session_id != -1)
+      UnlinkInterestSession(interest, i);
+   interest->count--;
+
+   FreeMemory(MALLOC_ID_ROOM, i, sizeof(interest_node));
+
+   return True;
+}
+
+void InterestClear(room_node *r)
+{
+   interest_type *interest = &r->interest;
+   interest_node *i, *temp;
+   int cell_count;
+
+   if (!interest->cells)
+      return;
+
+   cell_count = interest->cols * interest->rows;
+   for (int cell = 0; cell < cell_count; cell++)
+   {
+      i = interest->cells[cell];
+      while (i)
+      {
+         temp = i->next_in_cell;
+         FreeMemory(MALLOC_ID_ROOM, i, sizeof(interest_node));
+         i = temp;
+      }
+      interest->cells[cell] = NULL;
+   }
+   memset(interest->ids, 0, interest->ids_size * sizeof(interest_node*));
+
+   interest->count = 0;
+   interest->sessions = NULL;
+   interest->num_sessions = 0;
+}
+
+// Call after changing the object_id of interest nodes directly.
+void InterestRehashIDs(room_node *r)
+{
+   if (r->interest.ids)
+      ResizeInterestIDs(&r->interest, r->interest.ids_size);
+}
+
+// Calls callback_func for each object within radius (ROO units) of center,
+// or for each object in the room if radius <= 0 (center may be NULL then).
+void ForEachInterested(room_node *r, V2 *center, float radius,
+                       void(*callback_func)(interest_node *i))
+{
+   interest_type *interest = &r->interest;
+   interest_node *i, *temp;
+   int col0, col1, row0, row1;
+   V2 d;
+
+   if (!interest->cells)
+      return;
+
+   if (radius <= 0.0f)
+   {
+      col0 = row0 = 0;
+      col1 = interest->cols - 1;
+      row1 = interest->rows - 1;
+   }
+   else
+   {
+      col0 = GetInterestCellCoord(center->X - radius, interest->cols);
+      col1 = GetInterestCellCoord(center->X + radius, interest->cols);
+      row0 = GetInterestCellCoord(center->Y - radius, interest->rows);
+      row1 = GetInterestCellCoord(center->Y + radius, interest->rows);
+   }
+
+   for (int row = row0; row <= row1; row++)
+   {
+      for (int col = col0; col <= col1; col++)
+      {
+         i = interest->cells[row * interest->cols + col];
+         while (i)
+         {
+            // callback may remove i
+            temp = i->next_in_cell;
+
+            if (radius <= 0.0f)
+               callback_func(i);
+            else
+            {
+               V2SUB(&d, &i->pos, center);
+               if (V2LEN2(&d) <= radius * radius)
+                  callback_func(i);
+            }
+
+            i = temp;
+         }
+      }
+   }
+}
+
+// Sends a copy of the current blakod packet to the session of each user
+// within radius (ROO units) of center, or in the whole room if radius <= 0,
+// except the one of except_object_id. Returns how many it was sent to.
+int InterestSendCopyPacket(room_node *r, int except_object_id, V2 *center, float radius)
+{
+   interest_type *interest = &r->interest;
+   interest_node *i;
+   int col0, col1, row0, row1, sent = 0;
+   V2 d;
+
+   if (radius <= 0.0f)
+   {
+      for (i = interest->sessions; i; i = i->next_session)
+      {
+         if (i->object_id != except_object_id)
+         {
+            SendCopyPacket(i->session_id);
+            sent++;
+         }
+      }
+
+      return sent;
+   }
+
+   if (!interest->cells || interest->num_sessions == 0)
+      return 0;
+
+   col0 = GetInterestCellCoord(center->X - radius, interest->cols);
+   col1 = GetInterestCellCoord(center->X + radius, interest->cols);
+   row0 = GetInterestCellCoord(center->Y - radius, interest->rows);
+   row1 = GetInterestCellCoord(center->Y + radius, interest->rows);
+
+   for (int row = row0; row <= row1; row++)
+   {
+      for (int col = col0; col <= col1; col++)
+      {
+         for (i = interest->cells[row * interest->cols + col]; i; i = i->next_in_cell)
+         {
+            if (i->session_id == -1 || i->object_id == except_object_id)
+               continue;
+
+            V2SUB(&d, &i->pos, center);
+            if (V2LEN2(&d) <= radius * radius)
+            {
+               SendCopyPacket(i->session_id);
+               sent++;
+            }
+         }
+      }
+   }
+
+   return sent;
+}
+
+typedef std::pair<float,interest_node *> interest_found;
+
+static bool CompareInterestFound(const interest_found &a, const interest_found &b)
+{
+   return a.first < b.first;
+}
+
+// Calls callback_func for each object of the room's interest set that passes
+// filter. If max_found > 0, only for the max_found ones nearest to the
+// center, nearest first. callback_func must not find again.
+void ForEachInterestFound(room_node *r, interest_filter *filter, int max_found,
+                          void(*callback_func)(interest_node *i))
+{
+   // kept to not allocate for every query
+   static std::vector<interest_found> found;
+   interest_type *interest = &r->interest;
+   interest_node *i;
+   object_node *o;
+   class_node *c;
+   int col0, col1, row0, row1, count;
+   float radius2, tmp1, tmp2;
+   BspLeaf *leaf;
+   V2 d, e;
+   V3 s, e3;
+
+   if (!interest->cells)
+      return;
+
+   if (filter->radius <= 0.0f)
+   {
+      col0 = row0 = 0;
+      col1 = interest->cols - 1;
+      row1 = interest->rows - 1;
+   }
+   else
+   {
+      col0 = GetInterestCellCoord(filter->center.X - filter->radius, interest->cols);
+      col1 = GetInterestCellCoord(filter->center.X + filter->radius, interest->cols);
+      row0 = GetInterestCellCoord(filter->center.Y - filter->radius, interest->rows);
+      row1 = GetInterestCellCoord(filter->center.Y + filter->radius, interest->rows);
+   }
+   radius2 = filter->radius * filter->radius;
+
+   // eyes of one standing at center, like LineOfSightBSP
+   if (filter->check_los)
+   {
+      s.X = filter->center.X;
+      s.Y = filter->center.Y;
+      s.Z = 0.0f;  // stays if center is outside the map
+      leaf = NULL;
+      BSPGetHeight(&r->data, &filter->center, &tmp1, &s.Z, &tmp2, &leaf);
+      s.Z += OBJECTHEIGHTROO;
+   }
+
+   found.clear();
+   for (int row = row0; row <= row1; row++)
+   {
+      for (int col = col0; col <= col1; col++)
+      {
+         for (i = interest->cells[row * interest->cols + col]; i; i = i->next_in_cell)
+         {
+            if (i->object_id == filter->except_object_id)
+               continue;
+
+            V2SUB(&d, &i->pos, &filter->center);
+            if (filter->radius > 0.0f && V2LEN2(&d) > radius2)
+               continue;
+
+            if (filter->c)
+            {
+               o = GetObjectByID(i->object_id);
+               if (!o)
+                  continue;
+               c = GetClassByID(o->class_id);
+               if (!c || !IsClassDescendant(c, filter->c))
+                  continue;
+            }
+
+            if (filter->check_view)
+            {
+               // BSPLineOfSightView changes its E
+               e = i->pos;
+               if (!BSPLineOfSightView(&filter->center, &e, filter->view_angle))
+                  continue;
+            }
+
+            found.push_back(interest_found(V2LEN2(&d), i));
+         }
+      }
+   }
+
+   if (max_found > 0 && max_found < (int)found.size() && !filter->check_los)
+   {
+      std::partial_sort(found.begin(), found.begin() + max_found, found.end(),
+         CompareInterestFound);
+      found.resize(max_found);
+   }
+   else if (max_found > 0)
+      std::sort(found.begin(), found.end(), CompareInterestFound);
+
+   // line of sight last, it's the expensive test
+   count = 0;
+   for (size_t k = 0; k < found.size(); k++)
+   {
+      if (max_found > 0 && count >= max_found)
+         break;
+
+      i = found[k].second;
+      if (filter->check_los)
+      {
+         e3.X = i->pos.X;
+         e3.Y = i->pos.Y;
+         e3.Z = 0.0f;
+         leaf = NULL;
+         BSPGetHeight(&r->data, &i->pos, &tmp1, &e3.Z, &tmp2, &leaf);
+         e3.Z += OBJECTHEIGHTROO;
+         if (!BSPLineOfSight(&r->data, &s, &e3))
+            continue;
+      }
+
+      callback_func(i);
+      count++;
+   }
+}
@@ -15,9 +15,54 @@
 
 #define INIT_ROOMTABLE_SIZE 400
 
+#define INTEREST_CELL_SIZE 8192.0f  // side of an interest grid cell, ROO units (8 rows)
+#define INIT_INTEREST_HASH_SIZE 64
+
+/* An object (and the session of its user, if any) the room tells about
+   things happening near it. */
+typedef struct interest_node
+{
+   int object_id;
+   int session_id;                        // -1 if not a user
+   V2 pos;
+   int cell;
+   struct interest_node *next_in_cell;
+   struct interest_node *prev_in_cell;
+   struct interest_node *next_by_id;
+   struct interest_node *next_session;    // only if session_id != -1
+   struct interest_node *prev_session;
+} interest_node;
+
+/* Interest set of a room: its objects in a uniform grid over the room's
+   thingsbox, hashed by object id, and the ones with a session in a list. */
+typedef struct interest_type
+{
+   interest_node **cells;
+   int cols;
+   int rows;
+   interest_node **ids;
+   int ids_size;
+   int count;
+   interest_node *sessions;
+   int num_sessions;
+} interest_type;
+
+/* Which objects of an interest set ForEachInterestFound calls back for. */
+typedef struct interest_filter
+{
+   V2 center;
+   float radius;           // ROO units, <= 0 for the whole room
+   class_node *c;          // only instances of c or its descendants, NULL for any
+   int except_object_id;   // e.g. the one asking, INVALID_OBJECT for none
+   Bool check_view;        // only objects in the view of one at center facing view_angle
+   int view_angle;
+   Bool check_los;         // only objects in line of sight from center
+} interest_filter;
+
 typedef struct room_node
 {
    room_type data;
+   interest_type interest;
    struct room_node *next;
 } room_node;
 
@@ -30,4 +75,15 @@ room_node*  GetRoomDataByID(int id);
 void PrintRoomTable();
 void ForEachRoom(void(*callback_func)(room_node *r));
 
+Bool InterestAdd(room_node *r, int object_id, int session_id, V2 *pos);
+Bool InterestMove(room_node *r, int object_id, V2 *pos);
+Bool InterestRemove(room_node *r, int object_id);
+void InterestClear(room_node *r);
+void InterestRehashIDs(room_node *r);
+void ForEachInterested(room_node *r, V2 *center, float radius,
+                       void(*callback_func)(interest_node *i));
+int  InterestSendCopyPacket(room_node *r, int except_object_id, V2 *center, float radius);
+void ForEachInterestFound(room_node *r, interest_filter *filter, int max_found,
+                          void(*callback_func)(interest_node *i));
+
 #endif
@@ -329,12 +329,11 @@ void SaveEachTable(table_node *t,int table_id)
 
    for (int i = 0; i < t->size; ++i)
    {
-      hn = t->table[i];
-      while (hn != NULL)
+      hn = &t->table[i];
+      if (hn->hash != 0)
       {
          SaveGameCopyIntBuffer(hn->key_val.int_val);
          SaveGameCopyIntBuffer(hn->data_val.int_val);
-         hn = hn->next;
       }
    }
 }
@@ -364,7 +363,12 @@ void SaveEachTimer(timer_node *t)
       return;
    }
 
-   SaveGameCopyByteBuffer(SAVE_GAME_TIMER);
+   /* one-shot timers keep the old record, so older servers can still
+      read a save that has no periodic timers */
+   if (t->period > 0)
+      SaveGameCopyByteBuffer(SAVE_GAME_PERIODIC_TIMER);
+   else
+      SaveGameCopyByteBuffer(SAVE_GAME_TIMER);
    SaveGameCopyIntBuffer(t->timer_id);
    SaveGameCopyIntBuffer(t->object_id);
    SaveGameCopyStringBuffer(GetNameByID(t->message_id));
@@ -373,6 +377,8 @@ void SaveEachTimer(timer_node *t)
    if (save_time < 0)
       save_time = 0;
    SaveGameCopyIntBuffer(save_time);
+   if (t->period > 0)
+      SaveGameCopyIntBuffer(t->period);
 }
 
 void SaveUsers(void)
@@ -31,7 +31,8 @@ enum
    SAVE_GAME_TIMER = 6,
    SAVE_GAME_USER = 7,
    SAVE_GAME_TABLES = 8,
-   SAVE_GAME_VERSION = 9
+   SAVE_GAME_VERSION = 9,
+   SAVE_GAME_PERIODIC_TIMER = 10
 };
 
 Bool SaveGame(char *filename);
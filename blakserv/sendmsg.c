@@ -10,11 +10,22 @@
  *
 
   This module interprets compiled Blakod.
+
+  Message handlers normally run from the pre-decoded instruction stream
+  built by loadkod.c (InterpretCode).  With gcc we use direct-threaded
+  dispatch: each instruction holds the address of the label that
+  executes it.  Other compilers dispatch with a switch on the op.  Any
+  handler that couldn't be translated runs from the raw bkod
+  (InterpretAtMessage).
   
 */
 
 #include "blakserv.h"
 
+#ifdef __GNUC__
+#define THREADED_DISPATCH
+#endif
+
 /* global debugging and profiling information */
 
 /* stuff to calculate messages & times */
@@ -27,10 +38,14 @@ kod_statistics kod_stat;      /* actual statistics */
 
 char *bkod;
 int num_interpreted = 0; /* number of instructions in this top level call */
+/* the interpreter leaves its fast path when num_interpreted passes this:
+   either at MAX_BLAKOD_STATEMENTS, or earlier for a profiler sample */
+static int interpret_limit = MAX_BLAKOD_STATEMENTS;
 
 int trace_session_id = INVALID_ID;
 
 post_queue_type post_q;
+post_stat_type post_stat;
 
 // Structs for unary/binary op to read data quicker. Can't include the
 // info byte as the alignment will be incorrect. Forcing alignment with
@@ -69,13 +84,29 @@ int done;
 /* local function prototypes */
 int InterpretAtMessage(int object_id,class_node* c,message_node* m,
                   int num_sent_parms,parm_node sent_parms[],
-                  val_type *ret_val);
+                  const signed char *bound_parm,val_type *ret_val);
 __inline void StoreValue(int object_id,local_var_type *local_vars,int data_type,int data,
                    val_type new_data);
 void InterpretUnaryAssign(int object_id,local_var_type *local_vars,opcode_type opcode);
 void InterpretBinaryAssign(int object_id,local_var_type *local_vars,opcode_type opcode);
 void InterpretGoto(int object_id, local_var_type *local_vars, opcode_type opcode);
 void InterpretCall(int object_id,local_var_type *local_vars,opcode_type opcode);
+int InterpretCode(int object_id,class_node* c,message_node* m,
+                  int num_sent_parms,parm_node sent_parms[],
+                  const signed char *bound_parm,val_type *ret_val);
+void InterpretCodeCall(int object_id,local_var_type *local_vars,prop_type *self_props,
+                       kod_call *call);
+void BindCacheParms(send_cache_type *cache,int num_sent_parms,parm_node sent_parms[]);
+Bool InterpretLimitReached(void);
+void ResetNumInterpreted(void);
+void TakeProfileSample(void);
+
+#ifdef THREADED_DISPATCH
+static const void **kod_inst_labels;
+#endif
+
+/* call being made by InterpretCodeCall, NULL if from raw bkod */
+static kod_call *current_call;
 
 void InitProfiling(void)
 {
@@ -132,8 +163,12 @@ void InitBkodInterpret(void)
 
    bkod = NULL;
 
-   post_q.next = 0;
-   post_q.last = 0;
+   post_q.first = NULL;
+   post_q.read = 0;
+   post_q.last = NULL;
+   post_q.pool = NULL;
+   post_q.num_pool = 0;
+   post_q.depth = 0;
    
    for (i=0;i<MAX_C_FUNCTION;i++)
       ccall_table[i] = C_Invalid;
@@ -179,6 +214,7 @@ void InitBkodInterpret(void)
    ccall_table[DELETETIMER] = C_DeleteTimer;
    ccall_table[GETTIMEREMAINING] = C_GetTimeRemaining;
    ccall_table[ISTIMER] = C_IsTimer;
+   ccall_table[CREATEPERIODICTIMER] = C_CreatePeriodicTimer;
    ccall_table[CREATEROOMDATA] = C_LoadRoom;
    ccall_table[FREEROOM] = C_FreeRoom;
    ccall_table[ROOMDATA] = C_RoomData;
@@ -194,6 +230,16 @@ void InitBkodInterpret(void)
    ccall_table[BLOCKERCLEARBSP] = C_BlockerClearBSP;
    ccall_table[GETRANDOMPOINTBSP] = C_GetRandomPointBSP;
    ccall_table[GETSTEPTOWARDSBSP] = C_GetStepTowardsBSP;
+   ccall_table[GETSTEPSTOWARDSBSP] = C_GetStepsTowardsBSP;
+   ccall_table[GETPATHBSP] = C_GetPathBSP;
+   ccall_table[INTERESTADD] = C_InterestAdd;
+   ccall_table[INTERESTMOVE] = C_InterestMove;
+   ccall_table[INTERESTREMOVE] = C_InterestRemove;
+   ccall_table[INTERESTQUERY] = C_InterestQuery;
+   ccall_table[INTERESTSENDPACKET] = C_InterestSendPacket;
+   ccall_table[GETOBJECTSINRADIUS] = C_GetObjectsInRadius;
+   ccall_table[GETNEARESTOBJECTS] = C_GetNearestObjects;
+   ccall_table[GETOBJECTSINVIEW] = C_GetObjectsInView;
 
    ccall_table[APPENDLISTELEM] = C_AppendListElem;
    ccall_table[CONS] = C_Cons;
@@ -265,6 +311,18 @@ Bool IsInterpreting(void)
    return bkod != NULL;
 }
 
+/* used by loadkod.c when translating bkod; NULL unless threaded dispatch */
+const void * GetKodInstHandler(int op)
+{
+#ifdef THREADED_DISPATCH
+   if (kod_inst_labels == NULL)
+      InterpretCode(INVALID_OBJECT,NULL,NULL,0,NULL,NULL,NULL);
+   return kod_inst_labels[op];
+#else
+   return NULL;
+#endif
+}
+
 void TraceInfo(int session_id,char *class_name,int message_id,int num_parms,
                parm_node parms[])
 {
@@ -307,25 +365,124 @@ void TraceInfo(int session_id,char *class_name,int message_id,int num_parms,
    SendSessionAdminText(session_id, buf_ptr);
 }
 
-void PostBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[])
+post_stat_type * GetPostStats(void)
+{
+   return &post_stat;
+}
+
+int GetPostQueueDepth(void)
+{
+   return post_q.depth;
+}
+
+int GetMessageDepth(void)
+{
+   return message_depth;
+}
+
+post_segment * NewPostSegment(void)
 {
-   int i, new_next;
+   post_segment *seg;
+
+   if (post_q.pool != NULL)
+   {
+      seg = post_q.pool;
+      post_q.pool = seg->next;
+      post_q.num_pool--;
+   }
+   else
+   {
+      seg = (post_segment *)AllocateMemory(MALLOC_ID_POST,sizeof(post_segment));
+      post_stat.segments_used++;
+      if (post_stat.segments_used > post_stat.segments_highest)
+         post_stat.segments_highest = post_stat.segments_used;
+   }
+   seg->used = 0;
+   seg->next = NULL;
+   return seg;
+}
 
-   new_next = (post_q.next + 1) % MAX_POST_QUEUE;
-   if (new_next == post_q.last)
+void FreePostSegment(post_segment *seg)
+{
+   if (post_q.num_pool >= MAX_POST_POOL)
    {
-      bprintf("PostBlakodMessage can't post MESSAGE %s (%i) to OBJECT %i; queue filled\n",
-         GetNameByID(message_id),message_id,object_id);
+      FreeMemory(MALLOC_ID_POST,seg,sizeof(post_segment));
+      post_stat.segments_used--;
       return;
    }
-   post_q.data[post_q.next].object_id = object_id;
-   post_q.data[post_q.next].message_id = message_id;
-   post_q.data[post_q.next].num_parms = num_parms;
-   for (i=0;i<num_parms;i++)
+   seg->next = post_q.pool;
+   post_q.pool = seg;
+   post_q.num_pool++;
+}
+
+void PostBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[])
+{
+   post_node *p;
+   int size;
+
+   size = PostNodeSize(num_parms);
+
+   if (post_q.last == NULL)
+   {
+      post_q.first = post_q.last = NewPostSegment();
+      post_q.read = 0;
+   }
+   else if (post_q.last->used + size > POST_SEGMENT_SIZE)
    {
-      post_q.data[post_q.next].parms[i] = parms[i];
+      post_q.last->next = NewPostSegment();
+      post_q.last = post_q.last->next;
    }
-   post_q.next = new_next;
+
+   p = (post_node *)(post_q.last->data + post_q.last->used);
+   p->object_id = object_id;
+   p->message_id = message_id;
+   p->num_parms = num_parms;
+   memcpy(p->parms,parms,num_parms*sizeof(parm_node));
+   post_q.last->used += size;
+
+   post_q.depth++;
+   if (post_q.depth > post_stat.depth_highest)
+      post_stat.depth_highest = post_q.depth;
+   post_stat.num_posted++;
+
+   if (kod_stat.interpreting_class >= 0)
+   {
+      if (kod_stat.interpreting_class >= (int)post_stat.by_class.size())
+         post_stat.by_class.resize(kod_stat.interpreting_class + 1,0);
+      post_stat.by_class[kod_stat.interpreting_class]++;
+   }
+}
+
+/* returns the oldest posted message, or NULL if there isn't one.  It
+   stays valid until the next call, even if more messages are posted. */
+post_node * NextPostedMessage(void)
+{
+   post_segment *seg;
+   post_node *p;
+
+   seg = post_q.first;
+   if (seg == NULL)
+      return NULL;
+
+   if (post_q.read == seg->used)
+   {
+      /* nothing left here; the newest segment is kept for writing */
+      if (seg->next == NULL)
+      {
+         post_q.first = post_q.last = NULL;
+         FreePostSegment(seg);
+         return NULL;
+      }
+      post_q.first = seg->next;
+      post_q.read = 0;
+      FreePostSegment(seg);
+      seg = post_q.first;
+   }
+
+   p = (post_node *)(seg->data + post_q.read);
+   post_q.read += PostNodeSize(p->num_parms);
+   post_q.depth--;
+   return p;
 }
 
 /* returns the return value of the blakod */
@@ -336,6 +493,9 @@ int SendTopLevelBlakodMessage(int object_id,int message_id,int num_parms,parm_no
    double interp_time = 0;
    int posts = 0;
    int accumulated_num_interpreted = 0;
+   double drain_start = 0;
+   int drain_time;
+   post_node *p;
 
    if (message_depth != 0)
    {
@@ -346,16 +506,19 @@ int SendTopLevelBlakodMessage(int object_id,int message_id,int num_parms,parm_no
    start_time = GetMicroCountDouble();
    kod_stat.num_top_level_messages++;
    trace_session_id = INVALID_ID;
-   num_interpreted = 0;
+   ResetNumInterpreted();
 
    ret_val = SendBlakodMessage(object_id,message_id,num_parms,parms);
 
-   while (post_q.next != post_q.last)
+   if (post_q.depth > 0)
+      drain_start = GetMicroCountDouble();
+
+   while (post_q.depth > 0)
    {
       posts++;
 
       accumulated_num_interpreted += num_interpreted;
-      num_interpreted = 0;
+      ResetNumInterpreted();
 
       if (accumulated_num_interpreted > 10 * MAX_BLAKOD_STATEMENTS)
       {
@@ -370,11 +533,21 @@ int SendTopLevelBlakodMessage(int object_id,int message_id,int num_parms,parm_no
          break;
       }
 
+      p = NextPostedMessage();
+      if (p == NULL)
+         break;
+
       /* posted messages' return value is ignored */
-      SendBlakodMessage(post_q.data[post_q.last].object_id,post_q.data[post_q.last].message_id,
-         post_q.data[post_q.last].num_parms,post_q.data[post_q.last].parms);
+      SendBlakodMessage(p->object_id,p->message_id,p->num_parms,p->parms);
+   }
 
-      post_q.last = (post_q.last + 1) % MAX_POST_QUEUE;
+   if (posts > 0)
+   {
+      drain_time = (int)(GetMicroCountDouble() - drain_start);
+      post_stat.num_drains++;
+      post_stat.drain_time += drain_time;
+      if (drain_time > post_stat.drain_time_highest)
+         post_stat.drain_time_highest = drain_time;
    }
 
    interp_time = GetMicroCountDouble() - start_time;
@@ -415,6 +588,7 @@ int SendTopLevelBlakodMessage(int object_id,int message_id,int num_parms,parm_no
 
 typedef struct {
    int class_id;
+   class_node *ancestor;
    int message_id;
    int num_params;
    parm_node *parm;
@@ -426,23 +600,19 @@ static int numExecuted;
 void SendClassMessage(object_node *object)
 {
    class_node *c = GetClassByID(object->class_id);
-   do
+   if (IsClassDescendant(c,classMsg.ancestor))
    {
-      if (c->class_id == classMsg.class_id)
-      {
-         SendBlakodMessage(object->object_id,classMsg.message_id,
-                           classMsg.num_params,classMsg.parm);
-         numExecuted++;
-         return;
-      }
-      c = c->super_ptr;
-   } while (c != NULL);
+      SendBlakodMessage(object->object_id,classMsg.message_id,
+                        classMsg.num_params,classMsg.parm);
+      numExecuted++;
+   }
 }
 
 int SendBlakodClassMessage(int class_id,int message_id,int num_params,parm_node parm[])
 {
    numExecuted = 0;
    classMsg.class_id = class_id;
+   classMsg.ancestor = GetClassByID(class_id);
    classMsg.message_id = message_id;
    classMsg.num_params = num_params;
    classMsg.parm = parm;
@@ -450,8 +620,51 @@ int SendBlakodClassMessage(int class_id,int message_id,int num_params,parm_node
    return numExecuted;
 }
 
+/* Used by C functions (C_SendMessage) to get the inline cache of the call
+   site that invoked them.  Only valid before the C function sends anything. */
+send_cache_type * GetCallSendCache(void)
+{
+   if (current_call == NULL)
+      return NULL;
+   return &current_call->send_cache;
+}
+
+/* Work out, once per send site and handler, which of the site's named
+   parameters fills each of the handler's parameters. */
+void BindCacheParms(send_cache_type *cache,int num_sent_parms,parm_node sent_parms[])
+{
+   kod_code *code;
+   int i,j;
+
+   cache->num_bound = -1;
+   code = cache->m->code;
+   if (code == NULL || code->num_parms > MAX_BOUND_PARMS)
+      return;
+
+   for (i = 0; i < code->num_parms; i++)
+   {
+      cache->bound_parm[i] = -1;
+      for (j = 0; j < num_sent_parms; j++)
+         if (sent_parms[j].name_id == code->parm_ids[i])
+         {
+            cache->bound_parm[i] = j;
+            break;
+         }
+   }
+   cache->num_bound = code->num_parms;
+}
+
 /* returns the return value of the blakod */
 int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[])
+{
+   return SendBlakodMessageCached(object_id,message_id,num_parms,parms,NULL);
+}
+
+/* Same as SendBlakodMessage, but if cache is not NULL, it remembers the
+   handler found for the last (class, message) sent from one call site, so
+   a repeated send skips the class and message lookups entirely. */
+int SendBlakodMessageCached(int object_id,int message_id,int num_parms,parm_node parms[],
+                            send_cache_type *cache)
 {
    object_node *o;
    class_node *c,*propagate_class;
@@ -460,6 +673,7 @@ int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms
    
    int prev_interpreting_class;
    char *prev_bkod;
+   const signed char *bound_parm;
 
    int propagate_depth = 0;
 
@@ -473,21 +687,41 @@ int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms
       return NIL;
    }
 
-   c = GetClassByID(o->class_id);
-   if (c == NULL)
+   bound_parm = NULL;
+   if (cache != NULL && cache->class_id == o->class_id && cache->message_id == message_id)
    {
-      eprintf("SendBlakodMessage OBJECT %i can't find CLASS %i\n",
-         object_id,o->class_id);
-      return NIL;
+      m = cache->m;
+      c = cache->found_class;
+      if (cache->num_bound >= 0)
+         bound_parm = cache->bound_parm;
    }
+   else
+   {
+      c = GetClassByID(o->class_id);
+      if (c == NULL)
+      {
+         eprintf("SendBlakodMessage OBJECT %i can't find CLASS %i\n",
+            object_id,o->class_id);
+         return NIL;
+      }
 
-   m = GetMessageByID(c->class_id,message_id,&c);
+      m = GetMessageByID(c->class_id,message_id,&c);
 
-   if (m == NULL)
-   {
-      bprintf("SendBlakodMessage CLASS %s (%i) OBJECT %i can't find a handler for MESSAGE %s (%i)\n",
-         c->class_name,c->class_id,object_id,GetNameByID(message_id),message_id);
-      return NIL;
+      if (m == NULL)
+      {
+         bprintf("SendBlakodMessage CLASS %s (%i) OBJECT %i can't find a handler for MESSAGE %s (%i)\n",
+            c->class_name,c->class_id,object_id,GetNameByID(message_id),message_id);
+         return NIL;
+      }
+
+      if (cache != NULL)
+      {
+         cache->class_id = o->class_id;
+         cache->message_id = message_id;
+         cache->m = m;
+         cache->found_class = c;
+         BindCacheParms(cache,num_parms,parms);
+      }
    }
 
    kod_stat.num_messages++;
@@ -530,9 +764,12 @@ int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms
 
    propagate_depth = 1;
 
-   while (InterpretAtMessage(object_id,c,m,num_parms,parms,&message_ret) 
+   while (InterpretAtMessage(object_id,c,m,num_parms,parms,bound_parm,&message_ret) 
       == RETURN_PROPAGATE)
    {
+      /* the binding is only for the handler the cache found */
+      bound_parm = NULL;
+
       propagate_class = m->propagate_class;
       m = m->propagate_message;
 
@@ -591,6 +828,70 @@ int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms
    return message_ret.int_val;
 }
 
+/* Called when num_interpreted passes interpret_limit.  Returns True if
+   the handler has run away and must be stopped, otherwise takes a profile
+   sample and sets the next limit. */
+Bool InterpretLimitReached(void)
+{
+   if (num_interpreted > MAX_BLAKOD_STATEMENTS)
+      return True;
+
+   TakeProfileSample();
+   SetInterpretLimit();
+   return False;
+}
+
+void SetInterpretLimit(void)
+{
+   interpret_limit = MAX_BLAKOD_STATEMENTS;
+   if (IsKodProfiling() && num_interpreted < MAX_BLAKOD_STATEMENTS - GetKodProfileInterval())
+      interpret_limit = num_interpreted + GetKodProfileInterval();
+}
+
+/* start counting instructions for a new top level message, keeping the
+   distance to the next profile sample */
+void ResetNumInterpreted(void)
+{
+   if (interpret_limit < MAX_BLAKOD_STATEMENTS)
+      interpret_limit = std::max(interpret_limit - num_interpreted,1);
+   num_interpreted = 0;
+}
+
+void TakeProfileSample(void)
+{
+   profile_frame frames[MAX_PROFILE_DEPTH];
+   class_node *c;
+   char *bp;
+   int i,depth,first;
+
+   if (!IsKodProfiling() || message_depth <= 0)
+      return;
+
+   /* keep the innermost frames of deep stacks, with a marker frame in
+      place of the outer ones */
+   depth = 0;
+   first = 0;
+   if (message_depth > MAX_PROFILE_DEPTH)
+   {
+      frames[depth].class_id = INVALID_CLASS;
+      frames[depth].message_id = INVALID_ID;
+      frames[depth].line = 0;
+      depth++;
+      first = message_depth - (MAX_PROFILE_DEPTH - 1);
+   }
+   for (i=first;i<message_depth;i++,depth++)
+   {
+      frames[depth].class_id = stack[i].class_id;
+      frames[depth].message_id = stack[i].message_id;
+
+      /* for current frame, stack[] has pointer at beginning of function */
+      bp = (i == message_depth-1) ? bkod : stack[i].bkod_ptr;
+      c = GetClassByID(stack[i].class_id);
+      frames[depth].line = (c != NULL && bp != NULL) ? GetSourceLine(c,bp) : 0;
+   }
+   AddKodProfileSample(depth,frames);
+}
+
 /* interpret code below here */
 
 #define get_byte() (*bkod++)
@@ -607,8 +908,8 @@ __inline unsigned int get_int()
 * then the return value in ret_val is good.
 */
 int InterpretAtMessage(int object_id,class_node* c,message_node* m,
-                  int num_sent_parms,
-                  parm_node sent_parms[],val_type *ret_val)
+                  int num_sent_parms,parm_node sent_parms[],
+                  const signed char *bound_parm,val_type *ret_val)
 {
    int parm_id;
    int i, j;
@@ -618,6 +919,9 @@ int InterpretAtMessage(int object_id,class_node* c,message_node* m,
    char num_locals, num_parms;
    Bool found_parm;
 
+   if (m->code != NULL)
+      return InterpretCode(object_id,c,m,num_sent_parms,sent_parms,bound_parm,ret_val);
+
    // Time messages.
    if (kod_stat.debugtime)
       startTime = GetMicroCountDouble();
@@ -676,7 +980,7 @@ int InterpretAtMessage(int object_id,class_node* c,message_node* m,
    for(;;)         /* returns when gets a blakod return */
    {
       /* infinite loop check */
-      if (++num_interpreted > MAX_BLAKOD_STATEMENTS)
+      if (++num_interpreted > interpret_limit && InterpretLimitReached())
       {
          bprintf("InterpretAtMessage interpreted too many instructions--infinite loop?\n");
 
@@ -1186,6 +1490,8 @@ void InterpretCall(int object_id,local_var_type *local_vars,opcode_type opcode)
       name_parm_array[i].value = name_val.int_val;
    }
 
+   current_call = NULL;
+
    // Time messages.
    if (kod_stat.debugtime)
    {
@@ -1215,6 +1521,493 @@ void InterpretCall(int object_id,local_var_type *local_vars,opcode_type opcode)
    }
 }
 
+/* InterpretCode executes the pre-decoded form of a message handler, built
+   by TranslateBkod in loadkod.c.  Same semantics and return values as
+   InterpretAtMessage.  Called with m == NULL only to fill in
+   kod_inst_labels. */
+
+/* Operand access for verified code (see VerifyBkodCode): indices are known
+   to be in range, so locals and self's properties are read and written
+   directly.  self_props is NULL if self is gone, and then we go the
+   checked way so the error is reported as before. */
+
+__inline prop_type * GetSelfProps(int object_id)
+{
+   object_node *o;
+
+   o = GetObjectByIDQuietly(object_id);
+   return o ? o->p : NULL;
+}
+
+__inline val_type RetrieveVerified(int object_id,local_var_type *local_vars,
+                                   prop_type *self_props,int data_type,int data)
+{
+   if (data_type == LOCAL_VAR)
+      return local_vars->locals[data];
+   if (data_type == PROPERTY && self_props != NULL)
+      return self_props[data].val;
+   return RetrieveValue(object_id,local_vars,data_type,data);
+}
+
+__inline void StoreVerified(int object_id,local_var_type *local_vars,
+                            prop_type *self_props,int data_type,int data,val_type new_data)
+{
+   if (data_type == LOCAL_VAR)
+      local_vars->locals[data] = new_data;
+   else if (data_type == PROPERTY && self_props != NULL)
+      self_props[data].val = new_data;
+   else
+      StoreValue(object_id,local_vars,data_type,data,new_data);
+}
+
+#define FETCH(type,data) RetrieveVerified(object_id,&local_vars,self_props,type,data)
+#define STORE(type,data,val) StoreVerified(object_id,&local_vars,self_props,type,data,val)
+
+#ifdef THREADED_DISPATCH
+#define KOD_OP(op) label_##op:
+#define DISPATCH() \
+   if (++num_interpreted > interpret_limit && InterpretLimitReached()) \
+      goto infinite_loop; \
+   bkod = ip->bkod; \
+   goto *ip->handler
+#else
+#define KOD_OP(op) case op:
+#define DISPATCH() goto dispatch
+#endif
+
+#define NEXT_INST() { ++ip; DISPATCH(); }
+
+#define CHECK_INT(val,what) \
+   if ((val).v.tag != TAG_INT) \
+   { \
+      bprintf("InterpretUnaryAssign can't " what " non-int %i,%i\n", \
+         (val).v.tag,(val).v.data); \
+      goto unary_store; \
+   }
+
+#define CHECK_INTS(what) \
+   if (source1_data.v.tag != TAG_INT || source2_data.v.tag != TAG_INT) \
+   { \
+      bprintf("InterpretBinaryAssign can't " what " 2 vars %i,%i and %i,%i\n", \
+         source1_data.v.tag,source1_data.v.data, \
+         source2_data.v.tag,source2_data.v.data); \
+      goto binary_store; \
+   }
+
+int InterpretCode(int object_id,class_node* c,message_node* m,
+                  int num_sent_parms,parm_node sent_parms[],
+                  const signed char *bound_parm,val_type *ret_val)
+{
+   kod_code *code;
+   kod_inst *ip;
+   prop_type *self_props;
+   int i, j, k;
+   double startTime;
+   local_var_type local_vars;
+   val_type source1_data, source2_data;
+
+#ifdef THREADED_DISPATCH
+   static const void *labels[NUM_KI_OPS] =
+   {
+      &&label_KI_NOT, &&label_KI_NEGATE, &&label_KI_NONE, &&label_KI_BITWISE_NOT,
+      &&label_KI_POST_INCREMENT, &&label_KI_POST_DECREMENT,
+      &&label_KI_PRE_INCREMENT, &&label_KI_PRE_DECREMENT,
+
+      &&label_KI_ADD, &&label_KI_SUBTRACT, &&label_KI_MULTIPLY, &&label_KI_DIV,
+      &&label_KI_MOD, &&label_KI_AND, &&label_KI_OR, &&label_KI_EQUAL,
+      &&label_KI_NOT_EQUAL, &&label_KI_LESS_THAN, &&label_KI_GREATER_THAN,
+      &&label_KI_LESS_EQUAL, &&label_KI_GREATER_EQUAL,
+      &&label_KI_BITWISE_AND, &&label_KI_BITWISE_OR,
+
+      &&label_KI_GOTO, &&label_KI_GOTO_IF_TRUE, &&label_KI_GOTO_IF_FALSE,
+      &&label_KI_CALL, &&label_KI_RETURN, &&label_KI_PROPAGATE,
+   };
+
+   if (m == NULL)
+   {
+      kod_inst_labels = labels;
+      return RETURN_NONE;
+   }
+#endif
+
+   // Time messages.
+   if (kod_stat.debugtime)
+      startTime = GetMicroCountDouble();
+
+   code = m->code;
+   local_vars.num_locals = code->num_locals + code->num_parms;
+
+   if (bound_parm != NULL)
+   {
+      for (i = 0; i < code->num_parms; i++)
+         local_vars.locals[i].int_val = (bound_parm[i] < 0) ?
+            code->parm_defaults[i].int_val : sent_parms[bound_parm[i]].value;
+   }
+   else
+   {
+      /* Both lists are normally sorted, so start each search just past the
+         last match; a full lap means the parm wasn't sent. */
+      j = 0;
+      for (i = 0; i < code->num_parms; i++)
+      {
+         local_vars.locals[i].int_val = code->parm_defaults[i].int_val;
+         for (k = 0; k < num_sent_parms; k++)
+         {
+            if (sent_parms[j].name_id == code->parm_ids[i])
+            {
+               local_vars.locals[i].int_val = sent_parms[j].value;
+               if (++j == num_sent_parms)
+                  j = 0;
+               break;
+            }
+            if (++j == num_sent_parms)
+               j = 0;
+         }
+      }
+   }
+
+   // Init all non-parm locals to NIL
+   for (;i < local_vars.num_locals; ++i)
+      local_vars.locals[i].int_val = NIL;
+
+   self_props = GetSelfProps(object_id);
+
+   ip = code->inst;
+   DISPATCH();
+
+#ifndef THREADED_DISPATCH
+dispatch:
+   if (++num_interpreted > interpret_limit && InterpretLimitReached())
+      goto infinite_loop;
+   bkod = ip->bkod;
+
+   switch (ip->op)
+   {
+#endif
+
+   /* unary assign */
+
+   KOD_OP(KI_NOT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"not");
+      source1_data.v.data = !source1_data.v.data;
+      goto unary_store;
+
+   KOD_OP(KI_NEGATE)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"negate");
+      source1_data.v.data = -source1_data.v.data;
+      goto unary_store;
+
+   KOD_OP(KI_NONE)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      goto unary_store;
+
+   KOD_OP(KI_BITWISE_NOT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"bitwise not");
+      source1_data.v.data = ~source1_data.v.data;
+      goto unary_store;
+
+   KOD_OP(KI_POST_INCREMENT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"post-increment");
+      if (ip->source1 != ip->dest)
+         STORE(ip->dest_type,ip->dest,source1_data);
+      ++source1_data.v.data;
+      STORE(ip->dest_type,ip->source1,source1_data);
+      NEXT_INST();
+
+   KOD_OP(KI_POST_DECREMENT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"post-decrement");
+      if (ip->source1 != ip->dest)
+         STORE(ip->dest_type,ip->dest,source1_data);
+      --source1_data.v.data;
+      STORE(ip->dest_type,ip->source1,source1_data);
+      NEXT_INST();
+
+   KOD_OP(KI_PRE_INCREMENT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"pre-increment");
+      ++source1_data.v.data;
+      if (ip->source1 != ip->dest)
+         STORE(ip->dest_type,ip->source1,source1_data);
+      goto unary_store;
+
+   KOD_OP(KI_PRE_DECREMENT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      CHECK_INT(source1_data,"pre-decrement");
+      --source1_data.v.data;
+      if (ip->source1 != ip->dest)
+         STORE(ip->dest_type,ip->source1,source1_data);
+      goto unary_store;
+
+unary_store:
+   STORE(ip->dest_type,ip->dest,source1_data);
+   NEXT_INST();
+
+   /* binary assign */
+
+   KOD_OP(KI_ADD)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("add");
+      source1_data.v.data += source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_SUBTRACT)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("sub");
+      source1_data.v.data -= source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_MULTIPLY)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("mult");
+      source1_data.v.data *= source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_DIV)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("div");
+      if (source2_data.v.data == 0)
+      {
+         bprintf("InterpretBinaryAssign can't div by 0\n");
+         goto binary_store;
+      }
+      source1_data.v.data /= source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_MOD)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("mod");
+      if (source2_data.v.data == 0)
+      {
+         bprintf("InterpretBinaryAssign can't mod 0\n");
+         goto binary_store;
+      }
+      source1_data.v.data = abs(source1_data.v.data % source2_data.v.data);
+      goto binary_store;
+
+   KOD_OP(KI_AND)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("and");
+      source1_data.v.data = source1_data.v.data && source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_OR)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("or");
+      source1_data.v.data = source1_data.v.data || source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_EQUAL)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      if (source1_data.v.tag != source2_data.v.tag)
+         source1_data.v.data = False;
+      else
+         source1_data.v.data = source1_data.v.data == source2_data.v.data;
+      source1_data.v.tag = TAG_INT;
+      goto binary_store;
+
+   KOD_OP(KI_NOT_EQUAL)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      if (source1_data.v.tag != source2_data.v.tag)
+         source1_data.v.data = True;
+      else
+         source1_data.v.data = source1_data.v.data != source2_data.v.data;
+      source1_data.v.tag = TAG_INT;
+      goto binary_store;
+
+   KOD_OP(KI_LESS_THAN)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("<");
+      source1_data.v.data = source1_data.v.data < source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_GREATER_THAN)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS(">");
+      source1_data.v.data = source1_data.v.data > source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_LESS_EQUAL)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("<=");
+      source1_data.v.data = source1_data.v.data <= source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_GREATER_EQUAL)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS(">=");
+      source1_data.v.data = source1_data.v.data >= source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_BITWISE_AND)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("and");
+      source1_data.v.data = source1_data.v.data & source2_data.v.data;
+      goto binary_store;
+
+   KOD_OP(KI_BITWISE_OR)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      source2_data = FETCH(ip->source2_type,ip->source2);
+      CHECK_INTS("or");
+      source1_data.v.data = source1_data.v.data | source2_data.v.data;
+      goto binary_store;
+
+binary_store:
+   STORE(ip->dest_type,ip->dest,source1_data);
+   NEXT_INST();
+
+   /* flow control */
+
+   KOD_OP(KI_GOTO)
+      ip = ip->target;
+      DISPATCH();
+
+   KOD_OP(KI_GOTO_IF_TRUE)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      if (source1_data.v.data != 0)
+      {
+         ip = ip->target;
+         DISPATCH();
+      }
+      NEXT_INST();
+
+   KOD_OP(KI_GOTO_IF_FALSE)
+      source1_data = FETCH(ip->source1_type,ip->source1);
+      if (source1_data.v.data == 0)
+      {
+         ip = ip->target;
+         DISPATCH();
+      }
+      NEXT_INST();
+
+   KOD_OP(KI_CALL)
+      InterpretCodeCall(object_id,&local_vars,self_props,ip->call);
+      /* the call may have deleted self, which frees its properties */
+      self_props = GetSelfProps(object_id);
+      NEXT_INST();
+
+   KOD_OP(KI_RETURN)
+      if (kod_stat.debugtime)
+      {
+         m->total_call_time += (GetMicroCountDouble() - startTime);
+         m->timed_call_count++;
+      }
+      else
+         m->untimed_call_count++;
+      *ret_val = FETCH(ip->source1_type,ip->source1);
+      return RETURN_NO_PROPAGATE;
+
+   KOD_OP(KI_PROPAGATE)
+      if (kod_stat.debugtime)
+      {
+         m->total_call_time += (GetMicroCountDouble() - startTime);
+         m->timed_call_count++;
+      }
+      else
+         m->untimed_call_count++;
+      return RETURN_PROPAGATE;
+
+#ifndef THREADED_DISPATCH
+   default :
+      /* TranslateBkod only emits valid ops */
+      bprintf("InterpretCode found INVALID OP %i.  die.\n",ip->op);
+      FlushDefaultChannels();
+      (*ret_val).int_val = NIL;
+      return RETURN_NO_PROPAGATE;
+   }
+#endif
+
+infinite_loop:
+   bprintf("InterpretAtMessage interpreted too many instructions--infinite loop?\n");
+
+   dprintf("Infinite loop at depth %i\n", message_depth);
+   dprintf("  OBJECT %i CLASS %s MESSAGE %s (%s) aborting and returning NIL\n",
+      object_id,
+      c? c->class_name : "(unknown)",
+      GetNameByID(m->message_id),
+      BlakodDebugInfo());
+
+   dprintf("  Local variables:\n");
+   for (i=0;i<local_vars.num_locals;i++)
+   {
+      dprintf("  %3i : %s %5i\n", i,
+         GetTagName(local_vars.locals[i]),
+         local_vars.locals[i].v.data);
+   }
+
+   (*ret_val).int_val = NIL;
+   return RETURN_NO_PROPAGATE;
+}
+
+#undef KOD_OP
+#undef FETCH
+#undef STORE
+#undef DISPATCH
+#undef NEXT_INST
+#undef CHECK_INT
+#undef CHECK_INTS
+
+/* same as InterpretCall, but from an already decoded call */
+void InterpretCodeCall(int object_id,local_var_type *local_vars,prop_type *self_props,
+                       kod_call *call)
+{
+   parm_node name_parm_array[MAX_NAME_PARMS];
+   val_type call_return, name_val;
+   int i;
+
+   for (i=0;i<call->num_name_parms;i++)
+   {
+      name_parm_array[i].name_id = call->name_parms[i].name_id;
+
+      /* translate to literal now, because won't have local vars
+      if nested call to sendmessage again */
+      name_val = RetrieveVerified(object_id,local_vars,self_props,call->name_parms[i].type,
+         call->name_parms[i].value);
+      name_parm_array[i].value = name_val.int_val;
+   }
+
+   current_call = call;
+
+   // Time messages.
+   if (kod_stat.debugtime)
+   {
+      double startTime = GetMicroCountDouble();
+      /* increment timed count of the c function, for profiling info */
+      kod_stat.c_count_timed[call->function]++;
+      call_return.int_val = ccall_table[call->function](object_id, local_vars,
+         call->num_normal_parms, call->normal_parms, call->num_name_parms, name_parm_array);
+      kod_stat.ccall_total_time[call->function] += (GetMicroCountDouble() - startTime);
+   }
+   else
+   {
+      /* increment untimed count of the c function, for profiling info */
+      kod_stat.c_count_untimed[call->function]++;
+      call_return.int_val = ccall_table[call->function](object_id, local_vars,
+         call->num_normal_parms, call->normal_parms, call->num_name_parms, name_parm_array);
+   }
+
+   if (call->assign_type != CALL_NO_ASSIGN)
+      StoreValue(object_id,local_vars,call->assign_type,call->assign_index,call_return);
+}
+
 char *BlakodDebugInfo()
 {
    static char s[100];
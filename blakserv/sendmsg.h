@@ -67,35 +67,71 @@ typedef struct
 
 /* stuff for PostMessage queue */
 
-#define MAX_POST_QUEUE 4000
+/* Posted messages are packed back to back in a chain of segments, each
+   entry holding only the parms it was posted with.  Drained segments go
+   back to a small pool for reuse. */
+#define POST_SEGMENT_SIZE 65536
+#define MAX_POST_POOL 16
 
 typedef struct
 {
    int object_id;
    int message_id;
    int num_parms;
-   parm_node parms[MAX_NAME_PARMS];
+   parm_node parms[1]; /* really num_parms of them */
 } post_node;
 
+#define PostNodeSize(num_parms) (offsetof(post_node,parms) + (num_parms)*sizeof(parm_node))
+
+typedef struct post_segment_struct
+{
+   int used; /* bytes of data written */
+   struct post_segment_struct *next;
+   char data[POST_SEGMENT_SIZE];
+} post_segment;
+
 typedef struct
 {
-   int next;
-   int last;
-   post_node data[MAX_POST_QUEUE];
+   post_segment *first; /* oldest, being drained from read */
+   int read;
+   post_segment *last;  /* newest, being written */
+   post_segment *pool;
+   int num_pool;
+   int depth;           /* entries waiting */
 } post_queue_type;
 
+typedef struct
+{
+   double num_posted;
+   int depth_highest;
+   int segments_used;      /* in the queue or the pool */
+   int segments_highest;
+   double num_drains;      /* top level messages that ran posts */
+   double drain_time;      /* microseconds spent running posts */
+   int drain_time_highest;
+   std::vector<int> by_class; /* posts made by each class id */
+} post_stat_type;
+
 void InitProfiling(void);
 void InitTimeProfiling(void);
 void EndTimeProfiling(void);
 void InitBkodInterpret(void);
 kod_statistics * GetKodStats(void);
+post_stat_type * GetPostStats(void);
+int GetPostQueueDepth(void);
+int GetMessageDepth(void);
 char * GetBkodPtr(void);
 Bool IsInterpreting(void);
+const void * GetKodInstHandler(int op);
+void SetInterpretLimit(void);
 
 void PostBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[]);
 
 int SendTopLevelBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[]);
 int SendBlakodMessage(int object_id,int message_id,int num_parms,parm_node parms[]);
+int SendBlakodMessageCached(int object_id,int message_id,int num_parms,parm_node parms[],
+                            send_cache_type *cache);
+send_cache_type * GetCallSendCache(void);
 int SendBlakodClassMessage(int class_id,int message_id,int num_params,parm_node parm[]);
 char *BlakodDebugInfo(void);
 char *BlakodStackInfo(void);
@@ -14,6 +14,12 @@
   reads bytes, and handles changing states.  It also has functions to
   write to the session, either straight up (like admin mode or login
   mode) or with our protocol (for synched and game modes).
+
+  The socket thread looks sessions up by socket on every event, and logins
+  look them up by account, so connected sessions are hashed by both,
+  chained through the session nodes by session id.  The ids of connected
+  sessions are also kept in order in live_sessions, so going through them
+  doesn't look at every slot ever used.
   
 */
 
@@ -25,6 +31,13 @@ unsigned char epoch; /* number to send to game clients as 7th byte in message */
 session_node *sessions;
 int num_sessions;
 
+static int *sessions_by_socket;
+static int *sessions_by_account;
+static unsigned int session_hash_mask;
+
+static int *live_sessions;
+static int num_live_sessions;
+
 int transmitted_bytes; /* keep a tab on bandwidth use */
 
 CRITICAL_SECTION csSessions; /* need to add/remove or search through list of sessions */
@@ -45,6 +58,88 @@ void SendGameClientBufferList(session_node *s,buffer_node *blist,char seqno);
 void SendBufferList(session_node *s,buffer_node *blist);
 void SessionAddBufferList(session_node *s,buffer_node *blist);
 
+static unsigned int GetSessionHash(unsigned int key)
+{
+	key *= 2654435761u;
+	return (key ^ (key >> 16)) & session_hash_mask;
+}
+
+/* sessions are hashed by their account node, not its id, since
+   CompactAccounts can renumber accounts of connected sessions */
+static unsigned int GetSessionAccountHash(account_node *a)
+{
+	return GetSessionHash((unsigned int)((size_t)a >> 4));
+}
+
+static void AddLiveSession(int session_id)
+{
+	int i;
+	
+	i = num_live_sessions;
+	while (i > 0 && live_sessions[i-1] > session_id)
+	{
+		live_sessions[i] = live_sessions[i-1];
+		i--;
+	}
+	live_sessions[i] = session_id;
+	num_live_sessions++;
+}
+
+static void RemoveLiveSession(int session_id)
+{
+	int i;
+	
+	for (i=0;i<num_live_sessions;i++)
+		if (live_sessions[i] == session_id)
+			break;
+	if (i == num_live_sessions)
+		return;
+	
+	num_live_sessions--;
+	for (;i<num_live_sessions;i++)
+		live_sessions[i] = live_sessions[i+1];
+}
+
+static void HashSessionSocket(session_node *s)
+{
+	int *link;
+	
+	link = &sessions_by_socket[GetSessionHash((unsigned int)s->conn.socket)];
+	s->next_by_socket = *link;
+	*link = s->session_id;
+}
+
+static void UnhashSessionSocket(session_node *s)
+{
+	int *link;
+	
+	link = &sessions_by_socket[GetSessionHash((unsigned int)s->conn.socket)];
+	while (*link != -1 && *link != s->session_id)
+		link = &sessions[*link].next_by_socket;
+	if (*link != -1)
+		*link = s->next_by_socket;
+}
+
+static void HashSessionAccount(session_node *s)
+{
+	int *link;
+	
+	link = &sessions_by_account[GetSessionAccountHash(s->account)];
+	s->next_by_account = *link;
+	*link = s->session_id;
+}
+
+static void UnhashSessionAccount(session_node *s)
+{
+	int *link;
+	
+	link = &sessions_by_account[GetSessionAccountHash(s->account)];
+	while (*link != -1 && *link != s->session_id)
+		link = &sessions[*link].next_by_account;
+	if (*link != -1)
+		*link = s->next_by_account;
+}
+
 
 /* InitSession
 *
@@ -54,6 +149,8 @@ void SessionAddBufferList(session_node *s,buffer_node *blist);
 */
 void InitSession()
 {
+	int i,hash_size;
+	
 	epoch = 1;
 	transmitted_bytes = 0;
 	
@@ -62,6 +159,24 @@ void InitSession()
 	
 	num_sessions = 0;
 	
+	/* hash tables have a power of 2 buckets, at least one per session */
+	hash_size = 1;
+	while (hash_size < ConfigInt(SESSION_MAX_CONNECT))
+		hash_size *= 2;
+	session_hash_mask = hash_size - 1;
+	
+	sessions_by_socket = (int *)AllocateMemory(MALLOC_ID_SESSION_MODES,hash_size*sizeof(int));
+	sessions_by_account = (int *)AllocateMemory(MALLOC_ID_SESSION_MODES,hash_size*sizeof(int));
+	for (i=0;i<hash_size;i++)
+	{
+		sessions_by_socket[i] = -1;
+		sessions_by_account[i] = -1;
+	}
+	
+	live_sessions = (int *)
+		AllocateMemory(MALLOC_ID_SESSION_MODES,ConfigInt(SESSION_MAX_CONNECT)*sizeof(int));
+	num_live_sessions = 0;
+	
 	if (sizeof(admin_data) > SESSION_STATE_BYTES)
 		FatalError("sizeof(admin_data) must be <= SESSION_STATE_BYTES");
 	
@@ -166,14 +281,39 @@ session_node * GetSessionByID(int session_id)
 		return NULL;
 }
 
+/* if a new login overrides an old one, both can have the account for a
+   while; the lower session id is found, as it always has been */
 session_node * GetSessionByAccount(account_node *a)
 {
+	session_node *found;
 	int i;
 	
-	for (i=0;i<num_sessions;i++)
-		if (sessions[i].connected && sessions[i].account == a)
-			return &sessions[i];
+	if (a == NULL)
 		return NULL;
+	
+	found = NULL;
+	i = sessions_by_account[GetSessionAccountHash(a)];
+	while (i != -1)
+	{
+		if (sessions[i].connected && sessions[i].account == a &&
+			(found == NULL || i < found->session_id))
+			found = &sessions[i];
+		i = sessions[i].next_by_account;
+	}
+	return found;
+}
+
+/* all changes to a session's account should go through here, to keep it
+   hashed by account */
+void SetSessionAccount(session_node *s,account_node *a)
+{
+	if (s->account != NULL)
+		UnhashSessionAccount(s);
+	
+	s->account = a;
+	
+	if (s->account != NULL)
+		HashSessionAccount(s);
 }
 
 /* called from interface thread, so it should make sure it has session lock first */
@@ -181,26 +321,29 @@ session_node * GetSessionBySocket(SOCKET sock)
 {
 	int i;
 	
-	for (i=0;i<num_sessions;i++)
-		if (sessions[i].connected && sessions[i].conn.type == CONN_SOCKET &&
-			sessions[i].conn.socket == sock && sessions[i].hangup == False)
+	i = sessions_by_socket[GetSessionHash((unsigned int)sock)];
+	while (i != -1)
+	{
+		if (sessions[i].connected && sessions[i].conn.socket == sock &&
+			sessions[i].hangup == False)
 		{
 			return &sessions[i];
 		}
-		
-		return NULL;
+		i = sessions[i].next_by_socket;
+	}
+	
+	return NULL;
 }
 
 void ForEachSession(void (*callback_func)(session_node *s))
 {
 	int i;
 	
-	/* the callback function shouldn't delete the session,
-	in case it becomes a linked list */
+	/* the callback function shouldn't delete the session, since that
+	takes it out of live_sessions */
 	
-	for (i=0;i<num_sessions;i++)
-		if (sessions[i].connected)
-			callback_func(&sessions[i]);
+	for (i=0;i<num_live_sessions;i++)
+		callback_func(&sessions[live_sessions[i]]);
 }
 /*
 int GetUsedSessions()
@@ -388,6 +531,10 @@ session_node * CreateSession(connection_node conn)
 	session->connected = True;
 	session->connected_time = GetTime();
 	
+	AddLiveSession(session->session_id);
+	if (conn.type == CONN_SOCKET)
+		HashSessionSocket(session);
+	
 	/* dprintf("CreateSession making session %i\n",session->session_id); */
 	
 	InterfaceLogon(session);
@@ -423,6 +570,10 @@ void CloseSession(int session_id)
 	
 	s->connected = False;
 	
+	RemoveLiveSession(s->session_id);
+	if (s->conn.type == CONN_SOCKET)
+		UnhashSessionSocket(s);
+	
 	if (!s->exiting_state)	/* if a write error occurred during an exit, don't */
 		ExitSessionState(s);	/* go into infinite loop */
 	
@@ -436,7 +587,7 @@ void CloseSession(int session_id)
 			lprintf("CloseSession/4 logging off %i\n",s->account->account_id);
 	}
 	
-	s->account = NULL;
+	SetSessionAccount(s,NULL);
 	
 	InterfaceLogoff(s);
 	
@@ -514,9 +665,10 @@ void CloseAllSessions()
 {
 	int i;
 	
-	for (i=0;i<num_sessions;i++)
-		if (sessions[i].connected)
-			CloseSession(i);
+	/* each close takes the session out of live_sessions */
+	for (i=num_live_sessions-1;i>=0;i--)
+		if (i < num_live_sessions)
+			CloseSession(live_sessions[i]);
 }
 
 void PollSessions()
@@ -528,9 +680,14 @@ void PollSessions()
 	
 	ProcessSysTimer(poll_time);
 	
-	for (i=0;i<num_sessions;i++)
+	/* backwards, since polling can close sessions and take them out of
+	live_sessions; that can only move later ones down */
+	for (i=num_live_sessions-1;i>=0;i--)
 	{
-		s = GetSessionByID(i);
+		if (i >= num_live_sessions)
+			continue;
+		
+		s = GetSessionByID(live_sessions[i]);
 		if (s == NULL)
 			continue;
 		
@@ -84,6 +84,8 @@ typedef struct
    };
 
    account_node *account;
+   int next_by_socket;		/* hash chains in session.c, by session id, */
+   int next_by_account;		/* -1 at the end */
    Bool login_verified;         /* Portal said they're ok */
    Bool blak_client;		/* if they are running our client */
 
@@ -168,6 +170,7 @@ void SendBytes(session_node *s,char *buf,int len_buf);
 void InitSessionState(session_node *s,int state);
 session_node * CreateSession(connection_node conn);
 session_node *GetSessionByAccount(account_node *a);
+void SetSessionAccount(session_node *s,account_node *a);
 session_node * GetSessionBySocket(SOCKET sock);
 void ForEachSession(void (*callback_func)(session_node *s));
 int GetUsedSessions(void);
@@ -9,49 +9,80 @@
  * string.c
  *
 
- This module maintains a dynamically sized array with the string nodes
- for the Blakod.  It also has a temp string, for things from the
- client like say commands which are not stored by the Blakod.
+ This module maintains a dynamically sized array (a chunk_array) with
+ the string nodes for the Blakod.  It also has a temp string, for things
+ from the client like say commands which are not stored by the Blakod.
+
+ The characters of a string live in a string body, which is reference
+ counted and never changed once made.  Setting a string gives its node a
+ new body, so string nodes can share bodies freely.  When InternStrings
+ is on, bodies are also kept in a hash table by contents and a new string
+ with the same characters as an existing one shares its body, so copies
+ of the same name or chat line take the memory of one.  Bodies also keep
+ the hash and trimmed length the fuzzy string compares use, so comparing
+ strings that share a body, or whose hashes differ, skips the bytes.
 
  */
 
 #include "blakserv.h"
 
-string_node *strings;
-int num_strings,max_strings;
+chunk_array<string_node> strings;
+int num_strings;
 
 /* this is for say commands, which are not saved */
 string_node temp_str;
 
+/* interned string bodies, chained through next */
+static string_body **intern_table;
+static int intern_table_size;
+static int num_interned;
+static int num_string_bodies;
+
+#define INIT_INTERN_TABLE_SIZE 4096
+#define iswhite(c) ((c)==' ' || (c)=='\t' || (c)=='\n' || (c)=='\r')
+
 /* local function prototypes */
 int AllocateString();
+string_body * AllocateStringBody(int len);
+string_body * InternStringBody(string_body *b);
+void ReleaseStringBody(string_body *b);
+void SetStringNodeBody(string_node *snod,string_body *b);
+void ResizeInternTable(void);
+
+/* The ELF hash is weak in its low bits, so mix it before masking. */
+static inline int GetInternIndex(unsigned int hash,int size)
+{
+   hash *= 2654435769U;
+   return (int)((hash ^ (hash >> 15)) & (unsigned int)(size - 1));
+}
 
 void InitString()
 {
    num_strings = 0;
-   max_strings = INIT_STRING_NODES;
-   strings = (string_node *)AllocateMemory(MALLOC_ID_STRING,max_strings*sizeof(string_node));
+   strings.Init(MALLOC_ID_STRING,INIT_STRING_NODES);
+
+   intern_table_size = INIT_INTERN_TABLE_SIZE;
+   intern_table = (string_body **)AllocateMemoryCalloc(MALLOC_ID_STRING,
+      intern_table_size,sizeof(string_body *));
+   num_interned = 0;
+   num_string_bodies = 0;
 
    /* allocate max client bytes for temp string because max string len is < this */
    temp_str.data = (char *)AllocateMemory(MALLOC_ID_STRING,LEN_TEMP_STRING+1);
    temp_str.len_data = 0;
    temp_str.data[temp_str.len_data] = '\0';
+   temp_str.body = NULL;
 }
 
 void ResetString()
 {
-   int i,old_strings;
+   int i;
 
    for (i=0;i<num_strings;i++)
-      if (strings[i].data)
-         FreeMemory(MALLOC_ID_STRING,strings[i].data,strings[i].len_data+1);
+      SetStringNodeBody(&strings[i],NULL);
 
-   old_strings = max_strings;
    num_strings = 0;  
-   max_strings = INIT_STRING_NODES;
-   strings = (string_node *)
-      ResizeMemory(MALLOC_ID_STRING,strings,old_strings*sizeof(string_node),
-		   max_strings*sizeof(string_node));
+   strings.Shrink(INIT_STRING_NODES);
 }
 
 int GetStringsUsed()
@@ -59,26 +90,159 @@ int GetStringsUsed()
    return num_strings;
 }
 
-int AllocateString()
+int GetStringBodiesUsed(void)
 {
-   int old_strings;
+   return num_string_bodies;
+}
 
-   if (num_strings == max_strings)
-   {
-      old_strings = max_strings;
-      max_strings = max_strings * 2;
-      strings = (string_node *)
-	 ResizeMemory(MALLOC_ID_STRING,strings,old_strings*sizeof(string_node),
-		      max_strings*sizeof(string_node));      
-      lprintf("AllocateStringNode resized to %i string nodes\n",max_strings);
-   }
+int GetStringBodiesInterned(void)
+{
+   return num_interned;
+}
+
+int AllocateString()
+{
+   if (num_strings == strings.Capacity())
+      strings.Grow(num_strings + 1);
 
    strings[num_strings].data = NULL;
    strings[num_strings].len_data = 0;
+   strings[num_strings].body = NULL;
    
    return num_strings++;
 }
 
+/* string bodies, see the top of the file */
+
+/* a body with room for len characters, which the caller fills in */
+string_body * AllocateStringBody(int len)
+{
+   string_body *b;
+
+   b = (string_body *)AllocateMemory(MALLOC_ID_STRING,sizeof(string_body) + len);
+   b->refs = 1;
+   b->len = len;
+   b->interned = False;
+   b->next = NULL;
+   b->data[len] = '\0';
+   num_string_bodies++;
+   return b;
+}
+
+/* Work out the hashes of a filled in body, and if interning is on, return
+   the interned body with the same characters instead when there is one. */
+string_body * InternStringBody(string_body *b)
+{
+   string_body *ib;
+   const char *s;
+   const char *nul;
+   int len, index;
+
+   b->hash = GetBufferHash(b->data,b->len);
+
+   /* the same hash GetTableHash() computes: trim the whitespace, then
+      stop at any null, like FuzzyCollapseString() and strlen() would */
+   s = b->data;
+   len = b->len;
+   while (len && iswhite(*s)) { s++; len--; }
+   while (len && iswhite(s[len-1])) { len--; }
+   b->fuzzy_len = len;
+   nul = (const char *)memchr(s,'\0',len);
+   b->fuzzy_hash = GetBufferHash(s,nul ? (int)(nul - s) : len);
+
+   if (ConfigBool(MEMORY_INTERN_STRINGS) == False)
+      return b;
+
+   index = GetInternIndex(b->hash,intern_table_size);
+   for (ib = intern_table[index]; ib != NULL; ib = ib->next)
+   {
+      if (ib->hash == b->hash && ib->len == b->len &&
+          memcmp(ib->data,b->data,b->len) == 0)
+      {
+         ib->refs++;
+         FreeMemory(MALLOC_ID_STRING,b,sizeof(string_body) + b->len);
+         num_string_bodies--;
+         return ib;
+      }
+   }
+
+   b->interned = True;
+   b->next = intern_table[index];
+   intern_table[index] = b;
+   num_interned++;
+   if (num_interned > intern_table_size)
+      ResizeInternTable();
+   return b;
+}
+
+void ResizeInternTable(void)
+{
+   string_body **new_table,*b,*next;
+   int new_size,index;
+
+   new_size = intern_table_size * 2;
+   new_table = (string_body **)AllocateMemoryCalloc(MALLOC_ID_STRING,new_size,
+      sizeof(string_body *));
+   for (int i = 0; i < intern_table_size; ++i)
+   {
+      for (b = intern_table[i]; b != NULL; b = next)
+      {
+         next = b->next;
+         index = GetInternIndex(b->hash,new_size);
+         b->next = new_table[index];
+         new_table[index] = b;
+      }
+   }
+   FreeMemory(MALLOC_ID_STRING,intern_table,intern_table_size*sizeof(string_body *));
+   intern_table = new_table;
+   intern_table_size = new_size;
+}
+
+void ReleaseStringBody(string_body *b)
+{
+   string_body **link;
+
+   if (b == NULL)
+      return;
+
+   if (--b->refs > 0)
+      return;
+
+   if (b->interned)
+   {
+      link = &intern_table[GetInternIndex(b->hash,intern_table_size)];
+      while (*link != NULL && *link != b)
+         link = &(*link)->next;
+      if (*link == NULL)
+         eprintf("ReleaseStringBody can't find interned body %.40s\n",b->data);
+      else
+      {
+         *link = b->next;
+         num_interned--;
+      }
+   }
+
+   FreeMemory(MALLOC_ID_STRING,b,sizeof(string_body) + b->len);
+   num_string_bodies--;
+}
+
+/* give snod the body b, which it takes over a reference to */
+void SetStringNodeBody(string_node *snod,string_body *b)
+{
+   ReleaseStringBody(snod->body);
+   snod->body = b;
+   if (b == NULL)
+   {
+      snod->data = NULL;
+      snod->len_data = 0;
+   }
+   else
+   {
+      snod->data = b->data;
+      snod->len_data = b->len;
+   }
+}
+
 string_node *GetStringByID(int string_id)
 {
    if (string_id < 0 || string_id >= num_strings)
@@ -105,23 +269,21 @@ int CreateString(const char *new_str)
 int CreateStringWithLen(const char *buf,int len)
 {
    int string_id;
-   string_node *snod;
+   string_body *b;
    
    /* note:  new_str is NOT null-terminated */
    string_id = AllocateString();
-   snod = GetStringByID(string_id);
 
-   snod->data = (char *)AllocateMemory(MALLOC_ID_STRING,len+1);
-   memcpy(snod->data,buf,len);
-   snod->len_data = len;
-   snod->data[snod->len_data] = '\0';
+   b = AllocateStringBody(len);
+   memcpy(b->data,buf,len);
+   SetStringNodeBody(GetStringByID(string_id),InternStringBody(b));
    
    return string_id;
 }
 
 Bool LoadBlakodString(FILE *f,int len_str,int string_id)
 {
-   string_node *snod;
+   string_body *b;
 
    /* note:  new_str is not a null-terminated string */
    if (AllocateString() != string_id)
@@ -129,21 +291,14 @@ Bool LoadBlakodString(FILE *f,int len_str,int string_id)
       eprintf("LoadString didn't make string id %i\n",string_id);
       return False;
    }
-   snod = GetStringByID(string_id);
 
-   if (len_str != 0)
-   {
-      snod->data = (char *)AllocateMemory(MALLOC_ID_STRING,len_str+1);
-      if (!fread(snod->data, 1, len_str, f))
-         return False;
-      snod->data[len_str] = '\0';
-   }
-   else
+   b = AllocateStringBody(len_str);
+   if (len_str != 0 && !fread(b->data, 1, len_str, f))
    {
-      snod->data = NULL;
+      ReleaseStringBody(b);
+      return False;
    }
-
-   snod->len_data = len_str;
+   SetStringNodeBody(GetStringByID(string_id),InternStringBody(b));
    
    return True;
 }
@@ -167,18 +322,7 @@ void FreeString(int string_id) /* for garbage collection */
       return;
    }
 
-   if (snod->data != NULL)
-   {
-      FreeMemory(MALLOC_ID_STRING,snod->data,snod->len_data+1);
-   }
-   else
-   {
-      /* happens when blank string saved, loaded, then garbage collected */
-      /* eprintf("FreeString can't free NULL string %i\n",string_id); */
-   }
-
-   snod->data = NULL;
-   snod->len_data = 0;
+   SetStringNodeBody(snod,NULL);
 }
 
 void MoveStringNode(int dest_id,int source_id) /* for garbage collection */
@@ -210,12 +354,9 @@ void MoveStringNode(int dest_id,int source_id) /* for garbage collection */
    if (dest_id == source_id)
       return;
 
-   if (dest->data != NULL)
-      FreeMemory(MALLOC_ID_STRING,dest->data,dest->len_data+1);
-
-   dest->data = source->data;
-   dest->len_data = source->len_data;
-
+   /* the reference to the body moves with it */
+   SetStringNodeBody(dest,source->body);
+   source->body = NULL;
    source->data = NULL;
    source->len_data = 0;
 }
@@ -232,16 +373,51 @@ int GetNumStrings() /* for saving */
 
 void SetString(string_node *snod,char *buf,int len)
 {
+   string_body *b;
+
    if (snod == &temp_str)
    {
       SetTempString(buf,len);
       return;
    }
-   FreeMemory(MALLOC_ID_STRING,snod->data,snod->len_data+1);
-   snod->data = (char *)AllocateMemory(MALLOC_ID_STRING,len+1);
-   memcpy(snod->data,buf,len);
-   snod->len_data = len;
-   snod->data[snod->len_data] = '\0';
+
+   /* buf may be in snod's own body, so make the new one first */
+   b = AllocateStringBody(len);
+   memcpy(b->data,buf,len);
+   SetStringNodeBody(snod,InternStringBody(b));
+}
+
+/* the hash GetTableHash() gives a string */
+unsigned int GetStringNodeHash(string_node *snod)
+{
+   const char *s;
+   const char *nul;
+   int len;
+
+   if (snod->body != NULL)
+      return snod->body->fuzzy_hash;
+
+   s = snod->data;
+   len = snod->len_data;
+   if (s == NULL)
+      return 0;
+   while (len && iswhite(*s)) { s++; len--; }
+   while (len && iswhite(s[len-1])) { len--; }
+   nul = (const char *)memchr(s,'\0',len);
+   return GetBufferHash(s,nul ? (int)(nul - s) : len);
+}
+
+/* same as FuzzyBufferEqual() on the two strings */
+Bool StringNodesEqual(string_node *s1,string_node *s2)
+{
+   if (s1->body != NULL && s2->body != NULL)
+   {
+      if (s1->body == s2->body)
+         return s1->body->fuzzy_len > 0;
+      if (s1->body->fuzzy_hash != s2->body->fuzzy_hash)
+         return False;
+   }
+   return FuzzyBufferEqual(s1->data,s1->len_data,s2->data,s2->len_data);
 }
 
 void SetTempString(char *buf,int len)
@@ -10,7 +10,15 @@
  *
 
   This module implements a hash from strings to integers. It makes
-  a copy of the strings passed in.
+  a copy of the strings passed in.  Keys are matched ignoring case.
+
+  Each node keeps the hash of its key, so a lookup only compares the
+  strings of nodes whose hash matches.  Nodes are also chained by value,
+  so finding the key for a value doesn't have to look at every node.
+  When a key or value is inserted twice, the first one inserted is found.
+  For values that's a change: a full scan used to return whichever came
+  first in bucket order.  The only caller, property names of a class, has
+  one name per property id, so it never sees a duplicate value.
 */
 
 #include "blakserv.h"
@@ -22,8 +30,12 @@ sihash_type CreateSIHash(int size)
 	sihash_type sihash = (sihash_type)AllocateMemory(MALLOC_ID_KODBASE,sizeof(sihash_table));
 	sihash->size = size;
 	sihash->nodes = (sihash_node **)AllocateMemory(MALLOC_ID_KODBASE,size*sizeof(sihash_node *));
+	sihash->value_nodes = (sihash_node **)AllocateMemory(MALLOC_ID_KODBASE,size*sizeof(sihash_node *));
 	for (i=0;i<size;i++)
+	{
 		sihash->nodes[i] = NULL;
+		sihash->value_nodes[i] = NULL;
+	}
 
 	return sihash;
 }
@@ -45,8 +57,9 @@ void FreeSIHash(sihash_type sihash)
 		}		
 	}
 
-	// free node table
+	// free node tables
 	FreeMemory(MALLOC_ID_KODBASE,sihash->nodes,sihash->size*(sizeof(sihash_node *)));
+	FreeMemory(MALLOC_ID_KODBASE,sihash->value_nodes,sihash->size*(sizeof(sihash_node *)));
 	// free control structure
 
 	FreeMemory(MALLOC_ID_KODBASE,sihash,sizeof(sihash_table));
@@ -54,37 +67,37 @@ void FreeSIHash(sihash_type sihash)
 
 void SIHashInsert(sihash_type sihash,const char *key,int value)
 {
-	unsigned int hash_value = GetBufferHash(key,strlen(key)) % sihash->size;
-	sihash_node *node = sihash->nodes[hash_value];
+	sihash_node **link;
+	int len = strlen(key);
+	unsigned int hash = GetBufferHash(key,len);
 
 	sihash_node *new_node = (sihash_node *)AllocateMemory(MALLOC_ID_KODBASE,sizeof(sihash_node));
 	new_node->next = NULL;
-	new_node->key = (char *)AllocateMemory(MALLOC_ID_KODBASE,strlen(key)+1);
+	new_node->next_value = NULL;
+	new_node->key = (char *)AllocateMemory(MALLOC_ID_KODBASE,len+1);
 	strcpy(new_node->key,key);
+	new_node->hash = hash;
 	new_node->value = value;
-	if (node == NULL)
-	{
-		sihash->nodes[hash_value] = new_node;
-	}
-	else
-	{
-		sihash_node *next = node->next;
-		while (next != NULL)
-		{
-			node = next;
-			next = node->next;
-		}
-		node->next = new_node;
-	}
+
+	// add at the end of both chains, so the first insert is found first
+	link = &sihash->nodes[hash % sihash->size];
+	while (*link != NULL)
+		link = &(*link)->next;
+	*link = new_node;
+
+	link = &sihash->value_nodes[(unsigned int)value % sihash->size];
+	while (*link != NULL)
+		link = &(*link)->next_value;
+	*link = new_node;
 }
 
 Bool SIHashFind(sihash_type sihash,const char *key,int *value)
 {
-	unsigned int hash_value = GetBufferHash(key,strlen(key)) % sihash->size;
-	sihash_node *node = sihash->nodes[hash_value];
+	unsigned int hash = GetBufferHash(key,strlen(key));
+	sihash_node *node = sihash->nodes[hash % sihash->size];
 	while (node != NULL)
 	{
-		if (stricmp(node->key,key) == 0)
+		if (node->hash == hash && stricmp(node->key,key) == 0)
 		{
 			*value = node->value;
 			return True;
@@ -96,17 +109,12 @@ Bool SIHashFind(sihash_type sihash,const char *key,int *value)
 
 const char * SIHashFindByValue(sihash_type sihash,int value)
 {
-	int i;
-
-	for (i=0;i<sihash->size;i++)
+	sihash_node *node = sihash->value_nodes[(unsigned int)value % sihash->size];
+	while (node != NULL)
 	{
-		sihash_node *node = sihash->nodes[i];
-		while (node != NULL)
-		{
-			if (node->value == value)
-				return node->key;
-			node = node->next;
-		}
+		if (node->value == value)
+			return node->key;
+		node = node->next_value;
 	}
 	return NULL;
 }
@@ -11,13 +11,16 @@
 typedef struct sihash_node_struct
 {
 	struct sihash_node_struct *next;
+	struct sihash_node_struct *next_value; /* in the value_nodes chain */
 	char *key;
+	unsigned int hash; /* GetBufferHash of key, which ignores case */
 	int value;
 } sihash_node;
 
 typedef struct
 {
-	sihash_node **nodes;
+	sihash_node **nodes;       /* by key hash */
+	sihash_node **value_nodes; /* by value, for SIHashFindByValue */
 	int size;
 } sihash_table,*sihash_type;
 
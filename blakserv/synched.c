@@ -453,7 +453,7 @@ void SynchedAcceptLogin(session_node *s,char *name,char *password)
       return;
    }
 
-   s->account = a;
+   SetSessionAccount(s,a);
    s->account->last_login_time = now;
 
    InterfaceUpdateSession(s);
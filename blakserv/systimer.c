@@ -20,7 +20,8 @@
  period = 60*60 (one hour).
 
  Garbage collecting, saving, sending a "time has passed" message to
- Blakod, and updating our window interface are currently what we do.
+ Blakod, reclaiming unused list nodes, and updating our window interface
+ are currently what we do.
 
  */
 
@@ -94,6 +95,7 @@ void CreateInitialSysTimers()
 		  60*ConfigInt(AUTO_KOD_PERIOD));
    CreateSysTimer(SYST_SAVE,60*ConfigInt(AUTO_SAVE_TIME),
 		  60*ConfigInt(AUTO_SAVE_PERIOD));
+   CreateSysTimer(SYST_RECLAIM_LISTS,0,ConfigInt(AUTO_RECLAIM_LISTS_PERIOD));
    /*
 	  no garbage collection now
    CreateSysTimer(SYST_GARBAGE,60*ConfigInt(AUTO_GARBAGE_TIME),
@@ -164,6 +166,12 @@ void ProcessOneSysTimer(systimer_node *st)
    case SYST_RESET_POOL :
       ResetBufferPool();
       break;  
+
+   case SYST_RECLAIM_LISTS :
+      /* only worth a pass over the list nodes if many were made */
+      if (GetListNodesSinceReclaim() >= LIST_RECLAIM_MIN)
+	 ReclaimListNodes();
+      break;
    }
 }
 
@@ -16,7 +16,7 @@
 enum
 {
    SYST_GARBAGE, SYST_SAVE, SYST_BLAKOD_HOUR, SYST_INTERFACE_UPDATE,
-   SYST_RESET_TRANSMITTED, SYST_RESET_POOL,
+   SYST_RESET_TRANSMITTED, SYST_RESET_POOL, SYST_RECLAIM_LISTS,
 };
 
 typedef struct systimer_struct
@@ -10,33 +10,58 @@
  *
 
  This module supports hash tables in kod. It keeps a dynamically sized
- array of tables, which is GC'ed with the other kod data structures.
- Hash nodes are allocated as needed, and key/data vals are saved/loaded.
- Tables will resize when they become 50% full to avoid collisions.
- 
+ array (a chunk_array) of tables, which is GC'ed with the other kod data
+ structures.
+ Key/data vals are saved/loaded.
+
+ Each table is one array of slots holding the key, data and key hash
+ inline, so a lookup touches a few adjacent slots instead of chasing
+ separately allocated nodes.  Collisions are resolved by linear probing
+ with "Robin Hood" insertion: an entry being placed takes the slot of any
+ entry that is closer to its own home slot, which keeps probe sequences
+ short and lets a search stop as soon as it sees such an entry.  Deletion
+ shifts the following entries back one slot rather than leaving
+ tombstones.  Tables double when they become 3/4 full, with no size limit.
+
  */
 
 #include "blakserv.h"
 
-table_node *tables;
-int num_tables, max_num_tables;
+chunk_array<table_node> tables;
+int num_tables;
 static char buf0[LEN_MAX_CLIENT_MSG+1];
 
+/* set in every stored hash, so that 0 marks an empty slot */
+#define TABLE_HASH_USED 0x80000000
+
 /* local function prototypes */
 
 int AllocateTable(void);
-hash_node * AllocateTableEntry(val_type key_val,val_type data_val);
+int GetTableSlotCount(int size);
+void PlaceTableEntry(table_node *tn,val_type key_val,val_type data_val,unsigned int hash);
+int FindTableEntry(table_node *tn,val_type key_val,unsigned int hash);
 void ResizeTable(int table_id);
 Bool EqualTableEntry(val_type s1_val,val_type s2_val);
 unsigned int GetTableHash(val_type val);
 
+/* Home slot of a hash in a table of the given size.  The ELF hash is
+   weak in its low bits for short keys, so mix it first. */
+static inline int GetTableHome(unsigned int hash,int size)
+{
+   hash *= 2654435769U;
+   return (int)((hash ^ (hash >> 15)) & (unsigned int)(size - 1));
+}
+
+/* How far the entry in slot index is from its home slot. */
+static inline int GetTableProbeDistance(table_node *tn,int index)
+{
+   return (index - GetTableHome(tn->table[index].hash,tn->size)) & (tn->size - 1);
+}
 
 void InitTables()
 {
    num_tables = 0;
-   max_num_tables = INIT_TABLE_NODES;
-   tables = (table_node *)AllocateMemory(MALLOC_ID_TABLE,
-                              max_num_tables * sizeof(table_node));
+   tables.Init(MALLOC_ID_TABLE,INIT_TABLE_NODES);
 }
 
 int GetTablesUsed(void)
@@ -46,39 +71,30 @@ int GetTablesUsed(void)
 
 int AllocateTable(void)
 {
-   int old_nodes;
-   int hash_size = 0;
-
-   if (num_tables == max_num_tables)
-   {
-      old_nodes = max_num_tables;
-      max_num_tables = max_num_tables + (INIT_TABLE_NODES / 2);
-
-      // Now have to get size of all table contents.
-      for (int i = 0; i < num_tables; ++i)
-         hash_size += (tables[i].size * sizeof(hash_node *));
-
-      tables = (table_node *)ResizeMemory(MALLOC_ID_TABLE, tables,
-         (old_nodes * sizeof(table_node)) + hash_size,
-         (max_num_tables * sizeof(table_node)) + hash_size);
-      lprintf("AllocateTable resized to %i tables\n",max_num_tables);
-   }
+   if (num_tables == tables.Capacity())
+      tables.Grow(num_tables + 1);
 
    return num_tables++;
 }
 
 void ResetTables()
 {
-   int old_nodes;
-
    for (int i = 0; i < num_tables; ++i)
       DeleteTable(i);
 
    num_tables = 0;
-   old_nodes = max_num_tables;
-   max_num_tables = INIT_TABLE_NODES;
-   tables = (table_node *)ResizeMemory(MALLOC_ID_TABLE, tables,
-      old_nodes * sizeof(table_node), max_num_tables * sizeof(table_node));
+   tables.Shrink(INIT_TABLE_NODES);
+}
+
+/* smallest power of 2 that holds size slots */
+int GetTableSlotCount(int size)
+{
+   int slots;
+
+   slots = 1;
+   while (slots < size)
+      slots <<= 1;
+   return slots;
 }
 
 int CreateTable(int size)
@@ -94,34 +110,24 @@ int CreateTable(int size)
          size, DEFAULT_TABLE_SIZE);
       size = DEFAULT_TABLE_SIZE;
    }
+   size = GetTableSlotCount(size);
    tn->size = size;
    tn->num_entries = 0;
-   tn->table = (hash_node **)AllocateMemoryCalloc(MALLOC_ID_TABLE, size,
-                                 sizeof(hash_node *));
+   tn->table = (hash_node *)AllocateMemoryCalloc(MALLOC_ID_TABLE, size,
+                                 sizeof(hash_node));
 
    return table_id;
 }
 
 void DeleteTable(int table_id)
 {
-   hash_node *hn,*temp;
    table_node *tn;
 
    tn = GetTableByID(table_id);
 
-   for (int i = 0; i < tn->size; ++i)
-   {
-      hn = tn->table[i];
-      while (hn != NULL)
-      {
-         temp = hn->next;
-         FreeMemory(MALLOC_ID_TABLE,hn,sizeof(hash_node));
-         hn = temp;
-      }
-      tn->table[i] = NULL;
-   }
-
-   FreeMemory(MALLOC_ID_TABLE,tn->table,tn->size*sizeof(hash_node *));
+   if (tn->table != NULL)
+      FreeMemory(MALLOC_ID_TABLE,tn->table,tn->size*sizeof(hash_node));
+   tn->table = NULL;
    tn->size = 0;
    tn->num_entries = 0;
 }
@@ -138,73 +144,98 @@ table_node * GetTableByID(int table_id)
    return &tables[table_id];
 }
 
-hash_node * AllocateTableEntry(val_type key_val,val_type data_val)
+/* Put an entry known not to be in the table into it.  Walking from the
+   home slot, the entry takes over the first slot that is empty or whose
+   occupant is closer to its own home, and the occupant carries on. */
+void PlaceTableEntry(table_node *tn,val_type key_val,val_type data_val,unsigned int hash)
 {
-   hash_node *hn;
+   hash_node entry,temp;
+   int index, dist, mask, occupant_dist;
 
-   hn = (hash_node *)AllocateMemory(MALLOC_ID_TABLE,sizeof(hash_node));
+   entry.key_val = key_val;
+   entry.data_val = data_val;
+   entry.hash = hash;
 
-   hn->key_val = key_val;
-   hn->data_val = data_val;
+   mask = tn->size - 1;
+   index = GetTableHome(hash,tn->size);
+   dist = 0;
+
+   while (tn->table[index].hash != 0)
+   {
+      occupant_dist = GetTableProbeDistance(tn,index);
+      if (occupant_dist < dist)
+      {
+         temp = tn->table[index];
+         tn->table[index] = entry;
+         entry = temp;
+         dist = occupant_dist;
+      }
+      index = (index + 1) & mask;
+      dist++;
+   }
+   tn->table[index] = entry;
+   tn->num_entries++;
+}
+
+/* Slot holding key_val, or -1.  The search can stop at the first entry
+   closer to its home than we are to ours, since key_val would have taken
+   that slot when it was placed. */
+int FindTableEntry(table_node *tn,val_type key_val,unsigned int hash)
+{
+   hash_node *hn;
+   int index, dist, mask;
+
+   if (tn->size < 1)
+      return -1;
 
-   hn->next = NULL;
+   mask = tn->size - 1;
+   index = GetTableHome(hash,tn->size);
 
-   return hn;
+   for (dist = 0; dist < tn->size; ++dist)
+   {
+      hn = &tn->table[index];
+      if (hn->hash == 0 || GetTableProbeDistance(tn,index) < dist)
+         return -1;
+      if (hn->hash == hash && EqualTableEntry(hn->key_val,key_val))
+         return index;
+      index = (index + 1) & mask;
+   }
+   return -1;
 }
 
 void ResizeTable(int table_id)
 {
-   int new_size, index;
+   int old_size;
    table_node *tn;
-   hash_node *hn, *hn_t, **hn_new, *temp;
+   hash_node *old_table;
 
    tn = GetTableByID(table_id);
    if (tn == NULL)
       return;
 
-   // Double table size + 1.
-   new_size = tn->size * 2 + 1;
-   if (new_size > MAX_TABLE_SIZE)
-      new_size = MAX_TABLE_SIZE;
-   // Allocate memory for the new hashes.
-   hn_new = (hash_node **)AllocateMemoryCalloc(MALLOC_ID_TABLE, new_size,
-      sizeof(hash_node *));
-
-   // Look at each hash in the table and allocate it in the new one.
-   // We also free memory as we go, to avoid doing the same work in
-   // DeleteTable.
-   for (int i = 0; i < tn->size; ++i)
-   {
-      hn = tn->table[i];
-      while (hn != NULL)
-      {
-         // Save pointer to next hash node, if present.
-         temp = hn->next;
-         // Get the new hash.
-         index = GetTableHash(hn->key_val) % new_size;
-         // Allocate new hash node.
-         hn_t = AllocateTableEntry(hn->key_val, hn->data_val);
-         // Pointers to next node in hash.
-         hn_t->next = hn_new[index];
-         hn_new[index] = hn_t;
-         // Free old hash.
-         FreeMemory(MALLOC_ID_TABLE,hn,sizeof(hash_node));
-         // Replace pointer to next, if present.
-         hn = temp;
-      }
-   }
+   old_size = tn->size;
+   old_table = tn->table;
+
+   tn->size = old_size * 2;
+   tn->num_entries = 0;
+   tn->table = (hash_node *)AllocateMemoryCalloc(MALLOC_ID_TABLE, tn->size,
+      sizeof(hash_node));
+
+   // Entries keep their hashes, so they can be placed without looking
+   // at the keys again.
+   for (int i = 0; i < old_size; ++i)
+      if (old_table[i].hash != 0)
+         PlaceTableEntry(tn, old_table[i].key_val, old_table[i].data_val,
+            old_table[i].hash);
 
-   // Free the old hash node pointer memory, since we're replacing it.
-   FreeMemory(MALLOC_ID_TABLE,tn->table,tn->size*sizeof(hash_node *));
-   tn->size = new_size;
-   tn->table = hn_new;
+   FreeMemory(MALLOC_ID_TABLE,old_table,old_size*sizeof(hash_node));
 }
 
 void InsertTable(int table_id,val_type key_val,val_type data_val)
 {
    table_node *tn;
-   hash_node *hn;
-   unsigned int index;
+   unsigned int hash;
+   int index;
 
    tn = GetTableByID(table_id);
    if (tn == NULL)
@@ -219,28 +250,32 @@ void InsertTable(int table_id,val_type key_val,val_type data_val)
       return;
    }
 
-   // Dynamically resize table if it starts getting too many entries
-   // to avoid collisions.
-   if (tn->size < MAX_TABLE_SIZE && tn->num_entries * 2 > tn->size)
-      ResizeTable(table_id);
-
-   tn->num_entries++;
-   index = GetTableHash(key_val) % tn->size;
+   hash = GetTableHash(key_val) | TABLE_HASH_USED;
 
    if (ConfigBool(DEBUG_HASH) == True)
-      dprintf("Insert tbl %i, index %i, key %i,%i\n",table_id,index,key_val.v.tag,key_val.v.data);
-   
-   /* insert in front of list */
-   hn = AllocateTableEntry(key_val,data_val);
-   hn->next = tn->table[index];
-   tn->table[index] = hn;
+      dprintf("Insert tbl %i, home %i, key %i,%i\n",table_id,
+         GetTableHome(hash,tn->size),key_val.v.tag,key_val.v.data);
+
+   // A key already in the table just gets its data replaced.
+   index = FindTableEntry(tn,key_val,hash);
+   if (index >= 0)
+   {
+      tn->table[index].data_val = data_val;
+      return;
+   }
+
+   // Grow before the table gets 3/4 full; probe sequences get long fast
+   // past that.
+   if ((tn->num_entries + 1) * 4 > tn->size * 3)
+      ResizeTable(table_id);
+
+   PlaceTableEntry(tn,key_val,data_val,hash);
 }
 
 int GetTableEntry(int table_id,val_type key_val)
 {
    table_node *tn;
-   hash_node *hn;
-   unsigned int index;
+   int index;
 
    tn = GetTableByID(table_id);
    if (tn == NULL)
@@ -249,23 +284,17 @@ int GetTableEntry(int table_id,val_type key_val)
       return NIL;
    }
 
-   index = GetTableHash(key_val) % tn->size;
+   index = FindTableEntry(tn,key_val,GetTableHash(key_val) | TABLE_HASH_USED);
+   if (index < 0)
+      return NIL;
 
-   hn = tn->table[index];
-   while (hn != NULL)
-   {
-      if (EqualTableEntry(hn->key_val,key_val))
-         return hn->data_val.int_val;
-      hn = hn->next;
-   }
-   return NIL;
+   return tn->table[index].data_val.int_val;
 }
 
 void DeleteTableEntry(int table_id,val_type key_val)
 {
    table_node *tn;
-   hash_node *hn,*temp;
-   unsigned int index;
+   int index, next, mask;
 
    tn = GetTableByID(table_id);
    if (tn == NULL)
@@ -274,40 +303,26 @@ void DeleteTableEntry(int table_id,val_type key_val)
       return;
    }
 
-   index = GetTableHash(key_val) % tn->size;
-
-   if (tn->table[index] == NULL)
+   index = FindTableEntry(tn,key_val,GetTableHash(key_val) | TABLE_HASH_USED);
+   if (index < 0)
    {
       dprintf("DeleteTableEntry can't delete %i,%i from table %i\n",key_val.v.tag,
          key_val.v.data,table_id);
       return;
    }
 
-   if (EqualTableEntry(tn->table[index]->key_val,key_val))
+   // Shift the entries after this one back a slot, up to an empty slot or
+   // one that's already at home, so no search runs into a hole.
+   mask = tn->size - 1;
+   next = (index + 1) & mask;
+   while (tn->table[next].hash != 0 && GetTableProbeDistance(tn,next) > 0)
    {
-      hn = tn->table[index]->next;
-      FreeMemory(MALLOC_ID_TABLE,tn->table[index],sizeof(hash_node));
-      tn->table[index] = hn;
-      tn->num_entries--;
-      return;
+      tn->table[index] = tn->table[next];
+      index = next;
+      next = (next + 1) & mask;
    }
-
-   hn = tn->table[index];
-   
-   while (hn->next != NULL)
-   {
-      if (EqualTableEntry(hn->next->key_val,key_val))
-      {
-         temp = hn->next;
-         hn->next = hn->next->next;
-         FreeMemory(MALLOC_ID_TABLE,temp,sizeof(hash_node));
-         tn->num_entries--;
-         return;
-      }
-      hn = hn->next;
-   }
-   dprintf("DeleteTableEntry can't delete %i,%i from table %i\n",key_val.v.tag,
-      key_val.v.data,table_id);
+   memset(&tn->table[index],0,sizeof(hash_node));
+   tn->num_entries--;
 }
 
 Bool EqualTableEntry(val_type s1_val,val_type s2_val)
@@ -315,9 +330,10 @@ Bool EqualTableEntry(val_type s1_val,val_type s2_val)
    char *s1,*s2;
    int len1,len2;
    resource_node *r;
-   string_node *snod;
+   string_node *snod,*snod1,*snod2;
 
    s1 = NULL;
+   snod1 = NULL;
    switch (s1_val.v.tag)
    {
       case TAG_RESOURCE :
@@ -342,18 +358,21 @@ Bool EqualTableEntry(val_type s1_val,val_type s2_val)
             eprintf("%s\n",BlakodStackInfo());
             return False;
          }
+         snod1 = snod;
          s1 = snod->data;
          len1 = snod->len_data;
          break;
 
       case TAG_TEMP_STRING :
          snod = GetTempString();
+         snod1 = snod;
          s1 = snod->data;
          len1 = snod->len_data;
          break;
    }
 
    s2 = NULL;
+   snod2 = NULL;
    switch (s2_val.v.tag)
    {
       case TAG_RESOURCE :
@@ -378,12 +397,14 @@ Bool EqualTableEntry(val_type s1_val,val_type s2_val)
             eprintf("%s\n",BlakodStackInfo());
             return False;
          }
+         snod2 = snod;
          s2 = snod->data;
          len2 = snod->len_data;
          break;
 
       case TAG_TEMP_STRING :
          snod = GetTempString();
+         snod2 = snod;
          s2 = snod->data;
          len2 = snod->len_data;
          break;
@@ -402,6 +423,10 @@ Bool EqualTableEntry(val_type s1_val,val_type s2_val)
       return False;
    }
 
+   /* two Blakod strings can be compared by their bodies */
+   if (snod1 != NULL && snod2 != NULL)
+      return StringNodesEqual(snod1,snod2);
+
    return FuzzyBufferEqual(s1,len1,s2,len2);
 }
 
@@ -434,9 +459,8 @@ unsigned int GetTableHash(val_type val)
             eprintf("%s\n",BlakodStackInfo());
             return 0;
          }
-         s = snod->data;
-         len = snod->len_data;
-         break;
+         /* kept with the string */
+         return GetStringNodeHash(snod);
 
       case TAG_TEMP_STRING :
          snod = GetTempString();
@@ -445,9 +469,7 @@ unsigned int GetTableHash(val_type val)
             bprintf("GetTableHash can't find temp string\n");
             return 0;
          }
-         s = snod->data;
-         len = snod->len_data;
-         break;
+         return GetStringNodeHash(snod);
 
       default:
          return GetBufferHash((char *)&val.int_val,4);
@@ -14,22 +14,24 @@
 #define _TABLE_H
 
 #define INIT_TABLE_NODES (18000)
+/* bounds on the size Kod may ask for; tables grow past this as needed */
 #define MIN_TABLE_SIZE (23)
 #define MAX_TABLE_SIZE (19463)
 #define DEFAULT_TABLE_SIZE (73)
 
+/* one slot of a table, stored inline in the slot array */
 typedef struct hash_struct
 {
    val_type key_val;
    val_type data_val;
-   struct hash_struct *next;
+   unsigned int hash; /* hash of key_val with the top bit set, 0 if slot empty */
 } hash_node;
 
 typedef struct table_struct
 {
-   int size;
+   int size; /* number of slots, always a power of 2 */
    int num_entries;
-   hash_node **table;
+   hash_node *table;
    int garbage_ref;
 } table_node;
 
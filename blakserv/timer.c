@@ -9,8 +9,14 @@
  * timer.c
  *
 
- This module maintains a linked list of timers for the Blakod.  It
- also contains the main loop of the program.
+ This module maintains the timers for the Blakod.  It also contains
+ the main loop of the program.
+
+ Active timers are kept in a 4-ary min-heap ordered by expiration time,
+ then creation order, so timers due at the same time fire in the order
+ they were created.  A hash table from timer id to timer_node makes
+ lookup and deletion by id constant time.  Neither structure is ordered
+ by id, so ForEachTimer visits timers in no particular order.
 
  */
 
@@ -19,7 +25,26 @@
 static Bool in_main_loop = False;
 static int numActiveTimers = 0;
 
-timer_node *timers;
+#define INIT_TIMER_HEAP 1024
+#define INIT_TIMER_INDEX 2048 /* must be a power of 2 */
+
+/* heap children of i are 4i+1..4i+4 */
+#define TIMER_HEAP_PARENT(i) (((i) - 1) >> 2)
+#define TIMER_HEAP_CHILD(i) (((i) << 2) + 1)
+
+static timer_node **timer_heap;
+static int timer_heap_count;
+static int timer_heap_size;
+
+/* open addressed, linear probing; no tombstones, see TimerIndexRemove */
+static timer_node **timer_index;
+static int timer_index_size;
+static int timer_index_shift;
+
+static UINT64 next_timer_seq;
+
+static timer_stat_type timer_stats;
+
 int next_timer_num;
 
 timer_node *deleted_timers;
@@ -28,20 +53,42 @@ int pause_time;
 
 /* local function prototypes */
 void AddTimerNode(timer_node *t);
+void RemoveTimerNode(timer_node *t);
 void StoreDeletedTimer(timer_node *t);
 void ResetLastMessageTimes(session_node *s);
+void TimerHeapSiftUp(int i);
+void TimerHeapSiftDown(int i);
+void TimerIndexInsert(timer_node *t);
+void TimerIndexRemove(timer_node *t);
+void RebuildTimerIndex(int new_size);
+Bool TimerFireFirst(UINT64 now);
 
 int  GetNumActiveTimers(void)
 {
    return numActiveTimers;
 }
 
+timer_stat_type * GetTimerStats(void)
+{
+   return &timer_stats;
+}
+
 void InitTimer(void)
 {
-   timers = NULL;
+   timer_heap_size = INIT_TIMER_HEAP;
+   timer_heap_count = 0;
+   timer_heap = (timer_node **)AllocateMemory(MALLOC_ID_TIMER,
+      timer_heap_size*sizeof(timer_node *));
+
+   timer_index = NULL;
+   RebuildTimerIndex(INIT_TIMER_INDEX);
+
+   next_timer_seq = 0;
    next_timer_num = 0;
    numActiveTimers = 0;
    deleted_timers = NULL;
+
+   memset(&timer_stats,0,sizeof(timer_stats));
    
    pause_time = 0;
 }
@@ -54,15 +101,14 @@ void ResetTimer(void)
 void ClearTimer(void)
 {
    timer_node *t,*temp;
+   int i;
 
-   t = timers;
-   while (t != NULL)
-   {
-      temp = t;
-      t = t->next;
-      FreeMemory(MALLOC_ID_TIMER,temp,sizeof(timer_node));
-   }
-   timers = NULL;
+   for (i=0;i<timer_heap_count;i++)
+      FreeMemory(MALLOC_ID_TIMER,timer_heap[i],sizeof(timer_node));
+   timer_heap_count = 0;
+   memset(timer_index,0,timer_index_size*sizeof(timer_node *));
+
+   next_timer_seq = 0;
    next_timer_num = 0;
    numActiveTimers = 0;
 
@@ -89,7 +135,7 @@ void PauseTimers(void)
 void UnpauseTimers(void)
 {
    int add_time;
-   timer_node *t;
+   int i;
    
    if (pause_time == 0)
    {
@@ -98,12 +144,9 @@ void UnpauseTimers(void)
    }
    add_time = 1000*(GetTime() - pause_time);
 
-   t = timers;
-   while (t != NULL)
-   {
-      t->time += add_time;
-      t = t->next;
-   }
+   /* same shift for everyone keeps the heap in order */
+   for (i=0;i<timer_heap_count;i++)
+      timer_heap[i]->time += add_time;
 
    pause_time = 0;
    
@@ -122,36 +165,177 @@ void ResetLastMessageTimes(session_node *s)
    s->game->game_last_message_time = GetTime();
 }
 
-void AddTimerNode(timer_node *t)
+/* a before b in firing order */
+#define TimerBefore(a,b) ((a)->time < (b)->time || ((a)->time == (b)->time && (a)->seq < (b)->seq))
+
+void TimerHeapSiftUp(int i)
+{
+   timer_node *t,*parent;
+
+   t = timer_heap[i];
+   while (i > 0)
+   {
+      parent = timer_heap[TIMER_HEAP_PARENT(i)];
+      if (!TimerBefore(t,parent))
+         break;
+      timer_heap[i] = parent;
+      parent->heap_index = i;
+      i = TIMER_HEAP_PARENT(i);
+   }
+   timer_heap[i] = t;
+   t->heap_index = i;
+}
+
+void TimerHeapSiftDown(int i)
+{
+   timer_node *t,*child;
+   int first,last,j,best;
+
+   t = timer_heap[i];
+   for (;;)
+   {
+      first = TIMER_HEAP_CHILD(i);
+      if (first >= timer_heap_count)
+         break;
+      last = std::min(first + 4,timer_heap_count);
+
+      best = first;
+      for (j=first+1;j<last;j++)
+         if (TimerBefore(timer_heap[j],timer_heap[best]))
+            best = j;
+
+      child = timer_heap[best];
+      if (!TimerBefore(child,t))
+         break;
+      timer_heap[i] = child;
+      child->heap_index = i;
+      i = best;
+   }
+   timer_heap[i] = t;
+   t->heap_index = i;
+}
+
+void RebuildTimerIndex(int new_size)
+{
+   int i;
+
+   if (timer_index != NULL)
+      FreeMemory(MALLOC_ID_TIMER,timer_index,timer_index_size*sizeof(timer_node *));
+
+   timer_index_size = new_size;
+   timer_index_shift = 32;
+   for (i=new_size;i>1;i>>=1)
+      timer_index_shift--;
+   timer_index = (timer_node **)AllocateMemoryCalloc(MALLOC_ID_TIMER,
+      timer_index_size,sizeof(timer_node *));
+
+   for (i=0;i<timer_heap_count;i++)
+      TimerIndexInsert(timer_heap[i]);
+}
+
+#define GetTimerIndexNum(id) (((unsigned int)(id) * 2654435761U) >> timer_index_shift)
+
+void TimerIndexInsert(timer_node *t)
+{
+   int i;
+
+   i = GetTimerIndexNum(t->timer_id);
+   while (timer_index[i] != NULL)
+      i = (i + 1) & (timer_index_size - 1);
+   timer_index[i] = t;
+}
+
+/* Backward shift deletion: move later entries of the probe run into the
+   hole, so lookups never need deleted markers. */
+void TimerIndexRemove(timer_node *t)
 {
-   timer_node *temp,*prev;
+   int i,j,home;
+
+   i = GetTimerIndexNum(t->timer_id);
+   while (timer_index[i] != t)
+   {
+      if (timer_index[i] == NULL)
+      {
+         eprintf("TimerIndexRemove can't find timer %i\n",t->timer_id);
+         return;
+      }
+      i = (i + 1) & (timer_index_size - 1);
+   }
 
-   /* insert in sorted increasing order by time */
+   j = i;
+   for (;;)
+   {
+      timer_index[i] = NULL;
+      for (;;)
+      {
+         j = (j + 1) & (timer_index_size - 1);
+         if (timer_index[j] == NULL)
+            return;
+         home = GetTimerIndexNum(timer_index[j]->timer_id);
+         /* can move j to i only if home isn't cyclically in (i,j] */
+         if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+            break;
+      }
+      timer_index[i] = timer_index[j];
+      i = j;
+   }
+}
 
-   if (timers == NULL || timers->time > t->time)
+void AddTimerNode(timer_node *t)
+{
+   if (timer_heap_count == timer_heap_size)
    {
-      t->next = timers; /* order is important! do this FIRST */
-      timers = t;
+      timer_heap = (timer_node **)ResizeMemory(MALLOC_ID_TIMER,timer_heap,
+         timer_heap_size*sizeof(timer_node *),2*timer_heap_size*sizeof(timer_node *));
+      timer_heap_size *= 2;
+   }
 
+   /* keep the index at most half full */
+   if (2*(timer_heap_count + 1) > timer_index_size)
+      RebuildTimerIndex(2*timer_index_size);
+
+   t->seq = next_timer_seq++;
+   timer_heap[timer_heap_count] = t;
+   t->heap_index = timer_heap_count++;
+   TimerHeapSiftUp(t->heap_index);
+   TimerIndexInsert(t);
+
+   if (t->heap_index == 0)
+   {
       /* we're making a new first-timer, so the time main loop should wait might
 	 have changed, so have it break out of loop and recalibrate */
       PostThreadMessage(main_thread_id,WM_BLAK_MAIN_RECALIBRATE,0,0);
-      return;
    }
+}
 
-   temp = timers;
-   do
-   {
-      prev = temp;
-      temp = temp->next;
-   } while (temp != NULL && temp->time <= t->time);
-   
-   t->next = temp;
-   prev->next = t;
+void RemoveTimerNode(timer_node *t)
+{
+   timer_node *last;
+   int i;
+
+   TimerIndexRemove(t);
 
+   i = t->heap_index;
+   last = timer_heap[--timer_heap_count];
+   if (last == t)
+      return;
+
+   timer_heap[i] = last;
+   last->heap_index = i;
+   if (i > 0 && TimerBefore(last,timer_heap[TIMER_HEAP_PARENT(i)]))
+      TimerHeapSiftUp(i);
+   else
+      TimerHeapSiftDown(i);
 }
 
 int CreateTimer(int object_id,int message_id,int milliseconds)
+{
+   return CreatePeriodicTimer(object_id,message_id,milliseconds,0);
+}
+
+/* a timer that first fires in milliseconds, then every period milliseconds
+   after that, keeping its id until it is deleted.  period 0 is one-shot. */
+int CreatePeriodicTimer(int object_id,int message_id,int milliseconds,int period)
 {
    timer_node *t;
 
@@ -168,6 +352,7 @@ int CreateTimer(int object_id,int message_id,int milliseconds)
    t->object_id = object_id;
    t->message_id = message_id;
    t->time = GetMilliCount() + milliseconds;
+   t->period = period;
 
    AddTimerNode(t);
    numActiveTimers++;
@@ -175,7 +360,7 @@ int CreateTimer(int object_id,int message_id,int milliseconds)
    return t->timer_id;
 }
 
-Bool LoadTimer(int timer_id,int object_id,char *message_name,int milliseconds)
+Bool LoadTimer(int timer_id,int object_id,char *message_name,int milliseconds,int period)
 {
    object_node *o;
    timer_node *t;
@@ -200,6 +385,7 @@ Bool LoadTimer(int timer_id,int object_id,char *message_name,int milliseconds)
    t->object_id = object_id;
    t->message_id = m->message_id;
    t->time = GetMilliCount() + milliseconds;
+   t->period = period;
 
    AddTimerNode(t);
    numActiveTimers++;
@@ -223,93 +409,136 @@ void StoreDeletedTimer(timer_node *t)
 
 Bool DeleteTimer(int timer_id)
 {
-   timer_node *t,*prev;
+   timer_node *t;
+
+   t = GetTimerByID(timer_id);
+   if (t == NULL)
+   {
+      bprintf("DeleteTimer can't find timer %i\n",timer_id);
+      return False;
+   }
+
+   RemoveTimerNode(t);
 
-   if (timers == NULL)
+   /* put deleted timer on deleted_timer list */
+   StoreDeletedTimer(t);
+
+   return True;
+}
+
+/* fire the 1st timer if it is due at now, returns whether it did */
+Bool TimerFireFirst(UINT64 now)
+{
+   timer_node *first;
+   int object_id,message_id,late;
+   val_type timer_val;
+   parm_node p[1];
+   
+   if (timer_heap_count == 0)
       return False;
    
-   if (timers->timer_id == timer_id)
-   {
-      t = timers->next;
+   first = timer_heap[0];
+   if (now <= first->time)
+      return False;
 
-      /* put deleted timer on deleted_timer list */
-      StoreDeletedTimer(timers);
+   late = (int)std::min(now - first->time,(UINT64)INT_MAX);
+   timer_stats.total_late_ms += late;
+   if (late > timer_stats.max_late_ms)
+      timer_stats.max_late_ms = late;
 
-      timers = t;
+   /*
+   if (late > TIMER_DELAY_WARN)
+      dprintf("Timer handled %i.%03is late\n",late/1000,late%1000);
+   */
+
+   object_id = first->object_id;
+   message_id = first->message_id;
+   
+   timer_val.v.tag = TAG_TIMER;
+   timer_val.v.data = first->timer_id;
+   
+   p[0].type = CONSTANT;
+   p[0].value = timer_val.int_val;
+   p[0].name_id = TIMER_PARM;
+   
+   /* a repeating timer whose object is gone would otherwise fire forever */
+   if (first->period > 0 && GetObjectByIDQuietly(first->object_id) == NULL)
+   {
+      eprintf("TimerFireFirst dropping periodic timer %i on deleted object %i\n",
+              first->timer_id,first->object_id);
+      RemoveTimerNode(first);
+      StoreDeletedTimer(first);
       return True;
    }
 
-   prev = timers;
-   t = timers->next;
-   while (t != NULL)
+   if (first->period > 0)
    {
-      if (t->timer_id == timer_id)
-      {
-	 prev->next = t->next;
-
-	 /* put deleted timer on deleted_timer list */
-	 StoreDeletedTimer(t);
-
-	 return True;
-      }
-      prev = t;
-      t = t->next;
+      /* re-arm in place before the handler runs, so it can still delete
+         the timer.  Step from the old deadline so we don't drift, but
+         don't try to make up periods we missed entirely. */
+      first->time += first->period;
+      if (first->time <= now)
+         first->time = now + first->period;
+      first->seq = next_timer_seq++;
+      TimerHeapSiftDown(0);
    }
-
-   bprintf("DeleteTimer can't find timer %i\n",timer_id);
-
-#if 0
-   // list the active timers.
-   t = timers;
-   while (t != NULL)
+   else
    {
-      dprintf("%i ",t->timer_id);
-      t = t->next;
+      RemoveTimerNode(first);
+      
+      /* put deleted timer on deleted_timer list */
+      StoreDeletedTimer(first);
    }
-   dprintf("\n");
-#endif
-   return False;
+   
+   SendTopLevelBlakodMessage(object_id,message_id,1,p);
+   return True;
 }
 
-/* activate the 1st timer, if it is time */
+/* activate the due timers.  With TimerBatch off this is one timer per call,
+   like it always was.  With it on, keep firing until nothing is due or we
+   hit the count or time limit, so the sockets still get polled.  Timers
+   created while draining with a zero delay are not due until the clock
+   moves, so a timer that recreates itself can't keep us here. */
 void TimerActivate()
 {
-   timer_node *temp;
-   int object_id,message_id;
-   UINT64 now;
-   val_type timer_val;
-   parm_node p[1];
-   
-   if (timers == NULL)
+   UINT64 start,now;
+   int drained,max_drained,max_ms;
+
+   if (timer_heap_count == 0)
       return;
-   
-   now = GetMilliCount();
-   if (now > timers->time)
+
+   if (ConfigBool(BLAKOD_TIMER_BATCH))
    {
-	/*
-     if (now - timers->time > TIMER_DELAY_WARN)
-       dprintf("Timer handled %i.%03is late\n",
-	       (now-timers->time)/1000,(now-timers->time)%1000);
-	*/
-
-      object_id = timers->object_id;
-      message_id = timers->message_id;
-      
-      timer_val.v.tag = TAG_TIMER;
-      timer_val.v.data = timers->timer_id;
-      
-      p[0].type = CONSTANT;
-      p[0].value = timer_val.int_val;
-      p[0].name_id = TIMER_PARM;
-      
-      temp = timers;
-      timers = timers->next;
-      
-      /* put deleted timer on deleted_timer list */
-      StoreDeletedTimer(temp);
-      
-      SendTopLevelBlakodMessage(object_id,message_id,1,p);
+      max_drained = std::max(ConfigInt(BLAKOD_TIMER_BATCH_MAX),1);
+      max_ms = ConfigInt(BLAKOD_TIMER_BATCH_MS);
+   }
+   else
+   {
+      max_drained = 1;
+      max_ms = 0;
    }
+
+   start = GetMilliCount();
+   drained = 0;
+   while (TimerFireFirst(start))
+   {
+      drained++;
+      if (drained >= max_drained)
+         break;
+      now = GetMilliCount();
+      if (now - start >= (UINT64)max_ms)
+         break;
+   }
+
+   if (drained == 0)
+      return;
+
+   timer_stats.wakeups++;
+   timer_stats.fired += drained;
+   if (drained > timer_stats.max_drained)
+      timer_stats.max_drained = drained;
+   if (max_drained > 1 && timer_heap_count > 0 && start > timer_heap[0]->time)
+      timer_stats.cut_short++;
 }
 
 Bool InMainLoop(void)
@@ -337,11 +566,11 @@ void ServiceTimers(void)
 
    for(;;)
    {
-      if (timers == NULL)
+      if (timer_heap_count == 0)
 			ms = 500;
       else
       {
-			ms = timers->time - GetMilliCount();
+			ms = timer_heap[0]->time - GetMilliCount();
 			if (ms <= 0)
 				ms = 0;
 	 
@@ -411,32 +640,32 @@ void ServiceTimers(void)
 timer_node * GetTimerByID(int timer_id)
 {
    timer_node *t;
+   int i;
 
-   t = timers;
-   while (t != NULL)
+   i = GetTimerIndexNum(timer_id);
+   while ((t = timer_index[i]) != NULL)
    {
       if (t->timer_id == timer_id)
 	 return t;
-      t = t->next;
+      i = (i + 1) & (timer_index_size - 1);
    }
    return NULL;
 }
 
 void ForEachTimer(void (*callback_func)(timer_node *t))
 {
-   timer_node *t;
+   int i;
 
-   t = timers;
-   while (t != NULL)
-   {
-      callback_func(t);
-      t = t->next;
-   }
+   for (i=0;i<timer_heap_count;i++)
+      callback_func(timer_heap[i]);
 }
 
 /* functions for garbage collection */
 
+/* called after the garbage collector has renumbered all the timers, so
+   the index has to be rebuilt with the new ids */
 void SetNumTimers(int new_next_timer_num)
 {
    next_timer_num = new_next_timer_num;
+   RebuildTimerIndex(timer_index_size);
 }
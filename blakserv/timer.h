@@ -19,17 +19,31 @@ typedef struct timer_struct
    int object_id;
    int message_id;
    UINT64 time;
+   int period;         /* re-arm interval in ms, 0 for a one-shot timer */
+   UINT64 seq;         /* creation order, breaks ties between equal times */
+   int heap_index;     /* position in the timer heap */
    int garbage_ref;
-   struct timer_struct *next;
+   struct timer_struct *next; /* for the deleted timer list */
 } timer_node;
 
+typedef struct
+{
+   int wakeups;          /* passes that fired at least one timer */
+   double fired;
+   int max_drained;      /* most timers fired in one pass */
+   int cut_short;        /* passes stopped by the count or time limit */
+   double total_late_ms;
+   int max_late_ms;
+} timer_stat_type;
+
 void InitTimer(void);
 void ResetTimer(void);
 void ClearTimer(void);
 void PauseTimers(void);
 void UnpauseTimers(void);
 int CreateTimer(int object_id,int message_id,int milliseconds);
-Bool LoadTimer(int timer_id,int object_id,char *message_name,int milliseconds);
+int CreatePeriodicTimer(int object_id,int message_id,int milliseconds,int period);
+Bool LoadTimer(int timer_id,int object_id,char *message_name,int milliseconds,int period);
 Bool DeleteTimer(int timer_id);
 void ServiceTimers(void);
 void QuitTimerLoop(void);
@@ -38,5 +52,6 @@ void ForEachTimer(void (*callback_func)(timer_node *t));
 void SetNumTimers(int new_next_timer_num);
 Bool InMainLoop(void);
 int  GetNumActiveTimers(void);
+timer_stat_type * GetTimerStats(void);
 
 #endif
@@ -154,6 +154,7 @@ enum
    DELETETIMER = 52,
    GETTIMEREMAINING = 53,
    ISTIMER = 54,
+   CREATEPERIODICTIMER = 55,
 
    MOVESECTORBSP = 59,
    CHANGETEXTUREBSP = 60,
@@ -176,6 +177,17 @@ enum
    GETRANDOMPOINTBSP = 79,
    GETSTEPTOWARDSBSP = 80,
 
+   INTERESTADD = 81,
+   INTERESTMOVE = 82,
+   INTERESTREMOVE = 83,
+   INTERESTQUERY = 84,
+   INTERESTSENDPACKET = 85,
+   GETOBJECTSINRADIUS = 86,
+   GETNEARESTOBJECTS = 87,
+   GETOBJECTSINVIEW = 88,
+   GETPATHBSP = 89,
+   GETSTEPSTOWARDSBSP = 90,
+
    GETALLLISTNODESBYCLASS = 99,
    APPENDLISTELEM = 100,
    CONS = 101,